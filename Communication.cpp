@@ -44,7 +44,7 @@ namespace Communication
             throw SocketException("Cannot connect to server");
         }
 
-        this->receptionThread = std::thread(receiveData, this->description, &this->receptionChannelMutex, &this->receptionChannel);
+        this->receptionThread = std::thread(receiveData, this->description, &this->receptionChannelMutex, &this->receptionChannel, &this->onReception);
         this->transmissionThread = std::thread(sendData, this->description, &this->transmissionChannelMutex, &this->transmissionChannel);
 
         // Tout est prêt, on envoi un message de connexion au serveur
@@ -62,7 +62,7 @@ namespace Communication
         close(this->description);
     }
 
-    void receiveData(int description, std::mutex* receptionChannelMutex, std::queue<PMessageBase>* receptionChannel)
+    void receiveData(int description, std::mutex* receptionChannelMutex, std::queue<PMessageBase>* receptionChannel, std::function<void()>* onReception)
     {
         char buffer[BUFSIZE];
 
@@ -85,6 +85,8 @@ namespace Communication
                                 duck->ParseFromString(std::string(buffer));
                                 receptionChannel->push(std::dynamic_pointer_cast<Message::Base>(duck));
                                 std::cout << "server: un canard est en " << duck->DebugString() << std::endl;
+                                // réveiller la boucle principale si elle attend des événements
+                                if (*onReception) (*onReception)();
                             }
                             break;
                         case Message::MessageType::win :
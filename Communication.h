@@ -8,6 +8,7 @@
 #include <vector>
 #include <queue>
 #include <condition_variable>
+#include <functional>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -57,6 +58,9 @@ namespace Communication
             std::mutex receptionChannelMutex;
             std::queue<PMessageBase> receptionChannel;
 
+            // appelée par le thread de reception après chaque message déposé, sous receptionChannelMutex
+            std::function<void()> onReception;
+
             std::mutex transmissionChannelMutex;
             std::queue<PMessageBase> transmissionChannel;
 
@@ -64,7 +68,7 @@ namespace Communication
             void stop();
     };
 
-    void receiveData(int, std::mutex*, std::queue<PMessageBase>*);
+    void receiveData(int, std::mutex*, std::queue<PMessageBase>*, std::function<void()>*);
     void sendData(int, std::mutex*, std::queue<PMessageBase>*);
 };
 
@@ -1,6 +1,8 @@
 // Définition de la classe Duck
 
 #include <iostream>
+#include <stdexcept>
+#include <stdlib.h>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
@@ -11,28 +13,63 @@
 #include <AL/alc.h>
 #include <AL/alut.h>
 
+#include <SDL_image.h>
+
 #include <utils.h>
 
 #include <Duck.h>
 #include <Light.h>
 #include <Texture2D.h>
+#include <ResourceCache.h>
 
 using namespace mesh;
 
 
-/** constructeur */
-Duck::Duck(int id): Mesh("Duck")
+// fichiers du modèle de canard
+static const std::string DuckObjFilename     = "data/10602_Rubber_Duck_v1_L3.obj";
+static const std::string DuckTextureFilename = "data/10602_Rubber_Duck_v1_diffuse.jpg";
+static const std::string DuckSoundFilename   = "data/Duck-quacking-sound.wav";
+
+// modèles partagés, indexés par le nom du fichier OBJ
+static ResourceCache<DuckModel> DuckModelCache;
+
+
+/**
+ * constructeur, charge le maillage, la texture et le son
+ * @param objfilename : nom du fichier OBJ
+ * @param texturefilename : nom du fichier image de la texture
+ * @param soundfilename : nom du fichier WAV
+ * @param deferred : si true, rien n'est chargé, il faudra appeler loadData puis upload
+ */
+DuckModel::DuckModel(std::string objfilename, std::string texturefilename, std::string soundfilename, bool deferred): Mesh("Duck")
 {
-    this->id = id;
-    // matériaux
-    m_Material = new MaterialTexture("data/10602_Rubber_Duck_v1_diffuse.jpg");
-    setMaterials(m_Material);
-    m_Draw = false;
-    m_Sound = false;
+    m_ObjFilename = objfilename;
+    m_TextureFilename = texturefilename;
+    m_SoundFilename = soundfilename;
+    m_Material = nullptr;
+    m_SoundBuffer = AL_NONE;
+    m_Image = nullptr;
+    m_SoundData = nullptr;
+    m_Resident = false;
+    m_Failed = false;
+
+    // chargement immédiat
+    if (! deferred) {
+        loadData();
+        upload();
+    }
+}
 
-    // charger le fichier obj
-    loadObj("data/10602_Rubber_Duck_v1_L3.obj");
-    
+
+/**
+ * lit le maillage, décode l'image et le son. N'appelle ni OpenGL ni OpenAL, peut donc
+ * être appelée par un thread de chargement.
+ * @throws std::runtime_error si un fichier ne peut pas être lu
+ */
+void DuckModel::loadData()
+{
+    // charger le fichier obj, optimisé pour le cache de sommets, avec ses niveaux de détail
+    loadObj(m_ObjFilename, 0, LOAD_OPTIMIZE | LOAD_LODS);
 
     // mise à l'échelle et rotation du canard (son .obj est mal orienté et trop grand)
     mat4 correction = mat4::create();
@@ -44,18 +81,122 @@ Duck::Duck(int id): Mesh("Duck")
     // recalcul des normales
     computeNormals();
 
-    // ouverture du flux audio à placer dans le buffer
-    std::string soundpathname = "data/Duck-quacking-sound.wav";
-    buffer = alutCreateBufferFromFile(soundpathname.c_str());
-    if (buffer == AL_NONE) {
-        std::cerr << "unable to open file " << soundpathname << std::endl;
-        alGetError();
-        throw std::runtime_error("file not found or not readable");
+    // décodage de l'image de la texture
+    m_Image = Texture2D::decode(m_TextureFilename);
+    if (m_Image == nullptr) {
+        throw std::runtime_error("file not found or not readable : " + m_TextureFilename);
     }
 
-    // lien buffer -> source
+    // décodage du son à placer dans le buffer
+    m_SoundData = alutLoadMemoryFromFile(m_SoundFilename.c_str(), &m_SoundFormat, &m_SoundSize, &m_SoundFrequency);
+    if (m_SoundData == nullptr) {
+        throw std::runtime_error("file not found or not readable : " + m_SoundFilename);
+    }
+}
+
+
+/**
+ * crée la texture, le shader, les VBOs et le buffer audio à partir des données de loadData.
+ * À appeler par le thread OpenGL.
+ */
+void DuckModel::upload()
+{
+    // matériau, la texture est partagée si elle est déjà chargée
+    m_Material = new MaterialTexture(Texture2D::load(m_TextureFilename, m_Image));
+    setMaterials(m_Material);
+    SDL_FreeSurface(m_Image);
+    m_Image = nullptr;
+
+    // VBOs du maillage, attributs quantifiés car ce modèle est dessiné par tous les canards
+    setQuantized(true);
+    prepareBuffers();
+
+    // buffer audio
+    alGenBuffers(1, &m_SoundBuffer);
+    alBufferData(m_SoundBuffer, m_SoundFormat, m_SoundData, m_SoundSize, m_SoundFrequency);
+    free(m_SoundData);
+    m_SoundData = nullptr;
+
+    m_Resident = true;
+}
+
+
+/**
+ * retourne le modèle partagé, il est chargé lors du premier appel
+ * et libéré quand le dernier canard qui l'emploie disparaît
+ * @return modèle partagé
+ */
+std::shared_ptr<DuckModel> DuckModel::get()
+{
+    return DuckModelCache.get(DuckObjFilename, []() {
+        return std::make_shared<DuckModel>(DuckObjFilename, DuckTextureFilename, DuckSoundFilename);
+    });
+}
+
+
+/**
+ * comme get, mais s'il faut charger le modèle, loadData est faite par un thread de
+ * chargement et upload par loader.processUploads : le modèle est retourné aussitôt,
+ * il n'est utilisable que quand isResident() devient vrai. Si le chargement échoue,
+ * hasFailed() devient vrai et le modèle est retiré du cache : un prochain appel le rechargera
+ * @param loader : chargeur en arrière-plan
+ * @return modèle partagé, peut-être pas encore chargé
+ */
+std::shared_ptr<DuckModel> DuckModel::getAsync(AsyncLoader& loader)
+{
+    return DuckModelCache.get(DuckObjFilename, [&loader]() {
+        std::shared_ptr<DuckModel> model = std::make_shared<DuckModel>(DuckObjFilename, DuckTextureFilename, DuckSoundFilename, true);
+        loader.submit(
+            [model]() { model->loadData(); },
+            [model]() { model->upload(); },
+            [model](const std::string&) {
+                // le message a été affiché par le chargeur, les canards en attente seront abandonnés
+                model->m_Failed = true;
+                DuckModelCache.remove(DuckObjFilename);
+            });
+        return model;
+    });
+}
+
+
+/** destructeur, libère le matériau et le son */
+DuckModel::~DuckModel()
+{
+    delete m_Material;
+    if (m_SoundBuffer != AL_NONE) alDeleteBuffers(1, &m_SoundBuffer);
+
+    // données d'un chargement interrompu
+    if (m_Image != nullptr) SDL_FreeSurface(m_Image);
+    free(m_SoundData);
+}
+
+
+/** constructeur, charge le modèle s'il ne l'est pas encore, le canard est aussitôt actif */
+Duck::Duck(int id): Duck(id, DuckModel::get())
+{
+    activate();
+}
+
+
+/**
+ * constructeur avec un modèle peut-être en cours de chargement, voir activate
+ * @param id : identifiant du canard
+ * @param model : modèle partagé, ex: DuckModel::getAsync
+ */
+Duck::Duck(int id, std::shared_ptr<DuckModel> model)
+{
+    this->id = id;
+    m_Draw = false;
+    m_Sound = false;
+    m_Lod = 0;
+    m_Visible = true;
+    m_Active = false;
+
+    // maillage, matériau et son partagés avec les autres canards
+    m_Model = model;
+
+    // source sonore, le buffer lui sera associé par activate
     alGenSources(1, &source);
-    alSourcei(source, AL_BUFFER, buffer);
 
     // propriétés de la source à l'origine
     alSource3f(source, AL_POSITION, 0, 0, 0); // on positionne la source à (0,0,0) par défaut
@@ -83,14 +224,21 @@ Duck::Duck(int id): Mesh("Duck")
 
 
 /**
- * définit la lampe
- * @param light : instance de Light spécifiant les caractéristiques de la lampe
+ * termine la préparation du canard quand les ressources de son modèle sont chargées
+ * @return true si le canard est prêt à être dessiné et à faire du bruit
  */
-void Duck::setLight(Light* light)
+bool Duck::activate()
 {
-    m_Material->setLight(light);
+    if (m_Active) return true;
+    if (! m_Model->isResident()) return false;
+
+    // lien buffer -> source
+    alSourcei(source, AL_BUFFER, m_Model->getSoundBuffer());
+    m_Active = true;
+    return true;
 }
 
+
 void Duck::setDraw(bool b)
 {
 	m_Draw = b;
@@ -112,20 +260,45 @@ void Duck::onRender(const mat4& matP, const mat4& matVM)
 {
    	/** dessin OpenGL **/
    	mat4 local_vm;
-  	mat4::translate(local_vm, matVM, m_Position);
-   	mat4::rotateX(local_vm, local_vm, m_Orientation[0]);
-   	mat4::rotateY(local_vm, local_vm, m_Orientation[1]);//-Utils::Time * 0.8);
-   	mat4::rotateZ(local_vm, local_vm, m_Orientation[2]);
+   	getModelMatrix(local_vm);
+   	mat4::multiply(local_vm, matVM, local_vm);
 
-    if (m_Draw)
+    if (isDrawn())
     {
-	    onDraw(matP, local_vm);
+	    m_Model->onDraw(matP, local_vm, m_Lod);
 	}
 
     /** sonorisation OpenAL **/
+    updateSound(matVM);
+}
+
+
+/**
+ * calcule la matrice de placement du canard dans la scène : position puis orientation
+ * @param model : reçoit la matrice
+ */
+void Duck::getModelMatrix(mat4& model)
+{
+    mat4::identity(model);
+    mat4::translate(model, model, m_Position);
+    mat4::rotateX(model, model, m_Orientation[0]);
+    mat4::rotateY(model, model, m_Orientation[1]);//-Utils::Time * 0.8);
+    mat4::rotateZ(model, model, m_Orientation[2]);
+}
+
 
+/**
+ * positionne la source sonore du canard par rapport à la caméra
+ * @param matV : matrice de la caméra
+ */
+void Duck::updateSound(const mat4& matV)
+{
     if (m_Sound)
     {
+        mat4 local_vm;
+        getModelMatrix(local_vm);
+        mat4::multiply(local_vm, matV, local_vm);
+
 	    // obtenir la position relative à la caméra
 	    vec4 pos = vec4::fromValues(0,0,0,1);   // point en (0,0,0)
 	    vec4::transformMat4(pos, pos, local_vm);
@@ -141,6 +314,39 @@ void Duck::onRender(const mat4& matP, const mat4& matVM)
 }
 
 
+/**
+ * calcule la sphère englobante du canard en coordonnées scène
+ * @param center : reçoit le centre de la sphère
+ * @return rayon de la sphère
+ */
+float Duck::getBoundingSphere(vec3& center)
+{
+    mat4 model = mat4::create();
+    getModelMatrix(model);
+    vec3::transformMat4(center, m_Model->getBoundingSphereCenter(), model);
+    return m_Model->getBoundingSphereRadius();
+}
+
+
+/**
+ * choisit le niveau de détail du canard d'après sa taille à l'écran, voir Mesh::selectLod
+ * @param matP : matrice de projection
+ * @param matV : matrice de la caméra
+ * @param height : hauteur de la vue en pixels
+ */
+void Duck::selectLod(const mat4& matP, const mat4& matV, float height)
+{
+    // distance du canard à la caméra, sans descendre sous le plan avant
+    vec3 pos = vec3::create();
+    vec3::transformMat4(pos, m_Position, matV);
+    float distance = std::max(vec3::length(pos), 0.1f);
+
+    // taille en pixels d'une unité de longueur à cette distance : matP[5] = 1/tan(fovy/2)
+    mat4 projection = matP;
+    float pixelsperunit = projection[5] * height * 0.5f / distance;
+    m_Lod = m_Model->selectLod(pixelsperunit, m_Lod);
+}
+
 
 vec3& Duck::getPosition()
 {
@@ -168,10 +374,6 @@ void Duck::setOrientation(vec3 ori)
 /** destructeur */
 Duck::~Duck()
 {
-    // libération du matériau
-    delete m_Material;
-
-    // libération des ressources openal
+    // libération de la source openal, le buffer appartient au modèle
     alDeleteSources(1, &source);
-    alDeleteBuffers(1, &buffer);
 }
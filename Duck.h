@@ -3,22 +3,147 @@
 
 // Définition de la classe Duck
 
+#include <memory>
+
+#include <AL/al.h>
+
 #include <Mesh.h>
 #include <Light.h>
 #include <MaterialTexture.h>
+#include <AsyncLoader.h>
 #include <gl-matrix.h>
 
 
-class Duck: public Mesh
+/**
+ * Ressources communes à tous les canards : maillage (et ses VBOs), matériau (texture et shader) et son.
+ * Elles ne sont chargées qu'une seule fois, voir DuckModel::get
+ * Le chargement se fait en deux étapes : loadData lit et décode les fichiers sans appeler OpenGL
+ * ni OpenAL, puis upload crée les ressources OpenGL et OpenAL. Voir getAsync pour les faire faire
+ * en arrière-plan.
+ */
+class DuckModel: public Mesh
 {
 private:
 
+    /** noms des fichiers */
+    std::string m_ObjFilename;
+    std::string m_TextureFilename;
+    std::string m_SoundFilename;
+
     /** matériau */
     MaterialTexture* m_Material;
 
+    /** buffer contenant le son */
+    ALuint m_SoundBuffer;
+
+    /** image et son décodés par loadData, en attente de upload */
+    SDL_Surface* m_Image;
+    ALvoid* m_SoundData;
+    ALenum m_SoundFormat;
+    ALsizei m_SoundSize;
+    ALfloat m_SoundFrequency;
+
+    /** true quand upload a été faite : le modèle peut être dessiné */
+    bool m_Resident;
+
+    /** true si loadData a échoué : le modèle ne sera jamais dessiné */
+    bool m_Failed;
+
+public:
+
+    /**
+     * constructeur, charge le maillage, la texture et le son
+     * @param objfilename : nom du fichier OBJ
+     * @param texturefilename : nom du fichier image de la texture
+     * @param soundfilename : nom du fichier WAV
+     * @param deferred : si true, rien n'est chargé, il faudra appeler loadData puis upload
+     */
+    DuckModel(std::string objfilename, std::string texturefilename, std::string soundfilename, bool deferred=false);
+
+    /** destructeur, libère le matériau et le son */
+    ~DuckModel();
+
+    /**
+     * lit le maillage, décode l'image et le son. N'appelle ni OpenGL ni OpenAL, peut donc
+     * être appelée par un thread de chargement.
+     * @throws std::runtime_error si un fichier ne peut pas être lu
+     */
+    void loadData();
+
+    /**
+     * crée la texture, le shader, les VBOs et le buffer audio à partir des données de loadData.
+     * À appeler par le thread OpenGL.
+     */
+    void upload();
+
+    /**
+     * indique si le modèle est entièrement chargé et peut être dessiné
+     * @return true après upload
+     */
+    bool isResident()
+    {
+        return m_Resident;
+    }
+
+    /**
+     * indique si le chargement en arrière-plan du modèle a échoué, voir getAsync
+     * @return true si le modèle ne deviendra jamais résident
+     */
+    bool hasFailed()
+    {
+        return m_Failed;
+    }
+
+    /**
+     * retourne le modèle partagé, il est chargé lors du premier appel
+     * et libéré quand le dernier canard qui l'emploie disparaît
+     * @return modèle partagé
+     */
+    static std::shared_ptr<DuckModel> get();
+
+    /**
+     * comme get, mais s'il faut charger le modèle, loadData est faite par un thread de
+     * chargement et upload par loader.processUploads : le modèle est retourné aussitôt,
+     * il n'est utilisable que quand isResident() devient vrai. Si le chargement échoue,
+     * hasFailed() devient vrai et le modèle est retiré du cache : un prochain appel le rechargera
+     * @param loader : chargeur en arrière-plan
+     * @return modèle partagé, peut-être pas encore chargé
+     */
+    static std::shared_ptr<DuckModel> getAsync(AsyncLoader& loader);
+
+    /**
+     * retourne le matériau du modèle
+     * @return matériau
+     */
+    MaterialTexture* getMaterial()
+    {
+        return m_Material;
+    }
+
+    /**
+     * retourne le buffer OpenAL contenant le son
+     * @return buffer OpenAL
+     */
+    ALuint getSoundBuffer()
+    {
+        return m_SoundBuffer;
+    }
+};
+
+
+/**
+ * Instance d'un canard : sa position, son orientation et sa source sonore
+ * Le maillage, la texture et le son sont partagés, voir DuckModel
+ */
+class Duck
+{
+private:
+
+    /** ressources partagées */
+    std::shared_ptr<DuckModel> m_Model;
 
-    /** buffers pour la gestion du son */
-    ALuint buffer, source;
+    /** source sonore de ce canard */
+    ALuint source;
 
     /** position 3D du cube */
     vec3 m_Position;
@@ -28,15 +153,46 @@ private:
 
     bool m_Draw, m_Sound;
 
+    /** niveau de détail dessiné, voir selectLod */
+    int m_Lod;
+
+    /** false si le canard est hors du champ de la caméra, voir Scene::drawDucks */
+    bool m_Visible;
+
+    /** true quand le son du modèle a été associé à la source, voir activate */
+    bool m_Active;
+
 public:
 
     // id pour la partie multijoeur
     int id;
 
-    /** constructeur, crée le maillage */
+    /** constructeur, charge le modèle s'il ne l'est pas encore, le canard est aussitôt actif */
     Duck(int id);
 
-    /** destructeur, libère le maillage et l'audio */
+    /**
+     * constructeur avec un modèle peut-être en cours de chargement, voir activate
+     * @param id : identifiant du canard
+     * @param model : modèle partagé, ex: DuckModel::getAsync
+     */
+    Duck(int id, std::shared_ptr<DuckModel> model);
+
+    /**
+     * termine la préparation du canard quand les ressources de son modèle sont chargées
+     * @return true si le canard est prêt à être dessiné et à faire du bruit
+     */
+    bool activate();
+
+    /**
+     * indique si le canard ne pourra jamais être activé car son modèle n'a pas pu être chargé
+     * @return true si le chargement du modèle a échoué
+     */
+    bool hasFailed()
+    {
+        return m_Model->hasFailed();
+    }
+
+    /** destructeur, libère la source audio (le modèle est partagé) */
     ~Duck();
 
     /**
@@ -46,6 +202,70 @@ public:
      */
     void onRender(const mat4& matP, const mat4& matMV);
 
+    /**
+     * calcule la matrice de placement du canard dans la scène : position puis orientation
+     * @param model : reçoit la matrice
+     */
+    void getModelMatrix(mat4& model);
+
+    /**
+     * positionne la source sonore du canard par rapport à la caméra
+     * @param matV : matrice de la caméra
+     */
+    void updateSound(const mat4& matV);
+
+    /**
+     * indique si le canard doit être dessiné : affiché, dans le champ et chargé
+     * @return true si le canard est à dessiner
+     */
+    bool isDrawn()
+    {
+        return m_Draw && m_Visible && m_Active;
+    }
+
+    /**
+     * retourne le modèle partagé du canard
+     * @return modèle
+     */
+    DuckModel* getModel()
+    {
+        return m_Model.get();
+    }
+
+    /**
+     * choisit le niveau de détail du canard d'après sa taille à l'écran, voir Mesh::selectLod
+     * @param matP : matrice de projection
+     * @param matV : matrice de la caméra
+     * @param height : hauteur de la vue en pixels
+     */
+    void selectLod(const mat4& matP, const mat4& matV, float height);
+
+    /**
+     * calcule la sphère englobante du canard en coordonnées scène
+     * @param center : reçoit le centre de la sphère
+     * @return rayon de la sphère
+     */
+    float getBoundingSphere(vec3& center);
+
+    /**
+     * indique si le canard est dans le champ de la caméra, sinon il n'est pas dessiné
+     * mais son son continue d'être positionné
+     * @param visible : false si le canard est hors du champ
+     */
+    void setVisible(bool visible)
+    {
+        m_Visible = visible;
+    }
+
+    /**
+     * retourne le niveau de détail choisi par selectLod
+     * @return niveau, 0 pour le maillage complet
+     */
+    int getLod()
+    {
+        return m_Lod;
+    }
+
     /**
      * retourne la position % scèce du cube
      * @return vec3 position
@@ -79,12 +299,6 @@ public:
      * modifie la propriete de son
 =     */
     void setSound(bool b);
-
-    /**
-     * définit la lampe
-     * @param light : instance de Light spécifiant les caractéristiques de la lampe
-     */
-    void setLight(Light* light);
 };
 
 #endif
@@ -27,26 +27,16 @@ Ground::Ground(): Mesh("sol")
     setMaterials(m_Material);
 
     // ajout des sommets
-    Vertex* P1 = new Vertex(this, -100.0, 0.0, +100.0); P1->setTexCoords(  0.0,   0.0); P1->setNormal(0.0,1.0,0.0);
-    Vertex* P2 = new Vertex(this, +100.0, 0.0, +100.0); P2->setTexCoords(200.0,   0.0); P2->setNormal(0.0,1.0,0.0);
-    Vertex* P3 = new Vertex(this, +100.0, 0.0, -100.0); P3->setTexCoords(200.0, 200.0); P3->setNormal(0.0,1.0,0.0);
-    Vertex* P4 = new Vertex(this, -100.0, 0.0, -100.0); P4->setTexCoords(  0.0, 200.0); P4->setNormal(0.0,1.0,0.0);
+    Vertex P1 = addVertex(-100.0, 0.0, +100.0).setTexCoords(  0.0,   0.0).setNormal(0.0,1.0,0.0);
+    Vertex P2 = addVertex(+100.0, 0.0, +100.0).setTexCoords(200.0,   0.0).setNormal(0.0,1.0,0.0);
+    Vertex P3 = addVertex(+100.0, 0.0, -100.0).setTexCoords(200.0, 200.0).setNormal(0.0,1.0,0.0);
+    Vertex P4 = addVertex(-100.0, 0.0, -100.0).setTexCoords(  0.0, 200.0).setNormal(0.0,1.0,0.0);
 
     // ajout des triangles
     addQuad(P1, P2, P3, P4);
 }
 
 
-/**
- * définit la lampe
- * @param light : instance de Light spécifiant les caractéristiques de la lampe
- */
-void Ground::setLight(Light* light)
-{
-    m_Material->setLight(light);
-}
-
-
 /** destructeur */
 Ground::~Ground()
 {
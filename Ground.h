@@ -21,12 +21,6 @@ public:
     Ground();
 
     virtual ~Ground();
-
-    /**
-     * définit la lampe
-     * @param light : instance de Light spécifiant les caractéristiques de la lampe
-     */
-    void setLight(Light* light);
 };
 
 #endif
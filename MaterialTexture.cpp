@@ -10,6 +10,7 @@
 #include <utils.h>
 
 #include <MaterialTexture.h>
+#include <FrameUniforms.h>
 
 
 /**
@@ -19,14 +20,39 @@
  * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
  */
 MaterialTexture::MaterialTexture(std::string filename, GLenum filtering, GLenum repetition) : Material("MaterialTexture")
+{
+    initShader();
+
+    /** charger la texture, elle est partagée avec les autres matériaux qui l'emploient */
+    m_Texture = Texture2D::load(filename, filtering, repetition);
+}
+
+
+/**
+ * constructeur avec une texture déjà chargée, ex: par Texture2D::load après un décodage en arrière-plan
+ * @param texture : texture partagée
+ */
+MaterialTexture::MaterialTexture(std::shared_ptr<Texture2D> texture) : Material("MaterialTexture")
+{
+    initShader();
+    m_Texture = texture;
+}
+
+
+/**
+ * compile le shader et récupère l'emplacement de ses variables uniform
+ */
+void MaterialTexture::initShader()
 {
     /** définir le shader */
 
     // vertex shader
     std::string srcVertexShader =
         "#version 300 es\n"
-        "// matrices de transformation\n"
-        "uniform mat4 matP;\n"
+        + FrameUniforms::getDeclarations()
+        + getDequantizationFunctions()
+        + getInstancingFunctions() +
+        "// matrices de transformation de l'objet\n"
         "uniform mat4 matVM;\n"
         "uniform mat3 matN;\n"
         "\n"
@@ -42,9 +68,10 @@ MaterialTexture::MaterialTexture(std::string filename, GLenum filtering, GLenum
         "\n"
         "void main()\n"
         "{\n"
-        "    frgPosition = matVM * vec4(glVertex, 1.0);\n"
+        "    mat4 vm = instanceMatVM(matVM);\n"
+        "    frgPosition = vm * vec4(dequantizePosition(glVertex), 1.0);\n"
         "    gl_Position = matP * frgPosition;\n"
-        "    frgN = matN * glNormal;\n"
+        "    frgN = instanceMatN(matN, vm) * dequantizeDirection(glNormal);\n"
         "    frgTexCoords = glTexCoords;\n"
         "}";
 
@@ -52,16 +79,11 @@ MaterialTexture::MaterialTexture(std::string filename, GLenum filtering, GLenum
     std::string srcFragmentShader =
         "#version 300 es\n"
         "precision mediump float;\n"
+        "// caractéristiques de la lampe\n"
+        + FrameUniforms::getDeclarations() +
         "// couleur du matériau donnée par la texture\n"
         "uniform sampler2D txColor;\n"
         "\n"
-        "// paramètres du shader : caractéristiques de la lampe\n"
-        "uniform vec3 LightColor;        // couleur de la lampe\n"
-        "uniform vec4 LightPosition;     // position ou direction d'une lampe positionnelle ou directionnelle\n"
-        "uniform vec4 LightDirection;    // direction du cône pour une lampe spot\n"
-        "uniform float cosmaxangle;\n"
-        "uniform float cosminangle;\n"
-        "\n"
         "// informations venant du vertex shader\n"
         "in vec3 frgN;              // normale du fragment en coordonnées caméra\n"
         "in vec4 frgPosition;       // position du fragment en coordonnées caméra\n"
@@ -102,44 +124,21 @@ MaterialTexture::MaterialTexture(std::string filename, GLenum filtering, GLenum
 
     setShaders(srcVertexShader, srcFragmentShader);
 
-    // emplacement des variables uniform spécifiques
-    m_LightColorLoc     = glGetUniformLocation(m_ShaderId, "LightColor");
-    m_LightPositionLoc  = glGetUniformLocation(m_ShaderId, "LightPosition");
-    m_LightDirectionLoc = glGetUniformLocation(m_ShaderId, "LightDirection");
-    m_CosMaxAngleLoc    = glGetUniformLocation(m_ShaderId, "cosmaxangle");
-    m_CosMinAngleLoc    = glGetUniformLocation(m_ShaderId, "cosminangle");
-
-    /** charger la texture */
-    m_TextureLoc = glGetUniformLocation(m_ShaderId, "txColor");
-    m_Texture = new Texture2D(filename, filtering, repetition);
+    // emplacement des variables uniform spécifiques, la lampe est dans le bloc FrameData
+    m_TextureLoc        = glGetUniformLocation(m_ShaderId, "txColor");
 }
 
 
-/**
- * définit la lampe
- * @param light : instance de Light spécifiant les caractéristiques de la lampe
- */
-void MaterialTexture::setLight(Light* light)
+void MaterialTexture::bindTextures()
 {
-    // activer le shader
-    glUseProgram(m_ShaderId);
-
-    // fournir les infos de la lampe au shader
-    vec3::glUniform(m_LightColorLoc,     light->getColor());
-    vec4::glUniform(m_LightPositionLoc,  light->getPosition());
-    vec4::glUniform(m_LightDirectionLoc, light->getDirection());
-    glUniform1f(m_CosMinAngleLoc,        light->getCosMinAngle());
-    glUniform1f(m_CosMaxAngleLoc,        light->getCosMaxAngle());
+    // activer la texture sur l'unité 0
+    m_Texture->setTextureUnit(GL_TEXTURE0, m_TextureLoc);
 }
 
 
-void MaterialTexture::select(Mesh* mesh, const mat4& matP, const mat4& matVM)
+GLuint MaterialTexture::getTextureId()
 {
-    // méthode de la superclasse (active le shader)
-    Material::select(mesh, matP, matVM);
-
-    // activer la texture sur l'unité 0
-    m_Texture->setTextureUnit(GL_TEXTURE0, m_TextureLoc);
+    return m_Texture->m_TextureID;
 }
 
 
@@ -155,6 +154,6 @@ void MaterialTexture::deselect()
 
 MaterialTexture::~MaterialTexture()
 {
-    delete m_Texture;
+    // la texture est libérée quand son dernier utilisateur disparaît
 }
 
@@ -15,14 +15,10 @@ private:
 
     // texture
     GLint m_TextureLoc;
-    Texture2D* m_Texture;
+    std::shared_ptr<Texture2D> m_Texture;
 
-    // variables uniform du shader
-    int m_LightColorLoc;
-    int m_LightPositionLoc;
-    int m_LightDirectionLoc;
-    int m_CosMaxAngleLoc;
-    int m_CosMinAngleLoc;
+    /** compile le shader et récupère l'emplacement de ses variables uniform */
+    void initShader();
 
 
 public:
@@ -35,15 +31,17 @@ public:
      */
     MaterialTexture(std::string filename, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
 
-
     /**
-     * définit la lampe
-     * @param light : instance de Light spécifiant les caractéristiques de la lampe
+     * constructeur avec une texture déjà chargée, ex: par Texture2D::load après un décodage en arrière-plan
+     * @param texture : texture partagée
      */
-    virtual void setLight(Light* light);
+    MaterialTexture(std::shared_ptr<Texture2D> texture);
+
+
+    virtual void bindTextures();
 
 
-    virtual void select(Mesh* mesh, const mat4& matP, const mat4& matVM);
+    virtual GLuint getTextureId();
 
 
     virtual void deselect();
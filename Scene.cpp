@@ -3,20 +3,35 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <algorithm>
 
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <AL/alut.h>
 
 #include <utils.h>
+#include <GpuProfiler.h>
 
 #include "Scene.h"
 
 
+// temps accordé à chaque image pour envoyer à OpenGL les ressources chargées en arrière-plan, en ms
+static const double UploadBudget = 2.0;
+
+// placement du sol, dessiné comme un exemplaire par l'arène
+static const std::vector<GLfloat> GroundMatrix = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+static const std::vector<int> GroundCounts = { 1 };
+
 /** constructeur */
-Scene::Scene() : client("127.0.0.1", 3333)
+Scene::Scene() : client("127.0.0.1", 3333), m_Arena(VertexFormat::COORDS_BIT | VertexFormat::TEXCOORDS_BIT | VertexFormat::NORMAL_BIT)
 {
     m_Ground = new Ground();
+    m_UseArena = GeometryArena::isSupported();
+
+    // toutes les données de chaque image sont écrites dans un seul VBO circulaire
+    m_FrameUniforms.setStreamBuffer(&m_StreamBuffer);
+    m_RenderQueue.setStreamBuffer(&m_StreamBuffer);
+    m_Arena.setStreamBuffer(&m_StreamBuffer);
 
     // caractéristiques de la lampe
     m_Light = new Light();
@@ -37,6 +52,9 @@ Scene::Scene() : client("127.0.0.1", 3333)
     m_MatV = mat4::create();
     m_MatVM = mat4::create();
     m_MatTMP = mat4::create();
+    m_Height = 1;
+    m_VisibleDucks = 0;
+    m_CulledDucks = 0;
 
     // gestion vue et souris
     m_Azimut    = 20.0;
@@ -44,6 +62,16 @@ Scene::Scene() : client("127.0.0.1", 3333)
     m_Distance  = 10.0;
     m_Center    = vec3::create();
     m_Clicked   = false;
+
+    // la première image est à dessiner, ensuite seulement quand quelque chose change
+    m_Dirty = true;
+    m_Animated = false;
+
+    // un canard reçu du réseau réveille la boucle principale quand elle attend des événements
+    {
+        std::lock_guard<std::mutex> lock(this->client.receptionChannelMutex);
+        this->client.onReception = []() { glfwPostEmptyEvent(); };
+    }
 }
 
 
@@ -56,6 +84,8 @@ void Scene::onSurfaceChanged(int width, int height)
 {
     // met en place le viewport
     glViewport(0, 0, width, height);
+    m_Height = height;
+    m_Dirty = true;
 
     // matrice de projection (champ de vision)
     mat4::perspective(m_MatP, Utils::radians(25.0), (float)width / height, 0.1, 100.0);
@@ -103,6 +133,7 @@ void Scene::onMouseMove(double x, double y)
     if (m_Elevation < -90.0) m_Elevation = -90.0;
     m_MousePrecX = x;
     m_MousePrecY = y;
+    m_Dirty = true;
 }
 
 
@@ -146,6 +177,23 @@ void Scene::onKeyDown(unsigned char code)
 
     // appliquer le décalage au centre de la rotation
     vec3::add(m_Center, m_Center, offset);
+    m_Dirty = true;
+}
+
+
+/**
+ * indique s'il faut redessiner : l'image affichée n'est plus à jour, la scène est animée, ou des
+ * canards et des ressources sont en attente (leur arrivée est traitée par onDrawFrame)
+ * @return false si onDrawFrame redessinerait la même image
+ */
+bool Scene::needsRedraw()
+{
+    if (m_Dirty || m_Animated) return true;
+    if (! m_PendingDucks.empty() || m_Loader.getPendingCount() > 0) return true;
+
+    // demandes de canards pas encore traitées, dans le doute si le thread réseau tient le verrou
+    std::unique_lock<std::mutex> lock(this->client.receptionChannelMutex, std::try_to_lock);
+    return ! lock.owns_lock() || ! this->client.receptionChannel.empty();
 }
 
 
@@ -154,9 +202,16 @@ void Scene::onKeyDown(unsigned char code)
  */
 void Scene::onDrawFrame()
 {
+    // les changements faits à partir d'ici seront dessinés par l'image suivante
+    m_Dirty = false;
+
     // Gérer les demandes de création de canards provenant du reseau
     this->handleDuckCreationRequest();
 
+    // envoyer les ressources chargées en arrière-plan, sans dépasser le budget, puis montrer les canards prêts
+    m_Loader.processUploads(UploadBudget);
+    this->activatePendingDucks();
+
     /** préparation des matrices **/
 
     // positionner la caméra
@@ -183,31 +238,79 @@ void Scene::onDrawFrame()
     // calculer la position et la direction de la lampe par rapport à la scène
     m_Light->transform(m_MatV);
 
-    // fournir position et direction en coordonnées caméra aux objets éclairés
-    m_Ground->setLight(m_Light);
+    // zone du VBO circulaire pour les données de cette image, libérée par la carte graphique
+    m_StreamBuffer.beginFrame();
+
+    // fournir caméra, temps, position et direction de la lampe à tous les shaders en une fois
+    m_FrameUniforms.setCamera(m_MatP, m_MatV);
+    m_FrameUniforms.setLight(m_Light);
+    m_FrameUniforms.update();
 
 
     /** dessin de l'image **/
 
     // effacer l'écran
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+        GPU_PROFILE_SCOPE("clear");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-    // dessiner le sol
-    m_Ground->onDraw(m_MatP, m_MatV);
+    // dessins de l'image, triés par shader et texture lors de leur exécution
+    m_RenderQueue.clear();
+    m_Arena.clearDraws();
+
+    // dessiner le sol, par l'arène si possible
+    if (! m_UseArena || ! m_Arena.addDraws(m_Ground, GroundMatrix, GroundCounts)) {
+        m_Ground->submit(m_RenderQueue, m_MatV);
+    }
 
     // dessiner le canard en mouvement
     this->drawDucks();
 
+    // les dessins ne sont faits qu'ici : sol et canards de l'arène, puis ceux de la file
+    {
+        GPU_PROFILE_SCOPE("arena");
+        m_Arena.execute(m_MatP, m_MatV);
+    }
+    {
+        GPU_PROFILE_SCOPE("queue");
+        m_RenderQueue.execute(m_MatP);
+    }
+
+    // la zone de cette image sera réécrite quand la carte graphique aura fini ces dessins
+    m_StreamBuffer.endFrame();
 }
 
 void Scene::createDuck(int id, float x, float y, float z, float ax, float ay, float az)
 {
-    Duck* duck = new Duck(id);
+    // le modèle est chargé en arrière-plan s'il ne l'est pas encore, le canard attend ses ressources
+    Duck* duck = new Duck(id, DuckModel::getAsync(m_Loader));
     duck->setPosition(vec3::fromValues(x, y, z));
     duck->setOrientation(vec3::fromValues(Utils::radians(ax), Utils::radians(ay), Utils::radians(az)));
-    duck->setDraw(true);
-    duck->setSound(true);
-    this->ducks.push_back(duck);
+    m_PendingDucks.push_back(duck);
+    this->activatePendingDucks();
+    m_Dirty = true;
+}
+
+void Scene::activatePendingDucks()
+{
+    for (size_t i = 0; i < m_PendingDucks.size(); )
+    {
+        Duck* duck = m_PendingDucks[i];
+        if (duck->hasFailed()) {
+            // son modèle n'a pas pu être chargé, il ne sera jamais prêt
+            delete duck;
+            m_PendingDucks.erase(m_PendingDucks.begin() + i);
+        } else if (duck->activate()) {
+            duck->setDraw(true);
+            duck->setSound(true);
+            this->ducks.push_back(duck);
+            m_PendingDucks.erase(m_PendingDucks.begin() + i);
+            m_Dirty = true;
+        } else {
+            i++;
+        }
+    }
 }
 
 void Scene::updateDucks(mat4 &tmp_v, vec4 &pos)
@@ -227,13 +330,78 @@ void Scene::updateDucks(mat4 &tmp_v, vec4 &pos)
 
 void Scene::drawDucks()
 {
+    // pyramide de vision en coordonnées scène
+    mat4::multiply(m_MatTMP, m_MatP, m_MatV);
+    m_Frustum.setMatrix(m_MatTMP);
+
+    // test de toutes les sphères englobantes en une passe
+    m_DuckSpheres.clear();
+    vec3 center = vec3::create();
     for (auto &duck : this->ducks)
     {
-        duck->setLight(this->m_Light);
-        duck->onRender(this->m_MatP, this->m_MatV);
-        duck->onRender(this->m_MatP, this->m_MatV);
+        float radius = duck->getBoundingSphere(center);
+        m_DuckSpheres.add(center, radius);
+    }
+    m_VisibleDucks = m_Frustum.cull(m_DuckSpheres, m_DuckVisible);
+    m_CulledDucks = this->ducks.size() - m_VisibleDucks;
+
+    // les lots de l'image précédente sont vidés mais gardent leur mémoire
+    for (DuckBatch& batch : m_DuckBatches)
+    {
+        for (auto& level : batch.levels) level.clear();
+    }
+
+    mat4 model = mat4::create();
+    for (size_t i = 0; i < this->ducks.size(); i++)
+    {
+        // les canards hors du champ ne sont pas dessinés, mais leur son est mis à jour
+        Duck* duck = this->ducks[i];
+        duck->setVisible(m_DuckVisible[i]);
+        duck->updateSound(this->m_MatV);
+        if (! duck->isDrawn()) continue;
+
+        // niveau de détail selon la taille du canard à l'écran
+        duck->selectLod(this->m_MatP, this->m_MatV, this->m_Height);
+
+        // lot du modèle de ce canard
+        DuckModel* duckmodel = duck->getModel();
+        size_t b = 0;
+        while (b < m_DuckBatches.size() && m_DuckBatches[b].model != duckmodel) b++;
+        if (b == m_DuckBatches.size()) m_DuckBatches.push_back(DuckBatch{duckmodel, {}});
+        DuckBatch& batch = m_DuckBatches[b];
+
+        // matrice de placement rangée avec celles du même niveau de détail
+        size_t level = duck->getLod();
+        if (batch.levels.size() <= level) batch.levels.resize(level + 1);
+        duck->getModelMatrix(model);
+        for (int k = 0; k < 16; k++) batch.levels[level].push_back(model[k]);
+    }
+
+    // un seul dessin par modèle et niveau de détail, les niveaux se suivent dans le VBO des matrices
+    for (DuckBatch& batch : m_DuckBatches)
+    {
+        m_InstanceMatrices.clear();
+        m_InstanceCounts.clear();
+        for (auto& level : batch.levels)
+        {
+            m_InstanceMatrices.insert(m_InstanceMatrices.end(), level.begin(), level.end());
+            m_InstanceCounts.push_back(level.size() / 16);
+        }
+        if (m_InstanceMatrices.empty()) continue;
+
+        if (m_UseArena && m_Arena.addDraws(batch.model, m_InstanceMatrices, m_InstanceCounts)) continue;
+        batch.model->submitInstanced(m_RenderQueue, this->m_MatV, m_InstanceMatrices, m_InstanceCounts);
     }
 
+    // les lots vides sont supprimés : leur modèle a pu être détruit et son adresse réutilisée par un autre
+    m_DuckBatches.erase(std::remove_if(m_DuckBatches.begin(), m_DuckBatches.end(), [](const DuckBatch& batch) {
+        for (auto& level : batch.levels)
+        {
+            if (! level.empty()) return false;
+        }
+        return true;
+    }), m_DuckBatches.end());
+
 }
 
 void Scene::destroyDucks()
@@ -242,8 +410,13 @@ void Scene::destroyDucks()
     {
         delete duck;
     }
+    for (auto &duck : m_PendingDucks)
+    {
+        delete duck;
+    }
 
     this->ducks.empty();
+    m_PendingDucks.clear();
 
 }
 
@@ -7,6 +7,12 @@
 #include <vector>
 
 #include "Light.h"
+#include "Frustum.h"
+#include "AsyncLoader.h"
+#include "RenderQueue.h"
+#include "GeometryArena.h"
+#include "StreamBuffer.h"
+#include "FrameUniforms.h"
 
 #include "Duck.h"
 #include "Ground.h"
@@ -22,17 +28,56 @@ private:
 
     // objets de la scène
     std::vector<Duck*> ducks;
+
+    // chargement des ressources en arrière-plan, et canards qui attendent les leurs
+    AsyncLoader m_Loader;
+    std::vector<Duck*> m_PendingDucks;
     Ground* m_Ground;
 
     // lampes
     Light* m_Light;
 
+    // variables uniform communes à tous les dessins de l'image : caméra, temps et lampe
+    FrameUniforms m_FrameUniforms;
+
     // matrices de transformation des objets de la scène
     mat4 m_MatP;
     mat4 m_MatV;
     mat4 m_MatVM;
     mat4 m_MatTMP;
 
+    // hauteur de la vue en pixels, pour la taille des objets à l'écran
+    int m_Height;
+
+    // élimination des canards hors du champ : pyramide de vision, sphères englobantes et résultats
+    Frustum m_Frustum;
+    SphereList m_DuckSpheres;
+    std::vector<uint8_t> m_DuckVisible;
+
+    // données réécrites à chaque image : bloc FrameData, matrices des canards, commandes de l'arène
+    StreamBuffer m_StreamBuffer;
+
+    // dessins de l'image en cours
+    RenderQueue m_RenderQueue;
+
+    // sommets du sol et des canards dans des VBOs communs, dessinés par glMultiDrawElementsIndirect si le pilote le permet
+    GeometryArena m_Arena;
+    bool m_UseArena;
+
+    // canards à dessiner en une fois : matrices de modèle de chaque niveau de détail, par modèle
+    struct DuckBatch
+    {
+        DuckModel* model;
+        std::vector<std::vector<GLfloat>> levels;
+    };
+    std::vector<DuckBatch> m_DuckBatches;
+    std::vector<GLfloat> m_InstanceMatrices;
+    std::vector<int> m_InstanceCounts;
+
+    // nombres de canards dessinés et écartés lors de la dernière image
+    int m_VisibleDucks;
+    int m_CulledDucks;
+
     // caméra table tournante
     float m_Azimut;
     float m_Elevation;
@@ -44,6 +89,12 @@ private:
     double m_MousePrecX;
     double m_MousePrecY;
 
+    // l'image affichée n'est plus à jour : caméra, taille de la vue ou liste des canards modifiées
+    bool m_Dirty;
+
+    // la scène change avec le temps, elle est toujours à redessiner
+    bool m_Animated;
+
 
 public:
 
@@ -93,12 +144,42 @@ public:
     /** Dessine l'image courante */
     void onDrawFrame();
 
+    /**
+     * indique s'il faut redessiner : l'image affichée n'est plus à jour, la scène est animée, ou des
+     * canards et des ressources sont en attente (leur arrivée est traitée par onDrawFrame)
+     * @return false si onDrawFrame redessinerait la même image
+     */
+    bool needsRedraw();
+
+    /**
+     * signale que l'image affichée n'est plus à jour
+     */
+    void invalidate()
+    {
+        m_Dirty = true;
+    }
+
+    /**
+     * indique si la scène change avec le temps (ex: canards qui tournent), elle est alors redessinée sans cesse
+     * @param animated : true si l'image dépend de Utils::Time
+     */
+    void setAnimated(bool animated)
+    {
+        m_Animated = animated;
+    }
+
     /**
      * @brief Initialise un canard
      *
      */
     void createDuck(int, float, float, float, float, float, float);
 
+    /**
+     * ajoute à la scène les canards en attente dont les ressources sont chargées,
+     * et abandonne ceux dont le modèle n'a pas pu être chargé
+     */
+    void activatePendingDucks();
+
     /**
      * @brief Met à jour les canards
      *
@@ -111,6 +192,43 @@ public:
      */
     void drawDucks();
 
+    /**
+     * retourne le nombre de canards dans le champ de la caméra lors de la dernière image
+     * @return nombre de canards dessinés
+     */
+    int getVisibleDuckCount()
+    {
+        return m_VisibleDucks;
+    }
+
+    /**
+     * retourne le nombre de canards hors du champ de la caméra lors de la dernière image
+     * @return nombre de canards non dessinés
+     */
+    int getCulledDuckCount()
+    {
+        return m_CulledDucks;
+    }
+
+    /**
+     * retourne les nombres de dessins et de liaisons (shaders, textures, buffers) de la dernière image
+     * @return compteurs de la file de rendu
+     */
+    const RenderQueue::Stats& getRenderStats()
+    {
+        return m_RenderQueue.getStats();
+    }
+
+    /**
+     * retourne le nombre d'appels de dessin de l'arène lors de la dernière image, ils ne sont pas dans getRenderStats
+     * @param commands : reçoit le nombre de commandes de dessin indirect
+     * @return nombre d'appels de dessin
+     */
+    int getArenaDrawCallCount(int& commands)
+    {
+        return m_Arena.getDrawCallCount(commands);
+    }
+
     /**
      * @brief Libère l'espace mémoires alloué au canards
      *
@@ -0,0 +1,267 @@
+// Mesure du chargement des fichiers OBJ : ancienne lecture ligne par ligne, puis Mesh::loadObj
+// avec 1, 2, 4... threads, et enfin relecture de sa copie binaire. Voir la cible bench du Makefile.
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <utils.h>
+#include <Mesh.h>
+
+using namespace mesh;
+
+
+/**
+ * crée un fichier OBJ contenant plusieurs copies d'un autre : les numéros des faces de chaque
+ * copie sont décalés du nombre de v, vt et vn des copies précédentes
+ * @param source : fichier OBJ à recopier
+ * @param copies : nombre de copies
+ * @param target : fichier à créer
+ * @return false si un des fichiers ne peut pas être ouvert
+ */
+static bool replicate(const std::string& source, int copies, const std::string& target)
+{
+    std::ifstream input(source.c_str());
+    if (! input.is_open()) return false;
+    std::vector<std::string> lines;
+    std::string line;
+    int counts[3] = { 0, 0, 0 };
+    while (std::getline(input, line)) {
+        if (line.compare(0, 2, "v ") == 0) counts[0]++;
+        if (line.compare(0, 3, "vt ") == 0) counts[1]++;
+        if (line.compare(0, 3, "vn ") == 0) counts[2]++;
+        lines.push_back(line);
+    }
+
+    std::ofstream output(target.c_str());
+    if (! output.is_open()) return false;
+    for (int copy=0; copy<copies; copy++) {
+        for (const std::string& line: lines) {
+            if (line.compare(0, 2, "f ") != 0) {
+                output << line << '\n';
+                continue;
+            }
+            // chaque coin v/vt/vn, les numéros absents restent absents
+            std::istringstream words(line.substr(2));
+            std::string word;
+            output << 'f';
+            while (words >> word) {
+                output << ' ';
+                const char* p = word.c_str();
+                for (int k=0; k<3 && *p != '\0'; k++) {
+                    if (k > 0) output << '/';
+                    char* next;
+                    long index = strtol(p, &next, 10);
+                    if (next != p) output << (index > 0 ? index + copy * counts[k] : index);
+                    p = (*next == '/') ? next + 1 : next;
+                    if (*next != '/') break;
+                }
+            }
+            output << '\n';
+        }
+    }
+    return true;
+}
+
+
+/**
+ * lit un fichier OBJ comme le faisait Mesh::loadObj avant l'analyse en parallèle : getline,
+ * strtok_r et atof sur chaque ligne, un sommet ajouté par triplet v/vt/vn nouveau et un
+ * triangle ajouté par addTriangle
+ * @param mesh : maillage à compléter
+ * @param filename : fichier OBJ
+ */
+static void loadObjByLine(Mesh* mesh, const std::string& filename)
+{
+    std::vector<vec3> coordlist;
+    std::vector<vec2> texcoordlist;
+    std::vector<vec3> normallist;
+
+    // sommets déjà créés, groupés par numéro de coordonnées : (vt, vn) et numéro du sommet
+    std::map<int, std::list<std::pair<std::pair<int, int>, Vertex>>> vertexlist;
+    auto findOrCreateVertex = [&](const char* word) -> Vertex {
+        int indices[3] = { -1, -1, -1 };
+        const int sizes[3] = { (int) coordlist.size(), (int) texcoordlist.size(), (int) normallist.size() };
+        for (int k=0; k<3 && *word != '\0'; k++) {
+            char* next;
+            long index = strtol(word, &next, 10);
+            if (next != word) indices[k] = (index < 0) ? sizes[k] + index : index - 1;
+            if (indices[k] >= sizes[k]) indices[k] = -1;
+            if (*next != '/') break;
+            word = next + 1;
+        }
+        if (indices[0] < 0) return Vertex();
+        std::list<std::pair<std::pair<int, int>, Vertex>>& candidates = vertexlist[indices[0]];
+        for (auto& candidate: candidates) {
+            if (candidate.first.first == indices[1] && candidate.first.second == indices[2]) return candidate.second;
+        }
+        Vertex vertex = mesh->addVertex(coordlist[indices[0]]);
+        if (indices[1] >= 0) vertex.setTexCoords(texcoordlist[indices[1]]);
+        if (indices[2] >= 0) vertex.setNormal(normallist[indices[2]]);
+        candidates.push_back(std::make_pair(std::make_pair(indices[1], indices[2]), vertex));
+        return vertex;
+    };
+
+    std::ifstream input(filename.c_str());
+    std::string line;
+    char* saveptr;
+    while (std::getline(input, line)) {
+        char* word = strtok_r(&line[0], " \t\r", &saveptr);
+        if (word == nullptr) continue;
+        if (strcmp(word, "f") == 0) {
+            if (! (word = strtok_r(nullptr, " \t\r", &saveptr))) continue;
+            Vertex v1 = findOrCreateVertex(word);
+            if (! (word = strtok_r(nullptr, " \t\r", &saveptr))) continue;
+            Vertex v2 = findOrCreateVertex(word);
+            while ((word = strtok_r(nullptr, " \t\r", &saveptr))) {
+                Vertex v3 = findOrCreateVertex(word);
+                if (v1.isValid() && v2.isValid() && v3.isValid()) mesh->addTriangle(v1, v2, v3);
+                v2 = v3;
+            }
+        } else if (strcmp(word, "v") == 0) {
+            float x = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            float y = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            float z = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            coordlist.push_back(vec3::fromValues(x, y, z));
+        } else if (strcmp(word, "vt") == 0) {
+            float u = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            float v = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            texcoordlist.push_back(vec2::fromValues(u, v));
+        } else if (strcmp(word, "vn") == 0) {
+            float nx = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            float ny = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            float nz = atof(strtok_r(nullptr, " \t\r", &saveptr));
+            normallist.push_back(vec3::fromValues(nx, ny, nz));
+        }
+    }
+}
+
+
+/**
+ * indique si deux maillages ont les mêmes sommets (coordonnées, texture, normale) et les mêmes triangles
+ */
+static bool sameMesh(Mesh* a, Mesh* b)
+{
+    if (a->getVertexCount() != b->getVertexCount() || a->getIndices() != b->getIndices()) return false;
+    const int attributes[3] = { VertexFormat::COORDS, VertexFormat::TEXCOORDS, VertexFormat::NORMAL };
+    for (int attribute: attributes) {
+        const size_t size = a->getVertexCount() * VertexFormat::components(attribute) * sizeof(GLfloat);
+        if (size > 0 && memcmp(a->getAttributeData(attribute), b->getAttributeData(attribute), size) != 0) return false;
+    }
+    return true;
+}
+
+
+/**
+ * exécute plusieurs fois un chargement dans un maillage neuf, sans les messages de Mesh
+ * @param runs : nombre d'exécutions
+ * @param load : chargement à mesurer
+ * @param result : reçoit le maillage du dernier chargement
+ * @return meilleure durée en secondes
+ */
+template<typename Load> static double measure(int runs, Load load, Mesh*& result)
+{
+    std::streambuf* output = std::cout.rdbuf(nullptr);
+    double best = 0.0;
+    for (int run=0; run<runs; run++) {
+        delete result;
+        result = new Mesh("bench");
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        load(result);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) best = seconds;
+    }
+    std::cout.rdbuf(output);
+    std::cout.clear();
+    return best;
+}
+
+
+/**
+ * point d'entrée : loadobj [fichier.obj [copies [exécutions]]]
+ */
+int main(int argc, char** argv)
+{
+    const std::string source = (argc > 1) ? argv[1] : "data/10602_Rubber_Duck_v1_L3.obj";
+    const int copies = (argc > 2) ? atoi(argv[2]) : 100;
+    const int runs = (argc > 3) ? std::max(1, atoi(argv[3])) : 3;
+
+    // les maillages suppriment leurs VBOs : il faut un contexte OpenGL, dans une fenêtre cachée
+    if (! glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "bench", NULL, NULL);
+    if (window == nullptr) {
+        std::cerr << "Failed to create window" << std::endl;
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    glewInit();
+
+    // fichier de test, recréé à chaque fois car il est vite fait
+    const std::string filename = "bench/replicated.obj";
+    const std::string binfilename = filename + ".mesh";
+    if (! replicate(source, copies, filename)) {
+        std::cerr << "Error : cannot replicate " << source << " into " << filename << std::endl;
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    std::ifstream file(filename.c_str(), std::ifstream::ate | std::ifstream::binary);
+    std::cout << filename << " : " << copies << " x " << source << ", " << file.tellg() / (1024*1024) << " MB, best of " << runs << " runs" << std::endl;
+
+    // ancienne lecture
+    Mesh* reference = nullptr;
+    const double byline = measure(runs, [&](Mesh* mesh) { loadObjByLine(mesh, filename); }, reference);
+    std::cout << "  " << std::left << std::setw(20) << "getline (previous)" << std::right << std::fixed << std::setprecision(3)
+        << std::setw(8) << byline << " s  " << reference->getVertexCount() << " vertices, " << reference->getTriangleCount() << " triangles" << std::endl;
+
+    // analyse en morceaux : la copie binaire est supprimée pour que le fichier OBJ soit relu à chaque fois ;
+    // au moins 4 threads, pour vérifier que le résultat ne dépend pas du découpage même avec peu de coeurs
+    const int maxthreads = std::max(4u, std::thread::hardware_concurrency());
+    std::vector<int> threadcounts;
+    for (int threads=1; threads<maxthreads; threads*=2) threadcounts.push_back(threads);
+    threadcounts.push_back(maxthreads);
+    double serial = 0.0;
+    for (int threads: threadcounts) {
+        Mesh* result = nullptr;
+        const double seconds = measure(runs, [&](Mesh* mesh) { remove(binfilename.c_str()); mesh->loadObj(filename, threads); }, result);
+        if (threads == 1) serial = seconds;
+        std::ostringstream name;
+        name << "loadObj, " << threads << " thread" << (threads > 1 ? "s" : "");
+        std::cout << "  " << std::left << std::setw(20) << name.str() << std::right << std::setw(8) << seconds << " s"
+            << "  x" << std::setprecision(2) << byline / seconds << " vs getline, x" << serial / seconds << " vs 1 thread"
+            << std::setprecision(3) << (sameMesh(result, reference) ? "" : "  DIFFERENT MESH") << std::endl;
+        delete result;
+    }
+
+    // relecture de la copie binaire écrite par le dernier chargement
+    Mesh* cached = nullptr;
+    const double binary = measure(runs, [&](Mesh* mesh) { mesh->loadObj(filename); }, cached);
+    std::cout << "  " << std::left << std::setw(20) << ".mesh cache" << std::right << std::setw(8) << binary << " s"
+        << (sameMesh(cached, reference) ? "" : "  DIFFERENT MESH") << std::endl;
+    delete cached;
+    delete reference;
+
+    remove(binfilename.c_str());
+    remove(filename.c_str());
+    glfwTerminate();
+    return EXIT_SUCCESS;
+}
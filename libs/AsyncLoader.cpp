@@ -0,0 +1,128 @@
+#include <iostream>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+
+#include <AsyncLoader.h>
+
+
+/**
+ * constructeur, démarre les threads de chargement
+ * @param threads : nombre de threads, 0 pour un de moins que le nombre de coeurs (au moins un)
+ */
+AsyncLoader::AsyncLoader(int threads)
+{
+    m_Running = 0;
+    m_Stop = false;
+
+    // le thread OpenGL garde un coeur pour lui
+    if (threads <= 0) threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int i=0; i<threads; i++) {
+        m_Workers.push_back(std::thread(&AsyncLoader::run, this));
+    }
+}
+
+
+/** destructeur, attend la fin des travaux en cours et abandonne les autres */
+AsyncLoader::~AsyncLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+        m_Jobs.clear();
+    }
+    m_Signal.notify_all();
+    for (std::thread& worker: m_Workers) worker.join();
+}
+
+
+/**
+ * ajoute un chargement. Si work lance une exception, elle est affichée, upload n'est pas appelée
+ * et failure est appelée à sa place.
+ * @param work : travail à faire par un thread de chargement, sans appel OpenGL
+ * @param upload : envoi à faire ensuite par le thread OpenGL, voir processUploads
+ * @param failure : fonction appelée par le thread OpenGL si work a échoué, peut être vide
+ */
+void AsyncLoader::submit(Task work, Task upload, Failure failure)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back(Job{work, upload, failure});
+    }
+    m_Signal.notify_one();
+}
+
+
+/**
+ * boucle des threads de chargement : attendre un chargement, faire son travail
+ * et placer son envoi (ou l'appel de sa fonction d'échec) dans la file du thread OpenGL
+ */
+void AsyncLoader::run()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true) {
+        m_Signal.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+        if (m_Stop) return;
+        Job job = m_Jobs.front();
+        m_Jobs.pop_front();
+        m_Running++;
+
+        // le travail est fait sans bloquer les autres threads
+        lock.unlock();
+        Task next = job.upload;
+        try {
+            job.work();
+        } catch (const std::exception& e) {
+            std::cerr << "AsyncLoader : " << e.what() << std::endl;
+            next = nullptr;
+            if (job.failure) {
+                const std::string message = e.what();
+                const Failure failure = job.failure;
+                next = [failure, message]() { failure(message); };
+            }
+        }
+        lock.lock();
+
+        m_Running--;
+        if (next) m_Uploads.push_back(next);
+    }
+}
+
+
+/**
+ * exécute les envois en attente, sur le thread qui l'appelle (celui d'OpenGL), tant que le
+ * budget n'est pas épuisé. Au moins un envoi est fait s'il y en a, pour que les chargements
+ * avancent toujours. Cette méthode n'attend jamais les threads de chargement.
+ * @param budget : durée maximale en millisecondes
+ * @return nombre d'envois exécutés
+ */
+int AsyncLoader::processUploads(double budget)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    int count = 0;
+    do {
+        // un envoi à faire ? ne pas attendre si un thread de chargement tient le verrou
+        Task upload;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex, std::try_to_lock);
+            if (! lock.owns_lock() || m_Uploads.empty()) break;
+            upload = m_Uploads.front();
+            m_Uploads.pop_front();
+        }
+        upload();
+        count++;
+    } while (std::chrono::duration<double, std::milli>(Clock::now() - start).count() < budget);
+    return count;
+}
+
+
+/**
+ * retourne le nombre de chargements pas encore terminés : travail ou envoi en attente
+ * @return nombre de chargements en cours
+ */
+int AsyncLoader::getPendingCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Jobs.size() + m_Running + m_Uploads.size();
+}
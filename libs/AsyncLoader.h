@@ -0,0 +1,98 @@
+#ifndef LIBS_ASYNCLOADER_H
+#define LIBS_ASYNCLOADER_H
+
+// Définition de la classe AsyncLoader : chargement des ressources en arrière-plan
+
+#include <string>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/**
+ * Cette classe charge des ressources en deux étapes :
+ * - le travail (lecture des fichiers, analyse, décodage) est fait par des threads de chargement
+ *   et produit des données en mémoire centrale,
+ * - l'envoi de ces données à OpenGL (ou OpenAL) est fait ensuite par le thread OpenGL, dans
+ *   processUploads, appelée à chaque image avec un budget de temps.
+ * Les deux étapes d'une même ressource partagent ses données par les captures des fonctions,
+ * ex: un shared_ptr sur l'objet en cours de chargement.
+ * Si le travail échoue, l'envoi est remplacé par l'appel d'une fonction d'échec, elle aussi
+ * faite par le thread OpenGL dans processUploads.
+ */
+class AsyncLoader
+{
+public:
+
+    /// fonction exécutée par un thread de chargement ou par le thread OpenGL
+    typedef std::function<void()> Task;
+
+    /// fonction appelée par le thread OpenGL quand le travail a échoué, reçoit le message de l'erreur
+    typedef std::function<void(const std::string&)> Failure;
+
+    /**
+     * constructeur, démarre les threads de chargement
+     * @param threads : nombre de threads, 0 pour un de moins que le nombre de coeurs (au moins un)
+     */
+    AsyncLoader(int threads=0);
+
+    /** destructeur, attend la fin des travaux en cours et abandonne les autres */
+    ~AsyncLoader();
+
+    /**
+     * ajoute un chargement. Si work lance une exception, elle est affichée, upload n'est pas appelée
+     * et failure est appelée à sa place.
+     * @param work : travail à faire par un thread de chargement, sans appel OpenGL
+     * @param upload : envoi à faire ensuite par le thread OpenGL, voir processUploads
+     * @param failure : fonction appelée par le thread OpenGL si work a échoué, peut être vide
+     */
+    void submit(Task work, Task upload, Failure failure=nullptr);
+
+    /**
+     * exécute les envois en attente, sur le thread qui l'appelle (celui d'OpenGL), tant que le
+     * budget n'est pas épuisé. Au moins un envoi est fait s'il y en a, pour que les chargements
+     * avancent toujours. Cette méthode n'attend jamais les threads de chargement.
+     * @param budget : durée maximale en millisecondes
+     * @return nombre d'envois exécutés
+     */
+    int processUploads(double budget);
+
+    /**
+     * retourne le nombre de chargements pas encore terminés : travail ou envoi en attente
+     * @return nombre de chargements en cours
+     */
+    int getPendingCount();
+
+private:
+
+    /// chargement : travail puis envoi
+    struct Job
+    {
+        Task work;
+        Task upload;
+        Failure failure;
+    };
+
+    /** boucle des threads de chargement */
+    void run();
+
+    /// threads de chargement
+    std::vector<std::thread> m_Workers;
+
+    /// chargements dont le travail n'est pas commencé, et ceux dont le travail est fait
+    std::deque<Job> m_Jobs;
+    std::deque<Task> m_Uploads;
+
+    /// nombre de travaux en cours dans les threads
+    int m_Running;
+
+    /// protège les files ci-dessus, les threads attendent le signal quand il n'y a rien à faire
+    std::mutex m_Mutex;
+    std::condition_variable m_Signal;
+    bool m_Stop;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <thread>
+#include <algorithm>
+
+#include <FramePacer.h>
+
+
+const int FramePacer::WINDOW;
+constexpr double FramePacer::SPIN_TIME;
+constexpr double FramePacer::LATENCY_MARGIN;
+
+
+/**
+ * convertit une durée en millisecondes
+ * @param duration : durée de l'horloge
+ * @return nombre de millisecondes
+ */
+static inline double toMilliseconds(FramePacer::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+
+/**
+ * convertit des millisecondes en durée de l'horloge
+ * @param milliseconds : nombre de millisecondes
+ * @return durée
+ */
+static inline FramePacer::Clock::duration fromMilliseconds(double milliseconds)
+{
+    return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+}
+
+
+/** constructeur, sans cadence maximale ni synchronisation verticale */
+FramePacer::FramePacer(): m_FrameTimes(WINDOW), m_WorkTimes(WINDOW)
+{
+    m_CapPeriod = 0.0;
+    m_SwapPeriod = 0.0;
+    m_LowLatency = false;
+    m_FrameStart = Clock::now();
+    m_WorkEstimate = 0.0;
+    m_FrameCount = 0;
+    m_Idle = false;
+}
+
+
+/**
+ * définit la cadence maximale
+ * @param fps : nombre maximal d'images par seconde, 0 pour ne pas limiter
+ */
+void FramePacer::setFrameRateCap(double fps)
+{
+    m_CapPeriod = (fps > 0.0) ? 1000.0 / fps : 0.0;
+}
+
+
+/**
+ * indique la synchronisation verticale choisie par glfwSwapInterval, pour le mode faible latence
+ * @param interval : nombre de rafraîchissements de l'écran par image, 0 sans synchronisation
+ * @param refreshrate : fréquence de rafraîchissement de l'écran, en Hz
+ */
+void FramePacer::setSwapInterval(int interval, double refreshrate)
+{
+    m_SwapPeriod = (interval > 0 && refreshrate > 0.0) ? 1000.0 * interval / refreshrate : 0.0;
+}
+
+
+/**
+ * active le mode faible latence, il n'a d'effet qu'avec la synchronisation verticale
+ * @param lowlatency : true pour retarder la lecture des événements jusqu'au dernier moment
+ */
+void FramePacer::setLowLatency(bool lowlatency)
+{
+    m_LowLatency = lowlatency;
+}
+
+
+/**
+ * attend jusqu'à l'instant indiqué : sommeil puis attente active des SPIN_TIME dernières ms
+ * @param target : instant de réveil
+ */
+void FramePacer::waitUntil(Clock::time_point target)
+{
+    const Clock::time_point wakeup = target - fromMilliseconds(SPIN_TIME);
+    if (Clock::now() < wakeup) std::this_thread::sleep_until(wakeup);
+    while (Clock::now() < target) std::this_thread::yield();
+}
+
+
+/**
+ * attend le début de l'image suivante, à appeler avant de lire les événements
+ */
+void FramePacer::waitForNextFrame()
+{
+    // glfwSwapBuffers vient de rendre la main : avec la synchronisation verticale, l'image vient d'être affichée
+    const Clock::time_point now = Clock::now();
+    Clock::time_point target = now;
+
+    // cadence maximale, comptée depuis le début de l'image précédente ; après un retard d'une image
+    // entière, on repart de maintenant plutôt que d'enchaîner des images pour le rattraper
+    if (m_CapPeriod > 0.0) {
+        const Clock::time_point next = m_FrameStart + fromMilliseconds(m_CapPeriod);
+        if (next > now - fromMilliseconds(m_CapPeriod)) target = std::max(target, next);
+    }
+
+    // faible latence : commencer le plus tard possible avant la synchronisation suivante
+    if (m_LowLatency && m_SwapPeriod > 0.0) {
+        const double delay = m_SwapPeriod - m_WorkEstimate - LATENCY_MARGIN;
+        if (delay > 0.0) target = std::max(target, now + fromMilliseconds(delay));
+    }
+    if (target > now) waitUntil(target);
+
+    // durée de l'image précédente, d'un début à l'autre, sauf si la boucle a attendu entre les deux
+    const Clock::time_point start = Clock::now();
+    if (m_FrameCount > 0 && ! m_Idle) m_FrameTimes.add(toMilliseconds(start - m_FrameStart));
+    m_FrameStart = start;
+    m_Idle = false;
+    m_FrameCount++;
+}
+
+
+/**
+ * termine le travail de l'image, à appeler juste avant glfwSwapBuffers
+ */
+void FramePacer::endWork()
+{
+    const double work = toMilliseconds(Clock::now() - m_FrameStart);
+    m_WorkTimes.add(work);
+
+    // l'estimation suit aussitôt une image plus longue, et ne redescend que lentement
+    m_WorkEstimate = std::max(work, m_WorkEstimate * 0.95 + work * 0.05);
+}
+
+
+/**
+ * écrit les durées minimale, moyenne et le 99e centile des images et du travail sur les dernières images
+ * @param out : flux où écrire
+ */
+void FramePacer::report(std::ostream& out)
+{
+    out << "CPU times (ms)" << std::endl;
+    m_FrameTimes.report(out, "frame");
+    m_WorkTimes.report(out, "work");
+}
@@ -0,0 +1,121 @@
+#ifndef LIBS_FRAMEPACER_H
+#define LIBS_FRAMEPACER_H
+
+// Définition de la classe FramePacer : cadence des images de la boucle principale
+
+#include <chrono>
+#include <iostream>
+
+#include <RollingStats.h>
+
+
+/**
+ * Cette classe règle la cadence de la boucle principale, qui appelle waitForNextFrame avant
+ * de lire les événements et de dessiner, puis endWork juste avant glfwSwapBuffers :
+ * - avec une cadence maximale (setFrameRateCap), waitForNextFrame dort jusqu'au début de l'image
+ *   suivante, puis attend activement les SPIN_TIME dernières millisecondes car le réveil d'un sommeil
+ *   n'est précis qu'à une milliseconde près environ,
+ * - en mode faible latence (setLowLatency) avec la synchronisation verticale, glfwSwapBuffers rend
+ *   la main juste après l'affichage : au lieu de lire les événements aussitôt et d'attendre ensuite
+ *   la synchronisation suivante dans glfwSwapBuffers, waitForNextFrame dort jusqu'au dernier moment
+ *   qui laisse le temps de dessiner, estimé sur les images précédentes. Les événements sont donc lus
+ *   moins d'une image avant d'être affichés.
+ * Les durées des images et du travail (de waitForNextFrame à endWork) sont gardées pour les statistiques.
+ */
+class FramePacer
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    /// nombre d'images gardées pour les statistiques
+    static const int WINDOW = 240;
+
+    /// durée de l'attente active à la fin de chaque attente, en ms
+    static constexpr double SPIN_TIME = 1.5;
+
+    /// marge du mode faible latence sur l'estimation du temps de dessin, en ms
+    static constexpr double LATENCY_MARGIN = 1.0;
+
+    /** constructeur, sans cadence maximale ni synchronisation verticale */
+    FramePacer();
+
+    /**
+     * définit la cadence maximale
+     * @param fps : nombre maximal d'images par seconde, 0 pour ne pas limiter
+     */
+    void setFrameRateCap(double fps);
+
+    /**
+     * indique la synchronisation verticale choisie par glfwSwapInterval, pour le mode faible latence
+     * @param interval : nombre de rafraîchissements de l'écran par image, 0 sans synchronisation
+     * @param refreshrate : fréquence de rafraîchissement de l'écran, en Hz
+     */
+    void setSwapInterval(int interval, double refreshrate);
+
+    /**
+     * active le mode faible latence, il n'a d'effet qu'avec la synchronisation verticale
+     * @param lowlatency : true pour retarder la lecture des événements jusqu'au dernier moment
+     */
+    void setLowLatency(bool lowlatency);
+
+    /**
+     * attend le début de l'image suivante, à appeler avant de lire les événements
+     */
+    void waitForNextFrame();
+
+    /**
+     * termine le travail de l'image, à appeler juste avant glfwSwapBuffers
+     */
+    void endWork();
+
+    /**
+     * signale que la boucle a attendu des événements sans dessiner : la durée de l'image suivante
+     * n'est pas comptée dans les statistiques
+     */
+    void idle()
+    {
+        m_Idle = true;
+    }
+
+    /**
+     * retourne le nombre d'images commencées depuis la création
+     */
+    long getFrameCount() const
+    {
+        return m_FrameCount;
+    }
+
+    /**
+     * écrit les durées minimale, moyenne et le 99e centile des images et du travail sur les dernières images
+     * @param out : flux où écrire
+     */
+    void report(std::ostream& out);
+
+private:
+
+    /**
+     * attend jusqu'à l'instant indiqué : sommeil puis attente active des SPIN_TIME dernières ms
+     * @param target : instant de réveil
+     */
+    static void waitUntil(Clock::time_point target);
+
+    /// durée minimale d'une image due à la cadence maximale, et d'un rafraîchissement de l'écran, en ms, 0 si aucune
+    double m_CapPeriod;
+    double m_SwapPeriod;
+    bool m_LowLatency;
+
+    /// début de l'image en cours, et estimation pessimiste du travail d'une image, en ms
+    Clock::time_point m_FrameStart;
+    double m_WorkEstimate;
+    long m_FrameCount;
+
+    /// la boucle a attendu des événements depuis la dernière image, voir idle
+    bool m_Idle;
+
+    /// durées des dernières images et de leur travail
+    RollingStats m_FrameTimes;
+    RollingStats m_WorkTimes;
+};
+
+#endif
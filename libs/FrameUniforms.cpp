@@ -0,0 +1,122 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <string.h>
+
+#include <utils.h>
+#include <FrameUniforms.h>
+#include <StreamBuffer.h>
+
+
+const GLuint FrameUniforms::BINDING;
+
+
+/**
+ * retourne la déclaration GLSL du bloc FrameData, à placer dans les shaders après #version :
+ * matP, matV, time, LightColor, LightPosition, LightDirection, cosminangle et cosmaxangle
+ * @return source GLSL du bloc
+ */
+std::string FrameUniforms::getDeclarations()
+{
+    return
+        "// variables communes à tous les dessins de l'image, voir FrameUniforms\n"
+        "// la précision est explicite, elle doit être la même dans le vertex et le fragment shader\n"
+        "layout(std140) uniform FrameData {\n"
+        "    highp mat4 matP;            // matrice de projection\n"
+        "    highp mat4 matV;            // matrice de vue\n"
+        "    highp vec3 LightColor;      // couleur de la lampe\n"
+        "    highp vec4 LightPosition;   // position ou direction d'une lampe positionnelle ou directionnelle\n"
+        "    highp vec4 LightDirection;  // direction du cône pour une lampe spot\n"
+        "    highp float time;\n"
+        "    highp float cosminangle;\n"
+        "    highp float cosmaxangle;\n"
+        "};\n"
+        "\n";
+}
+
+
+/**
+ * copie un vecteur dans un tableau du bloc
+ * @param destination : tableau de 4 GLfloat
+ * @param source : vecteur
+ * @param size : nombre de composantes de source
+ */
+template<typename VEC> static void copyVector(GLfloat* destination, VEC source, int size)
+{
+    for (int i=0; i<4; i++) destination[i] = (i < size) ? source[i] : 0.0f;
+}
+
+
+/** constructeur, l'UBO est créé lors du premier update */
+FrameUniforms::FrameUniforms()
+{
+    memset(&m_Block, 0, sizeof(m_Block));
+    m_BufferId = -1;
+    m_StreamBuffer = nullptr;
+}
+
+
+/** destructeur, supprime l'UBO */
+FrameUniforms::~FrameUniforms()
+{
+    if (m_BufferId >= 0) Utils::deleteVBO(m_BufferId);
+}
+
+
+/**
+ * définit les matrices de la caméra
+ * @param matP : matrice de projection perpective
+ * @param matV : matrice de vue
+ */
+void FrameUniforms::setCamera(const mat4& matP, const mat4& matV)
+{
+    mat4 projection = matP;
+    mat4 view = matV;
+    for (int i=0; i<16; i++) {
+        m_Block.matP[i] = projection[i];
+        m_Block.matV[i] = view[i];
+    }
+}
+
+
+/**
+ * définit la lampe, sa position et sa direction doivent être calculées par Light::transform
+ * @param light : lampe éclairant la scène
+ */
+void FrameUniforms::setLight(Light* light)
+{
+    copyVector(m_Block.lightColor,     light->getColor(),     3);
+    copyVector(m_Block.lightPosition,  light->getPosition(),  4);
+    copyVector(m_Block.lightDirection, light->getDirection(), 4);
+    m_Block.cosMinAngle = light->getCosMinAngle();
+    m_Block.cosMaxAngle = light->getCosMaxAngle();
+}
+
+
+/**
+ * envoie le bloc dans l'UBO, avec le temps courant, et lie l'UBO au point BINDING
+ */
+void FrameUniforms::update()
+{
+    m_Block.time = Utils::Time;
+
+    // dans la zone de l'image du VBO circulaire, s'il y a de la place
+    if (m_StreamBuffer != nullptr) {
+        GLintptr offset = m_StreamBuffer->write(&m_Block, sizeof(m_Block), m_StreamBuffer->getUniformAlignment());
+        if (offset >= 0) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, m_StreamBuffer->getBufferId(), offset, sizeof(m_Block));
+            return;
+        }
+    }
+
+    // sinon l'UBO est entièrement réécrit à chaque image
+    if (m_BufferId < 0) {
+        GLuint id;
+        glGenBuffers(1, &id);
+        m_BufferId = id;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_BufferId);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(m_Block), &m_Block, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_BufferId);
+}
@@ -0,0 +1,103 @@
+#ifndef LIBS_FRAMEUNIFORMS_H
+#define LIBS_FRAMEUNIFORMS_H
+
+// Définition de la classe FrameUniforms : variables uniform communes à tous les dessins d'une image
+
+#include <string>
+#include <stddef.h>
+
+#include <gl-matrix.h>
+#include <utils.h>
+#include <Light.h>
+
+
+class StreamBuffer;
+
+
+/**
+ * Cette classe regroupe dans un UBO (disposition std140) les variables qui ne changent qu'une fois
+ * par image : matrices de projection et de vue, temps et lampe. Le bloc est lié au point BINDING,
+ * que Material::setShaders associe au bloc FrameData de chaque shader qui le déclare (voir
+ * getDeclarations) : il suffit de le mettre à jour une fois par image, pour tous les matériaux.
+ */
+class FrameUniforms
+{
+public:
+
+    /// point de liaison du bloc FrameData
+    static const GLuint BINDING = 0;
+
+    /**
+     * retourne la déclaration GLSL du bloc FrameData, à placer dans les shaders après #version :
+     * matP, matV, time, LightColor, LightPosition, LightDirection, cosminangle et cosmaxangle
+     * @return source GLSL du bloc
+     */
+    static std::string getDeclarations();
+
+    /** constructeur, l'UBO est créé lors du premier update */
+    FrameUniforms();
+
+    /** destructeur, supprime l'UBO */
+    ~FrameUniforms();
+
+    /**
+     * définit les matrices de la caméra
+     * @param matP : matrice de projection perpective
+     * @param matV : matrice de vue
+     */
+    void setCamera(const mat4& matP, const mat4& matV);
+
+    /**
+     * définit la lampe, sa position et sa direction doivent être calculées par Light::transform
+     * @param light : lampe éclairant la scène
+     */
+    void setLight(Light* light);
+
+    /**
+     * définit le VBO circulaire où écrire le bloc à chaque image au lieu de l'UBO propre
+     * @param stream : VBO de l'image en cours, nullptr pour employer l'UBO propre
+     */
+    void setStreamBuffer(StreamBuffer* stream)
+    {
+        m_StreamBuffer = stream;
+    }
+
+    /**
+     * envoie le bloc dans l'UBO, avec le temps courant, et lie l'UBO au point BINDING
+     */
+    void update();
+
+private:
+
+    /// contenu de l'UBO, à l'image du bloc FrameData en disposition std140
+    struct Block
+    {
+        GLfloat matP[16];               // décalage 0
+        GLfloat matV[16];               // 64
+        GLfloat lightColor[4];          // 128, vec3 aligné comme un vec4
+        GLfloat lightPosition[4];       // 144
+        GLfloat lightDirection[4];      // 160
+        GLfloat time;                   // 176
+        GLfloat cosMinAngle;            // 180
+        GLfloat cosMaxAngle;            // 184
+        GLfloat padding;                // taille arrondie à 192
+    };
+
+    // décalages imposés par la disposition std140 du bloc GLSL
+    static_assert(sizeof(Block) == 192, "unexpected FrameData size");
+    static_assert(offsetof(Block, lightColor) == 128, "unexpected LightColor offset");
+    static_assert(offsetof(Block, lightPosition) == 144, "unexpected LightPosition offset");
+    static_assert(offsetof(Block, lightDirection) == 160, "unexpected LightDirection offset");
+    static_assert(offsetof(Block, time) == 176, "unexpected time offset");
+    static_assert(offsetof(Block, cosMaxAngle) == 184, "unexpected cosmaxangle offset");
+
+    Block m_Block;
+
+    /// identifiant de l'UBO, -1 s'il n'est pas encore créé
+    GLint m_BufferId;
+
+    /// VBO circulaire de l'image, peut être nullptr
+    StreamBuffer* m_StreamBuffer;
+};
+
+#endif
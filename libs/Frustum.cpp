@@ -0,0 +1,115 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <math.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include <utils.h>
+#include <Frustum.h>
+
+
+/** constructeur, la pyramide est à définir par setMatrix */
+Frustum::Frustum()
+{
+    // tant que setMatrix n'a pas été appelée, tout est visible
+    for (int p=0; p<6; p++) {
+        m_Planes[p][0] = m_Planes[p][1] = m_Planes[p][2] = 0.0f;
+        m_Planes[p][3] = 1.0f;
+    }
+}
+
+
+/**
+ * extrait les six plans de la matrice indiquée (méthode de Gribb et Hartmann)
+ * @param matPV : matrice projection * vue pour des plans en coordonnées scène,
+ * ou projection * vue * modèle pour des plans en coordonnées objet
+ */
+void Frustum::setMatrix(const mat4& matPV)
+{
+    // un point est visible si -w <= x,y,z <= w après transformation : chaque plan
+    // est la somme ou la différence de la dernière ligne et d'une autre ligne de la matrice
+    mat4 m = matPV;
+    for (int p=0; p<6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? +1.0f : -1.0f;
+        for (int k=0; k<4; k++) {
+            m_Planes[p][k] = m[4*k+3] + sign * m[4*k+row];
+        }
+
+        // normalisation pour que ax+by+cz+d soit une distance
+        float length = sqrtf(m_Planes[p][0]*m_Planes[p][0] + m_Planes[p][1]*m_Planes[p][1] + m_Planes[p][2]*m_Planes[p][2]);
+        if (length > 0.0f) {
+            for (int k=0; k<4; k++) m_Planes[p][k] /= length;
+        }
+    }
+}
+
+
+/**
+ * indique si la sphère est au moins en partie dans la pyramide
+ * @param center : centre de la sphère
+ * @param radius : rayon de la sphère
+ * @return false si elle est entièrement en dehors
+ */
+bool Frustum::containsSphere(vec3 center, float radius) const
+{
+    for (int p=0; p<6; p++) {
+        const GLfloat* plane = m_Planes[p];
+        float distance = plane[0]*center[0] + plane[1]*center[1] + plane[2]*center[2] + plane[3];
+        if (distance < -radius) return false;
+    }
+    return true;
+}
+
+
+/**
+ * teste toutes les sphères de la liste, quatre à la fois si le processeur le permet
+ * @param spheres : sphères à tester
+ * @param visible : reçoit 1 pour chaque sphère au moins en partie dans la pyramide, 0 sinon
+ * @return nombre de sphères visibles
+ */
+size_t Frustum::cull(const SphereList& spheres, std::vector<uint8_t>& visible) const
+{
+    const size_t count = spheres.size();
+    visible.resize(count);
+    size_t visiblecount = 0;
+    size_t i = 0;
+
+#if defined(__SSE__)
+    // quatre sphères par itération : distances aux six plans calculées en parallèle
+    __m128 planes[6][4];
+    for (int p=0; p<6; p++) {
+        for (int k=0; k<4; k++) planes[p][k] = _mm_set1_ps(m_Planes[p][k]);
+    }
+    for (; i+4 <= count; i+=4) {
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+        __m128 minusr = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 inside = _mm_setzero_ps();
+        for (int p=0; p<6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+            __m128 infront = _mm_cmpge_ps(distance, minusr);
+            inside = (p == 0) ? infront : _mm_and_ps(inside, infront);
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k=0; k<4; k++) {
+            visible[i+k] = (mask >> k) & 1;
+            visiblecount += visible[i+k];
+        }
+    }
+#endif
+
+    // sphères restantes, ou toutes sans SSE
+    for (; i<count; i++) {
+        visible[i] = containsSphere(vec3::fromValues(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]) ? 1 : 0;
+        visiblecount += visible[i];
+    }
+    return visiblecount;
+}
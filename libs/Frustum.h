@@ -0,0 +1,81 @@
+#ifndef LIBS_FRUSTUM_H
+#define LIBS_FRUSTUM_H
+
+// Définition de la classe Frustum
+
+#include <vector>
+#include <stdint.h>
+
+#include <gl-matrix.h>
+#include <utils.h>
+
+
+/**
+ * Sphères englobantes rangées par composante (tous les x, puis tous les y...) pour que
+ * Frustum::cull puisse en tester plusieurs à la fois avec les instructions SIMD
+ */
+struct SphereList
+{
+    std::vector<float> x, y, z, radius;
+
+    void clear()
+    {
+        x.clear(); y.clear(); z.clear(); radius.clear();
+    }
+
+    void add(vec3 center, float r)
+    {
+        x.push_back(center[0]);
+        y.push_back(center[1]);
+        z.push_back(center[2]);
+        radius.push_back(r);
+    }
+
+    size_t size() const
+    {
+        return radius.size();
+    }
+};
+
+
+/**
+ * Pyramide de vision : les six plans qui délimitent ce que voit la caméra, pour écarter
+ * avant le dessin les objets qui sont entièrement en dehors
+ */
+class Frustum
+{
+private:
+
+    /// plans gauche, droit, bas, haut, avant et arrière : ax+by+cz+d >= 0 à l'intérieur, (a,b,c) normé
+    GLfloat m_Planes[6][4];
+
+public:
+
+    /** constructeur, la pyramide est à définir par setMatrix */
+    Frustum();
+
+    /**
+     * extrait les six plans de la matrice indiquée (méthode de Gribb et Hartmann)
+     * @param matPV : matrice projection * vue pour des plans en coordonnées scène,
+     * ou projection * vue * modèle pour des plans en coordonnées objet
+     */
+    void setMatrix(const mat4& matPV);
+
+    /**
+     * indique si la sphère est au moins en partie dans la pyramide
+     * @param center : centre de la sphère
+     * @param radius : rayon de la sphère
+     * @return false si elle est entièrement en dehors
+     */
+    bool containsSphere(vec3 center, float radius) const;
+
+    /**
+     * teste toutes les sphères de la liste, quatre à la fois si le processeur le permet
+     * @param spheres : sphères à tester
+     * @param visible : reçoit 1 pour chaque sphère au moins en partie dans la pyramide, 0 sinon
+     * @return nombre de sphères visibles
+     */
+    size_t cull(const SphereList& spheres, std::vector<uint8_t>& visible) const;
+};
+
+#endif
@@ -0,0 +1,484 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <algorithm>
+
+#include <utils.h>
+#include <GeometryArena.h>
+#include <Material.h>
+#include <StreamBuffer.h>
+
+
+/**
+ * indique si le pilote permet le dessin depuis l'arène (ARB_base_instance)
+ * @return true si l'arène est utilisable
+ */
+bool GeometryArena::isSupported()
+{
+    return GLEW_ARB_base_instance;
+}
+
+
+/**
+ * constructeur
+ * @param format : attributs des sommets de l'arène, combinaison des VertexFormat::Mask
+ */
+GeometryArena::GeometryArena(unsigned format)
+{
+    m_Format = format | VertexFormat::COORDS_BIT;
+    m_Stride = VertexFormat::stride(m_Format);
+    m_VertexCount = 0;
+    m_IndexCount = 0;
+    m_VertexBufferId = -1;
+    m_IndexBufferId = -1;
+    m_VertexCapacity = 0;
+    m_IndexCapacity = 0;
+    m_InstanceBufferId = -1;
+    m_IndirectBufferId = -1;
+    m_StreamBuffer = nullptr;
+    m_DrawCalls = 0;
+}
+
+
+/** destructeur, supprime les VBOs et les VAOs ; les maillages restent utilisables seuls */
+GeometryArena::~GeometryArena()
+{
+    for (auto& allocation: m_Allocations) allocation.first->m_Arena = nullptr;
+    for (const VertexArray& vertexarray: m_VertexArrays) {
+        glDeleteVertexArrays(1, &vertexarray.id);
+    }
+    Utils::deleteVBO(m_VertexBufferId);
+    Utils::deleteVBO(m_IndexBufferId);
+    Utils::deleteVBO(m_InstanceBufferId);
+    Utils::deleteVBO(m_IndirectBufferId);
+}
+
+
+/**
+ * réserve une plage, de préférence dans une place libérée, sinon à la fin
+ * @param freeranges : places libres
+ * @param size : nombre d'éléments actuellement employés, augmenté si la plage est à la fin
+ * @param count : nombre d'éléments à réserver
+ * @return plage réservée
+ */
+GeometryArena::Range GeometryArena::allocate(std::vector<Range>& freeranges, size_t& size, size_t count)
+{
+    // première place libre assez grande, le reste de la place reste libre
+    for (size_t i=0; i<freeranges.size(); i++) {
+        Range& place = freeranges[i];
+        if (place.count < count) continue;
+        Range range{place.first, count};
+        place.first += count;
+        place.count -= count;
+        if (place.count == 0) freeranges.erase(freeranges.begin() + i);
+        return range;
+    }
+
+    // sinon à la fin, en reprenant la dernière place libre si elle la touche
+    Range range{size, count};
+    if (!freeranges.empty() && freeranges.back().first + freeranges.back().count == size) {
+        range.first = freeranges.back().first;
+        freeranges.pop_back();
+    }
+    size = range.first + count;
+    return range;
+}
+
+
+/**
+ * rend une plage aux places libres, en la fusionnant avec ses voisines
+ * @param freeranges : places libres
+ * @param range : plage à libérer
+ */
+void GeometryArena::release(std::vector<Range>& freeranges, Range range)
+{
+    if (range.count == 0) return;
+
+    // les places libres sont rangées par position croissante
+    auto next = std::lower_bound(freeranges.begin(), freeranges.end(), range,
+        [](const Range& a, const Range& b) { return a.first < b.first; });
+    if (next != freeranges.end() && range.first + range.count == next->first) {
+        range.count += next->count;
+        next = freeranges.erase(next);
+    }
+    if (next != freeranges.begin()) {
+        Range& previous = *(next - 1);
+        if (previous.first + previous.count == range.first) {
+            previous.count += range.count;
+            return;
+        }
+    }
+    freeranges.insert(next, range);
+}
+
+
+/**
+ * copie un maillage dans l'arène
+ * @param mesh : maillage à copier
+ * @return sa place dans l'arène
+ */
+GeometryArena::Allocation& GeometryArena::add(Mesh* mesh)
+{
+    // indices du maillage complet puis ceux de ses niveaux de détail
+    const size_t vertexcount = mesh->getVertexCount();
+    const size_t indexcount = mesh->getIndices().size() + mesh->m_LodIndices.size();
+
+    Allocation& allocation = m_Allocations[mesh];
+    allocation.vertices = allocate(m_FreeVertices, m_VertexCount, vertexcount);
+    allocation.indices = allocate(m_FreeIndices, m_IndexCount, indexcount);
+    allocation.dirty.clear();
+    allocation.indicesChanged = false;
+    m_Vertices.resize(std::max(m_Vertices.size(), m_VertexCount * m_Stride));
+    m_Indices.resize(std::max(m_Indices.size(), m_IndexCount));
+    copyVertices(mesh, allocation, 0, vertexcount);
+    copyIndices(mesh, allocation);
+
+    mesh->m_Arena = this;
+    return allocation;
+}
+
+
+/**
+ * recopie les modifications d'un maillage à sa place dans l'arène
+ * @param mesh : maillage déjà présent
+ * @param allocation : sa place dans l'arène
+ * @return false si le maillage n'y tient plus : nombre de sommets ou d'indices changé
+ */
+bool GeometryArena::update(Mesh* mesh, Allocation& allocation)
+{
+    // les tailles sont comparées à chaque fois : des suppressions ne modifient pas toujours de sommets
+    const size_t indexcount = mesh->getIndices().size() + mesh->m_LodIndices.size();
+    if ((size_t) mesh->getVertexCount() != allocation.vertices.count || indexcount != allocation.indices.count) return false;
+
+    if (! allocation.dirty.empty()) {
+        copyVertices(mesh, allocation, allocation.dirty.begin, allocation.dirty.end);
+        allocation.dirty.clear();
+    }
+    if (allocation.indicesChanged) {
+        copyIndices(mesh, allocation);
+        allocation.indicesChanged = false;
+    }
+    return true;
+}
+
+
+/**
+ * copie des sommets d'un maillage à sa place dans l'arène
+ * @param mesh : maillage à copier
+ * @param allocation : sa place dans l'arène
+ * @param first : numéro du premier sommet à copier
+ * @param end : numéro du sommet qui suit le dernier à copier
+ */
+void GeometryArena::copyVertices(Mesh* mesh, const Allocation& allocation, size_t first, size_t end)
+{
+    // recopier chaque attribut à sa place dans les sommets entrelacés de l'arène ; rien si le
+    // maillage n'a aucun sommet, getAttributeData retourne alors nullptr
+    end = std::min(std::min(end, allocation.vertices.count), (size_t) mesh->getVertexCount());
+    if (first >= end) return;
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        if ((m_Format & (1u << attribute)) == 0) continue;
+        const int components = VertexFormat::components(attribute);
+        const GLfloat* source = mesh->getAttributeData(attribute) + first * components;
+        GLfloat* destination = m_Vertices.data() + (allocation.vertices.first + first) * m_Stride + VertexFormat::offset(m_Format, attribute);
+        for (size_t i=first; i<end; i++) {
+            for (int c=0; c<components; c++) destination[c] = source[c];
+            source += components;
+            destination += m_Stride;
+        }
+    }
+    m_DirtyVertices.add(allocation.vertices.first + first, allocation.vertices.first + end);
+}
+
+
+/**
+ * copie tous les indices d'un maillage à sa place dans l'arène et y place ses niveaux de détail
+ * @param mesh : maillage à copier
+ * @param allocation : sa place dans l'arène, ses niveaux sont redéfinis
+ */
+void GeometryArena::copyIndices(Mesh* mesh, Allocation& allocation)
+{
+    // indices du maillage complet puis de ses niveaux de détail, relatifs à son premier sommet (baseVertex)
+    const std::vector<GLuint>& indices = mesh->getIndices();
+    const std::vector<GLuint>& lodindices = mesh->m_LodIndices;
+    allocation.levels.clear();
+    allocation.levels.push_back(Range{allocation.indices.first, indices.size()});
+    for (const Mesh::LodLevel& lod: mesh->m_Lods) {
+        allocation.levels.push_back(Range{allocation.indices.first + indices.size() + lod.first*3, lod.count*3});
+    }
+
+    std::copy(indices.begin(), indices.end(), m_Indices.begin() + allocation.indices.first);
+    std::copy(lodindices.begin(), lodindices.end(), m_Indices.begin() + allocation.indices.first + indices.size());
+    m_DirtyIndices.add(allocation.indices.first, allocation.indices.first + allocation.indices.count);
+}
+
+
+/**
+ * retire un maillage de l'arène, sa place sera réemployée. Appelée par le destructeur du maillage.
+ * @param mesh : maillage à retirer
+ */
+void GeometryArena::remove(Mesh* mesh)
+{
+    auto found = m_Allocations.find(mesh);
+    if (found == m_Allocations.end()) return;
+    release(m_FreeVertices, found->second.vertices);
+    release(m_FreeIndices, found->second.indices);
+    m_Allocations.erase(found);
+    mesh->m_Arena = nullptr;
+
+    // ses dessins de l'image en cours ne sont plus valables
+    clearDraws();
+}
+
+
+/**
+ * signale que des sommets d'un maillage ont été modifiés, ils seront recopiés à son prochain dessin.
+ * Appelée par Mesh::markDirty.
+ * @param mesh : maillage modifié
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @param first : numéro du premier sommet modifié
+ * @param count : nombre de sommets modifiés
+ */
+void GeometryArena::markDirty(Mesh* mesh, int attribute, size_t first, size_t count)
+{
+    if ((m_Format & (1u << attribute)) == 0) return;
+    auto found = m_Allocations.find(mesh);
+    if (found == m_Allocations.end()) return;
+    found->second.dirty.add(first, first + count);
+}
+
+
+/**
+ * signale que les triangles ou les niveaux de détail d'un maillage ont été modifiés, tous ses
+ * indices seront recopiés à son prochain dessin. Appelée par Mesh::markTrianglesDirty et Mesh::clearLods.
+ * @param mesh : maillage modifié
+ */
+void GeometryArena::markIndicesDirty(Mesh* mesh)
+{
+    auto found = m_Allocations.find(mesh);
+    if (found == m_Allocations.end()) return;
+    found->second.indicesChanged = true;
+}
+
+
+/**
+ * vide la liste des dessins, à appeler au début de chaque image
+ */
+void GeometryArena::clearDraws()
+{
+    m_Matrices.clear();
+    m_Groups.clear();
+}
+
+
+/**
+ * ajoute les dessins de plusieurs exemplaires d'un maillage, une commande par niveau de détail.
+ * Le maillage est copié dans l'arène s'il n'y est pas encore.
+ * @param mesh : maillage à dessiner avec son matériau des faces
+ * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+ * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+ * @return false si le maillage ne peut pas être dessiné par l'arène, il faut alors le dessiner seul
+ */
+bool GeometryArena::addDraws(Mesh* mesh, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts)
+{
+    // l'arène ne dessine que les faces, avec un shader qui lit les matrices des exemplaires
+    Material* material = mesh->m_FacesMaterial;
+    if (material == nullptr || mesh->m_EdgesMaterial != nullptr) return false;
+    if (! material->isInstanced() || (material->getAttributeMask() & ~m_Format) != 0) return false;
+    if (mesh->m_Arena != nullptr && mesh->m_Arena != this) return false;
+    if (mesh->getVertexCount() == 0) return true;
+
+    // recopier ses modifications, ailleurs s'il a changé de taille
+    auto found = m_Allocations.find(mesh);
+    if (found != m_Allocations.end() && ! update(mesh, found->second)) {
+        release(m_FreeVertices, found->second.vertices);
+        release(m_FreeIndices, found->second.indices);
+        m_Allocations.erase(found);
+        found = m_Allocations.end();
+    }
+    const Allocation& allocation = (found != m_Allocations.end()) ? found->second : add(mesh);
+
+    // les commandes sont regroupées par matériau, il n'y en a que quelques-uns
+    DrawGroup* group = nullptr;
+    for (DrawGroup& other: m_Groups) {
+        if (other.material == material) group = &other;
+    }
+    if (group == nullptr) {
+        m_Groups.push_back(DrawGroup{material, {}});
+        group = &m_Groups.back();
+    }
+
+    // une commande par niveau de détail, ses matrices à la suite de celles déjà ajoutées
+    size_t instance = m_Matrices.size() / 16;
+    m_Matrices.insert(m_Matrices.end(), matrices.begin(), matrices.end());
+    for (int level=0; level<(int)levelcounts.size(); level++) {
+        const GLuint count = levelcounts[level];
+        if (count == 0) continue;
+        const Range& indices = allocation.levels[level < (int)allocation.levels.size() ? level : 0];
+        group->commands.push_back(DrawElementsIndirectCommand{
+            (GLuint) indices.count, count, (GLuint) indices.first, (GLint) allocation.vertices.first, (GLuint) instance});
+        instance += count;
+    }
+    return true;
+}
+
+
+/**
+ * envoie les parties modifiées des sommets et des indices
+ */
+void GeometryArena::upload()
+{
+    // les VAOs mémorisent le VBO des indices, il ne faut pas le lier ni le délier dans l'un d'eux
+    glBindVertexArray(0);
+
+    // tout est à renvoyer quand un VBO est réalloué, avec de la marge pour les maillages suivants
+    if (m_VertexBufferId < 0 || m_VertexCount > m_VertexCapacity) {
+        if (m_VertexBufferId < 0) {
+            GLuint id;
+            glGenBuffers(1, &id);
+            m_VertexBufferId = id;
+        }
+        m_VertexCapacity = std::max(m_VertexCount, m_VertexCapacity + m_VertexCapacity/2);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexBufferId);
+        glBufferData(GL_ARRAY_BUFFER, m_VertexCapacity * m_Stride * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+        m_DirtyVertices.add(0, m_VertexCount);
+    }
+    if (m_IndexBufferId < 0 || m_IndexCount > m_IndexCapacity) {
+        if (m_IndexBufferId < 0) {
+            GLuint id;
+            glGenBuffers(1, &id);
+            m_IndexBufferId = id;
+        }
+        m_IndexCapacity = std::max(m_IndexCount, m_IndexCapacity + m_IndexCapacity/2);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferId);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_IndexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+        m_DirtyIndices.add(0, m_IndexCount);
+    }
+
+    if (! m_DirtyVertices.empty()) {
+        const size_t stride = m_Stride * sizeof(GLfloat);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexBufferId);
+        glBufferSubData(GL_ARRAY_BUFFER, m_DirtyVertices.begin * stride, (m_DirtyVertices.end - m_DirtyVertices.begin) * stride,
+            m_Vertices.data() + m_DirtyVertices.begin * m_Stride);
+    }
+    m_DirtyVertices.clear();
+    if (! m_DirtyIndices.empty()) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferId);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, m_DirtyIndices.begin * sizeof(GLuint), (m_DirtyIndices.end - m_DirtyIndices.begin) * sizeof(GLuint),
+            m_Indices.data() + m_DirtyIndices.begin);
+    }
+    m_DirtyIndices.clear();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+/**
+ * lie le VAO de l'arène correspondant à la disposition des attributs d'un matériau, voir Mesh::bindVertexArray
+ * @param layout : disposition des attributs, voir Material::getVertexLayout
+ * @return true si le VAO existait déjà, false s'il vient d'être créé et que ses attributs sont à décrire
+ */
+bool GeometryArena::bindVertexArray(uint64_t layout)
+{
+    for (const VertexArray& vertexarray: m_VertexArrays) {
+        if (vertexarray.layout == layout) {
+            glBindVertexArray(vertexarray.id);
+            return true;
+        }
+    }
+    GLuint id;
+    glGenVertexArrays(1, &id);
+    glBindVertexArray(id);
+    m_VertexArrays.push_back(VertexArray{layout, id});
+
+    // le VBO des indices fait partie du VAO, il ne change pas quand il est agrandi
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferId);
+    return false;
+}
+
+
+/**
+ * envoie les parties modifiées de l'arène, les matrices et les commandes, puis fait un
+ * dessin indirect multiple par matériau
+ * @param matP : matrice de projection perpective
+ * @param matV : matrice de la caméra
+ */
+void GeometryArena::execute(const mat4& matP, const mat4& matV)
+{
+    m_DrawCalls = 0;
+    m_Commands.clear();
+    if (m_Groups.empty()) return;
+    upload();
+
+    // commandes de tous les matériaux à la suite
+    std::vector<size_t> firsts;
+    for (const DrawGroup& group: m_Groups) {
+        firsts.push_back(m_Commands.size());
+        m_Commands.insert(m_Commands.end(), group.commands.begin(), group.commands.end());
+    }
+    const bool multidraw = GLEW_ARB_multi_draw_indirect;
+    const size_t matrixsize = 16 * sizeof(GLfloat);
+    const size_t matricessize = m_Matrices.size() * sizeof(GLfloat);
+    const size_t commandssize = m_Commands.size() * sizeof(DrawElementsIndirectCommand);
+
+    // matrices de tous les dessins, le shader les lit comme des exemplaires à partir de baseInstance,
+    // dans le VBO circulaire de l'image s'il y a de la place, sinon dans celui de l'arène
+    GLint instancebuffer;
+    GLintptr instanceoffset = (m_StreamBuffer != nullptr) ? m_StreamBuffer->write(m_Matrices.data(), matricessize, matrixsize) : -1;
+    if (instanceoffset >= 0) {
+        instancebuffer = m_StreamBuffer->getBufferId();
+    } else {
+        if (m_InstanceBufferId < 0) {
+            GLuint id;
+            glGenBuffers(1, &id);
+            m_InstanceBufferId = id;
+        }
+        instancebuffer = m_InstanceBufferId;
+        instanceoffset = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBufferId);
+        glBufferData(GL_ARRAY_BUFFER, matricessize, m_Matrices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // commandes, de même
+    GLintptr indirectoffset = -1;
+    if (multidraw) {
+        if (m_StreamBuffer != nullptr) indirectoffset = m_StreamBuffer->write(m_Commands.data(), commandssize, sizeof(GLuint));
+        if (indirectoffset >= 0) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_StreamBuffer->getBufferId());
+        } else {
+            if (m_IndirectBufferId < 0) {
+                GLuint id;
+                glGenBuffers(1, &id);
+                m_IndirectBufferId = id;
+            }
+            indirectoffset = 0;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBufferId);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commandssize, m_Commands.data(), GL_STREAM_DRAW);
+        }
+    }
+
+    // un dessin par matériau
+    for (size_t g=0; g<m_Groups.size(); g++) {
+        Material* material = m_Groups[g].material;
+        const GLsizei count = m_Groups[g].commands.size();
+        material->bindProgram();
+        if (! material->bindVertexArray(this)) continue;
+        material->setUniforms(nullptr, matP, matV);
+        material->bindTextures();
+        material->selectInstances(instancebuffer, instanceoffset / matrixsize);
+        if (multidraw) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                (const GLvoid*) (indirectoffset + firsts[g] * sizeof(DrawElementsIndirectCommand)), count, 0);
+            m_DrawCalls++;
+        } else {
+            for (size_t c=firsts[g]; c<firsts[g] + count; c++) {
+                const DrawElementsIndirectCommand& command = m_Commands[c];
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                    (const GLvoid*) (command.firstIndex * sizeof(GLuint)), command.instanceCount, command.baseVertex, command.baseInstance);
+                m_DrawCalls++;
+            }
+        }
+        material->deselect();
+    }
+    if (multidraw) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
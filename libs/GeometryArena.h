@@ -0,0 +1,282 @@
+#ifndef LIBS_GEOMETRYARENA_H
+#define LIBS_GEOMETRYARENA_H
+
+// Définition de la classe GeometryArena : sommets et indices de plusieurs maillages dans deux VBOs communs
+
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+#include <gl-matrix.h>
+#include <utils.h>
+#include <Mesh.h>
+
+
+class Material;
+class StreamBuffer;
+
+
+/**
+ * Cette classe place les sommets (VBO entrelacé, en GLfloat) et les indices de plusieurs maillages
+ * dans un seul VBO de sommets et un seul VBO d'indices, chaque maillage en occupant une partie.
+ * Les dessins d'une image (addDraws) deviennent des commandes DrawElementsIndirectCommand : tous ceux
+ * d'un même matériau partent en un seul glMultiDrawElementsIndirect, quel que soit le nombre d'objets.
+ * Les données propres à chaque dessin, ici la matrice de modèle, sont lues par le shader comme les
+ * exemplaires de Mesh::onDrawInstanced : baseInstance de chaque commande désigne sa première matrice.
+ * Sans glMultiDrawElementsIndirect, les commandes sont faites une par une par
+ * glDrawElementsInstancedBaseVertexBaseInstance.
+ *
+ * NB: les maillages sont copiés lors de leur premier dessin. Leurs modifications sont signalées par
+ * Mesh::markDirty et Mesh::markTrianglesDirty et recopiées à leur dessin suivant, à une autre place
+ * si leur nombre de sommets ou d'indices a changé. Seules leurs faces sont dessinées, les maillages
+ * avec un matériau d'arêtes sont refusés.
+ */
+class GeometryArena
+{
+public:
+
+    /// commande de dessin indirect, disposition imposée par OpenGL
+    struct DrawElementsIndirectCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    /**
+     * indique si le pilote permet le dessin depuis l'arène (ARB_base_instance)
+     * @return true si l'arène est utilisable
+     */
+    static bool isSupported();
+
+    /**
+     * constructeur
+     * @param format : attributs des sommets de l'arène, combinaison des VertexFormat::Mask
+     */
+    GeometryArena(unsigned format);
+
+    /** destructeur, supprime les VBOs et les VAOs ; les maillages restent utilisables seuls */
+    ~GeometryArena();
+
+    /**
+     * définit le VBO circulaire où écrire les matrices et les commandes de chaque image
+     * @param stream : VBO de l'image en cours, nullptr pour employer ceux de l'arène
+     */
+    void setStreamBuffer(StreamBuffer* stream)
+    {
+        m_StreamBuffer = stream;
+    }
+
+    /**
+     * retire un maillage de l'arène, sa place sera réemployée. Appelée par le destructeur du maillage.
+     * @param mesh : maillage à retirer
+     */
+    void remove(Mesh* mesh);
+
+    /**
+     * signale que des sommets d'un maillage ont été modifiés, ils seront recopiés à son prochain dessin.
+     * Appelée par Mesh::markDirty.
+     * @param mesh : maillage modifié
+     * @param attribute : l'un des VertexFormat::Attribute
+     * @param first : numéro du premier sommet modifié
+     * @param count : nombre de sommets modifiés
+     */
+    void markDirty(Mesh* mesh, int attribute, size_t first, size_t count);
+
+    /**
+     * signale que les triangles ou les niveaux de détail d'un maillage ont été modifiés, tous ses
+     * indices seront recopiés à son prochain dessin. Appelée par Mesh::markTrianglesDirty et Mesh::clearLods.
+     * @param mesh : maillage modifié
+     */
+    void markIndicesDirty(Mesh* mesh);
+
+    /**
+     * vide la liste des dessins, à appeler au début de chaque image
+     */
+    void clearDraws();
+
+    /**
+     * ajoute les dessins de plusieurs exemplaires d'un maillage, une commande par niveau de détail.
+     * Le maillage est copié dans l'arène s'il n'y est pas encore.
+     * @param mesh : maillage à dessiner avec son matériau des faces
+     * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+     * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+     * @return false si le maillage ne peut pas être dessiné par l'arène, il faut alors le dessiner seul
+     */
+    bool addDraws(Mesh* mesh, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts);
+
+    /**
+     * envoie les parties modifiées de l'arène, les matrices et les commandes, puis fait un
+     * dessin indirect multiple par matériau
+     * @param matP : matrice de projection perpective
+     * @param matV : matrice de la caméra
+     */
+    void execute(const mat4& matP, const mat4& matV);
+
+    /**
+     * lie le VAO de l'arène correspondant à la disposition des attributs d'un matériau, voir Mesh::bindVertexArray
+     * @param layout : disposition des attributs, voir Material::getVertexLayout
+     * @return true si le VAO existait déjà, false s'il vient d'être créé et que ses attributs sont à décrire
+     */
+    bool bindVertexArray(uint64_t layout);
+
+    /**
+     * retourne les attributs des sommets de l'arène
+     * @return masque de VertexFormat
+     */
+    unsigned getFormat() const
+    {
+        return m_Format;
+    }
+
+    /**
+     * retourne l'identifiant du VBO des sommets, à jour après execute
+     */
+    GLint getVertexBufferId() const
+    {
+        return m_VertexBufferId;
+    }
+
+    /**
+     * retourne le nombre de commandes et d'appels OpenGL de dessin de la dernière image
+     * @param commands : reçoit le nombre de commandes
+     * @return nombre d'appels de dessin
+     */
+    int getDrawCallCount(int& commands) const
+    {
+        commands = m_Commands.size();
+        return m_DrawCalls;
+    }
+
+private:
+
+    /// plage d'éléments dans un VBO
+    struct Range
+    {
+        size_t first;
+        size_t count;
+    };
+
+    /// place d'un maillage dans l'arène
+    struct Allocation
+    {
+        Range vertices;
+        Range indices;
+        /// premier indice et nombre d'indices de chaque niveau de détail, dans l'arène
+        std::vector<Range> levels;
+        /// sommets du maillage à recopier, et true si ses indices sont à recopier
+        Mesh::DirtyRange dirty;
+        bool indicesChanged;
+    };
+
+    /// dessins d'un matériau
+    struct DrawGroup
+    {
+        Material* material;
+        std::vector<DrawElementsIndirectCommand> commands;
+    };
+
+    /// VAO pour une disposition des attributs
+    struct VertexArray
+    {
+        uint64_t layout;
+        GLuint id;
+    };
+
+    /**
+     * copie un maillage dans l'arène
+     * @param mesh : maillage à copier
+     * @return sa place dans l'arène
+     */
+    Allocation& add(Mesh* mesh);
+
+    /**
+     * recopie les modifications d'un maillage à sa place dans l'arène
+     * @param mesh : maillage déjà présent
+     * @param allocation : sa place dans l'arène
+     * @return false si le maillage n'y tient plus : nombre de sommets ou d'indices changé
+     */
+    bool update(Mesh* mesh, Allocation& allocation);
+
+    /**
+     * copie des sommets d'un maillage à sa place dans l'arène
+     * @param mesh : maillage à copier
+     * @param allocation : sa place dans l'arène
+     * @param first : numéro du premier sommet à copier
+     * @param end : numéro du sommet qui suit le dernier à copier
+     */
+    void copyVertices(Mesh* mesh, const Allocation& allocation, size_t first, size_t end);
+
+    /**
+     * copie tous les indices d'un maillage à sa place dans l'arène et y place ses niveaux de détail
+     * @param mesh : maillage à copier
+     * @param allocation : sa place dans l'arène, ses niveaux sont redéfinis
+     */
+    void copyIndices(Mesh* mesh, Allocation& allocation);
+
+    /**
+     * réserve une plage, de préférence dans une place libérée, sinon à la fin
+     * @param freeranges : places libres
+     * @param size : nombre d'éléments actuellement employés, augmenté si la plage est à la fin
+     * @param count : nombre d'éléments à réserver
+     * @return plage réservée
+     */
+    static Range allocate(std::vector<Range>& freeranges, size_t& size, size_t count);
+
+    /**
+     * rend une plage aux places libres, en la fusionnant avec ses voisines
+     * @param freeranges : places libres
+     * @param range : plage à libérer
+     */
+    static void release(std::vector<Range>& freeranges, Range range);
+
+    /**
+     * envoie les parties modifiées des sommets et des indices
+     */
+    void upload();
+
+    /// attributs des sommets, et nombre de GLfloat par sommet
+    unsigned m_Format;
+    int m_Stride;
+
+    /// copies des sommets et des indices, et parties à envoyer
+    std::vector<GLfloat> m_Vertices;
+    std::vector<GLuint> m_Indices;
+    size_t m_VertexCount;
+    size_t m_IndexCount;
+    Mesh::DirtyRange m_DirtyVertices;
+    Mesh::DirtyRange m_DirtyIndices;
+
+    /// places libérées par remove
+    std::vector<Range> m_FreeVertices;
+    std::vector<Range> m_FreeIndices;
+
+    /// maillages présents
+    std::map<Mesh*, Allocation> m_Allocations;
+
+    /// VBOs et leurs capacités en éléments
+    GLint m_VertexBufferId;
+    GLint m_IndexBufferId;
+    size_t m_VertexCapacity;
+    size_t m_IndexCapacity;
+
+    /// VBOs des matrices des dessins et des commandes, réécrits à chaque image sans StreamBuffer
+    GLint m_InstanceBufferId;
+    GLint m_IndirectBufferId;
+    StreamBuffer* m_StreamBuffer;
+
+    /// VAOs, voir bindVertexArray
+    std::vector<VertexArray> m_VertexArrays;
+
+    /// dessins de l'image : matrices, commandes par matériau, puis toutes les commandes à la suite
+    std::vector<GLfloat> m_Matrices;
+    std::vector<DrawGroup> m_Groups;
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+
+    /// nombre d'appels de dessin de la dernière image
+    int m_DrawCalls;
+};
+
+#endif
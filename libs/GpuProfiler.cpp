@@ -0,0 +1,230 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <string.h>
+#include <algorithm>
+
+#include <utils.h>
+#include <GpuProfiler.h>
+
+
+const int GpuProfiler::FRAMES;
+const int GpuProfiler::WINDOW;
+const int GpuProfiler::REPORT_INTERVAL;
+
+
+/**
+ * commence la mesure d'une partie
+ * @param name : nom de la partie, chaîne constante
+ */
+GpuProfiler::Scope::Scope(const char* name)
+{
+    m_Active = GpuProfiler::get().begin(name);
+}
+
+
+/** termine la mesure de la partie */
+GpuProfiler::Scope::~Scope()
+{
+    if (m_Active) GpuProfiler::get().end();
+}
+
+
+/**
+ * retourne le profileur unique
+ */
+GpuProfiler& GpuProfiler::get()
+{
+    static GpuProfiler profiler;
+    return profiler;
+}
+
+
+/** constructeur, voir get */
+GpuProfiler::GpuProfiler()
+{
+    m_Enabled = false;
+    m_InFrame = false;
+    m_Frame = 0;
+    m_FrameCount = 0;
+    m_Dropped = 0;
+}
+
+
+/**
+ * active ou désactive les mesures ; elles demandent ARB_timer_query
+ * @param enabled : true pour mesurer
+ * @param filename : fichier où écrire les statistiques, vide pour la sortie standard
+ */
+void GpuProfiler::setEnabled(bool enabled, const std::string& filename)
+{
+    if (enabled && ! GLEW_ARB_timer_query) {
+        std::cerr << "GpuProfiler : GL_ARB_timer_query is not supported" << std::endl;
+        enabled = false;
+    }
+    m_Enabled = enabled;
+    if (m_Output.is_open()) m_Output.close();
+    if (enabled && ! filename.empty()) {
+        m_Output.open(filename.c_str());
+        if (! m_Output) std::cerr << "GpuProfiler : cannot write " << filename << std::endl;
+    }
+}
+
+
+/**
+ * retourne le numéro d'une partie, en la créant si nécessaire
+ * @param name : nom de la partie
+ */
+int GpuProfiler::findScope(const char* name)
+{
+    // il n'y a que quelques parties
+    for (size_t i=0; i<m_Scopes.size(); i++) {
+        if (m_Scopes[i].name == name || strcmp(m_Scopes[i].name, name) == 0) return i;
+    }
+    m_Scopes.push_back(ScopeStats{name, RollingStats(WINDOW)});
+    return m_Scopes.size() - 1;
+}
+
+
+/**
+ * commence une requête comptée dans une partie
+ * @param scope : numéro de la partie
+ */
+void GpuProfiler::startSegment(int scope)
+{
+    GLuint query;
+    if (m_FreeQueries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = m_FreeQueries.back();
+        m_FreeQueries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    m_Frames[m_Frame].push_back(Segment{scope, query});
+}
+
+
+/**
+ * commence la mesure d'une partie, voir Scope
+ * @param name : nom de la partie, chaîne constante
+ * @return false si rien n'est mesuré : profileur désactivé ou hors d'une image
+ */
+bool GpuProfiler::begin(const char* name)
+{
+    if (! m_Enabled || ! m_InFrame) return false;
+
+    // suspendre la partie englobante
+    if (! m_Stack.empty()) glEndQuery(GL_TIME_ELAPSED);
+    const int scope = findScope(name);
+    m_Stack.push_back(scope);
+    startSegment(scope);
+    return true;
+}
+
+
+/**
+ * termine la mesure de la dernière partie commencée
+ */
+void GpuProfiler::end()
+{
+    if (m_Stack.empty()) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_Stack.pop_back();
+
+    // reprendre la partie englobante
+    if (! m_Stack.empty()) startSegment(m_Stack.back());
+}
+
+
+/**
+ * ajoute la durée d'une partie lors d'une image, obtenue par ses requêtes ou autrement
+ * @param name : nom de la partie
+ * @param milliseconds : durée
+ */
+void GpuProfiler::addSample(const char* name, double milliseconds)
+{
+    m_Scopes[findScope(name)].samples.add(milliseconds);
+}
+
+
+/**
+ * lit les requêtes d'un jeu si elles sont toutes terminées, puis les rend disponibles
+ * @param frame : numéro du jeu de requêtes
+ */
+void GpuProfiler::collect(int frame)
+{
+    std::vector<Segment>& segments = m_Frames[frame];
+    if (segments.empty()) return;
+
+    // les requêtes se terminent dans l'ordre : la dernière disponible, toutes le sont
+    GLint available = 0;
+    glGetQueryObjectiv(segments.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+        // temps propre de chaque partie, somme de ses intervalles
+        std::vector<double> durations(m_Scopes.size(), -1.0);
+        for (const Segment& segment: segments) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(segment.query, GL_QUERY_RESULT, &nanoseconds);
+            double& duration = durations[segment.scope];
+            duration = std::max(duration, 0.0) + nanoseconds * 1e-6;
+        }
+        for (size_t scope=0; scope<durations.size(); scope++) {
+            if (durations[scope] >= 0.0) addSample(m_Scopes[scope].name, durations[scope]);
+        }
+    } else {
+        m_Dropped++;
+    }
+    for (const Segment& segment: segments) m_FreeQueries.push_back(segment.query);
+    segments.clear();
+}
+
+
+/**
+ * commence une image : lit les résultats de l'image qui emploie le même jeu de requêtes,
+ * et affiche les statistiques toutes les REPORT_INTERVAL images
+ */
+void GpuProfiler::beginFrame()
+{
+    if (! m_Enabled) return;
+    m_Frame = (m_Frame + 1) % FRAMES;
+    collect(m_Frame);
+    m_InFrame = true;
+
+    m_FrameCount++;
+    if (m_FrameCount >= REPORT_INTERVAL) {
+        if (m_Output.is_open()) {
+            report(m_Output);
+        } else {
+            report(std::cout);
+        }
+        m_FrameCount = 0;
+        m_Dropped = 0;
+    }
+}
+
+
+/**
+ * termine l'image, et les parties restées ouvertes
+ */
+void GpuProfiler::endFrame()
+{
+    if (! m_InFrame) return;
+    if (! m_Stack.empty()) glEndQuery(GL_TIME_ELAPSED);
+    m_Stack.clear();
+    m_InFrame = false;
+}
+
+
+/**
+ * écrit une ligne par partie : durées minimale, moyenne et 99e centile sur les dernières images
+ * @param out : flux où écrire
+ */
+void GpuProfiler::report(std::ostream& out)
+{
+    out << "GPU times (ms)";
+    if (m_Dropped > 0) out << ", " << m_Dropped << " frames not ready";
+    out << std::endl;
+    for (const ScopeStats& stats: m_Scopes) {
+        stats.samples.report(out, stats.name);
+    }
+}
@@ -0,0 +1,186 @@
+#ifndef LIBS_GPUPROFILER_H
+#define LIBS_GPUPROFILER_H
+
+// Définition de la classe GpuProfiler : durées des parties de l'image sur la carte graphique
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+
+#include <utils.h>
+#include <RollingStats.h>
+
+
+/**
+ * mesure le temps passé par la carte graphique dans la suite du bloc C++ qui l'emploie, ex:
+ * { GPU_PROFILE_SCOPE("ducks"); mesh->onDraw(matP, matVM); }
+ * Sans effet si le profileur n'est pas activé, voir GpuProfiler::setEnabled
+ * @param name : nom de la partie mesurée, chaîne constante
+ */
+#define GPU_PROFILE_SCOPE(name) GpuProfiler::Scope GPU_PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define GPU_PROFILE_CONCAT(a, b) GPU_PROFILE_CONCAT2(a, b)
+#define GPU_PROFILE_CONCAT2(a, b) a##b
+
+
+/**
+ * Cette classe mesure la durée des parties nommées de chaque image sur la carte graphique, par
+ * des requêtes GL_TIME_ELAPSED, et affiche régulièrement leurs durées minimale, moyenne et le
+ * 99e centile sur les dernières images.
+ *
+ * Les résultats des requêtes d'une image ne sont lus que deux images plus tard (FRAMES jeux de
+ * requêtes) : la carte graphique les a presque toujours finies, sinon ils sont abandonnés plutôt
+ * que de les attendre. Une seule requête GL_TIME_ELAPSED peut être active : quand une partie
+ * commence dans une autre, la mesure de l'englobante est suspendue jusqu'à la fin de l'imbriquée.
+ * Chaque partie compte ainsi son temps propre, sans celui des parties qu'elle contient.
+ *
+ * Il n'y a qu'un profileur, voir get, employé par GPU_PROFILE_SCOPE.
+ */
+class GpuProfiler
+{
+public:
+
+    /// nombre de jeux de requêtes, une image est lue FRAMES-1 images après avoir été mesurée
+    static const int FRAMES = 2;
+
+    /// nombre d'images gardées pour les statistiques de chaque partie
+    static const int WINDOW = 240;
+
+    /// nombre d'images entre deux affichages des statistiques
+    static const int REPORT_INTERVAL = 300;
+
+    /**
+     * mesure d'une partie, du constructeur au destructeur, voir GPU_PROFILE_SCOPE
+     */
+    class Scope
+    {
+    public:
+        /**
+         * commence la mesure d'une partie
+         * @param name : nom de la partie, chaîne constante
+         */
+        Scope(const char* name);
+
+        /** termine la mesure de la partie */
+        ~Scope();
+
+    private:
+        bool m_Active;
+    };
+
+    /**
+     * retourne le profileur unique
+     */
+    static GpuProfiler& get();
+
+    /**
+     * active ou désactive les mesures ; elles demandent ARB_timer_query
+     * @param enabled : true pour mesurer
+     * @param filename : fichier où écrire les statistiques, vide pour la sortie standard
+     */
+    void setEnabled(bool enabled, const std::string& filename="");
+
+    /**
+     * indique si les mesures sont faites
+     */
+    bool isEnabled() const
+    {
+        return m_Enabled;
+    }
+
+    /**
+     * commence une image : lit les résultats de l'image qui emploie le même jeu de requêtes,
+     * et affiche les statistiques toutes les REPORT_INTERVAL images
+     */
+    void beginFrame();
+
+    /**
+     * termine l'image, et les parties restées ouvertes
+     */
+    void endFrame();
+
+    /**
+     * commence la mesure d'une partie, voir Scope
+     * @param name : nom de la partie, chaîne constante
+     * @return false si rien n'est mesuré : profileur désactivé ou hors d'une image
+     */
+    bool begin(const char* name);
+
+    /**
+     * termine la mesure de la dernière partie commencée
+     */
+    void end();
+
+    /**
+     * ajoute la durée d'une partie lors d'une image, obtenue par ses requêtes ou autrement
+     * @param name : nom de la partie
+     * @param milliseconds : durée
+     */
+    void addSample(const char* name, double milliseconds);
+
+    /**
+     * écrit une ligne par partie : durées minimale, moyenne et 99e centile sur les dernières images
+     * @param out : flux où écrire
+     */
+    void report(std::ostream& out);
+
+private:
+
+    /** constructeur, voir get */
+    GpuProfiler();
+
+    /// durées d'une partie : les WINDOW dernières
+    struct ScopeStats
+    {
+        const char* name;
+        RollingStats samples;
+    };
+
+    /// intervalle mesuré par une requête, compté dans une partie
+    struct Segment
+    {
+        int scope;
+        GLuint query;
+    };
+
+    /**
+     * retourne le numéro d'une partie, en la créant si nécessaire
+     * @param name : nom de la partie
+     */
+    int findScope(const char* name);
+
+    /**
+     * commence une requête comptée dans une partie
+     * @param scope : numéro de la partie
+     */
+    void startSegment(int scope);
+
+    /**
+     * lit les requêtes d'un jeu si elles sont toutes terminées, puis les rend disponibles
+     * @param frame : numéro du jeu de requêtes
+     */
+    void collect(int frame);
+
+    bool m_Enabled;
+    bool m_InFrame;
+
+    /// requêtes de chaque jeu, jeu de l'image en cours, et requêtes disponibles
+    std::vector<Segment> m_Frames[FRAMES];
+    int m_Frame;
+    std::vector<GLuint> m_FreeQueries;
+
+    /// parties ouvertes, la dernière est mesurée
+    std::vector<int> m_Stack;
+
+    /// statistiques des parties, dans l'ordre de leur première mesure
+    std::vector<ScopeStats> m_Scopes;
+
+    /// images mesurées, et images dont les résultats ont été abandonnés, depuis le dernier affichage
+    int m_FrameCount;
+    int m_Dropped;
+
+    /// fichier des statistiques, fermé pour la sortie standard
+    std::ofstream m_Output;
+};
+
+#endif
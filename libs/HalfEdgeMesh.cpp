@@ -0,0 +1,161 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <vector>
+
+#include <utils.h>
+#include <Mesh.h>
+#include <HalfEdgeMesh.h>
+
+
+// définition de la constante, nécessaire quand elle est passée par référence (ex: vector::assign)
+const int HalfEdgeMesh::NONE;
+
+
+/** constructeur d'une structure vide, voir build */
+HalfEdgeMesh::HalfEdgeMesh()
+{
+}
+
+
+/**
+ * constructeur, voir build
+ * @param indices : numéros des sommets, 3 par triangle
+ * @param vertexcount : nombre de sommets
+ */
+HalfEdgeMesh::HalfEdgeMesh(const std::vector<GLuint>& indices, size_t vertexcount)
+{
+    build(indices, vertexcount);
+}
+
+
+/**
+ * constructeur à partir des triangles d'un maillage
+ * @param mesh : maillage dont il faut la topologie
+ */
+HalfEdgeMesh::HalfEdgeMesh(Mesh* mesh)
+{
+    build(mesh->getIndices(), mesh->getVertexCount());
+}
+
+
+/**
+ * construit les demi-arêtes des triangles, en temps proportionnel à leur nombre : les demi-arêtes
+ * sont rangées par sommet de départ, l'opposée de a->b est cherchée parmi celles qui partent de b
+ * @param indices : numéros des sommets, 3 par triangle
+ * @param vertexcount : nombre de sommets
+ */
+void HalfEdgeMesh::build(const std::vector<GLuint>& indices, size_t vertexcount)
+{
+    m_Indices = indices;
+    const int halfedgecount = m_Indices.size();
+
+    // ranger les demi-arêtes par sommet de départ (tri par dénombrement)
+    std::vector<int> first(vertexcount + 1, 0);
+    for (GLuint vertex: m_Indices) first[vertex + 1]++;
+    for (size_t v=0; v<vertexcount; v++) first[v + 1] += first[v];
+    std::vector<int> outgoing(halfedgecount);
+    std::vector<int> fill(first.begin(), first.end() - 1);
+    for (int h=0; h<halfedgecount; h++) outgoing[fill[m_Indices[h]]++] = h;
+
+    // apparier a->b avec une demi-arête b->a encore libre, parmi les quelques demi-arêtes qui partent de b
+    m_Twins.assign(halfedgecount, NONE);
+    for (int h=0; h<halfedgecount; h++) {
+        if (m_Twins[h] != NONE) continue;
+        const GLuint a = m_Indices[h];
+        const GLuint b = getTarget(h);
+        for (int i=first[b]; i<first[b + 1]; i++) {
+            const int other = outgoing[i];
+            if (other != h && m_Twins[other] == NONE && getTarget(other) == a) {
+                m_Twins[h] = other;
+                m_Twins[other] = h;
+                break;
+            }
+        }
+    }
+
+    // demi-arête de départ de chaque sommet, de préférence sur le bord
+    m_VertexHalfEdges.assign(vertexcount, NONE);
+    for (size_t v=0; v<vertexcount; v++) {
+        for (int i=first[v]; i<first[v + 1]; i++) {
+            const int h = outgoing[i];
+            if (m_VertexHalfEdges[v] == NONE || m_Twins[h] == NONE) m_VertexHalfEdges[v] = h;
+            if (m_Twins[h] == NONE) break;
+        }
+    }
+}
+
+
+/**
+ * cherche la demi-arête qui va de a à b, en temps proportionnel au nombre de voisins de a
+ * @param a : sommet de départ
+ * @param b : sommet d'arrivée
+ * @return NONE si aucun triangle ne contient a->b
+ */
+int HalfEdgeMesh::findHalfEdge(GLuint a, GLuint b) const
+{
+    const int start = m_VertexHalfEdges[a];
+    int h = start;
+    while (h != NONE) {
+        if (getTarget(h) == b) return h;
+        h = getNextAround(h);
+        if (h == start) break;
+    }
+    return NONE;
+}
+
+
+/**
+ * retourne les sommets voisins du sommet (premier anneau), dans l'ordre de rotation
+ * @param vertex : numéro du sommet
+ * @param neighbours : reçoit les numéros des sommets voisins
+ */
+void HalfEdgeMesh::getOneRing(GLuint vertex, std::vector<GLuint>& neighbours) const
+{
+    neighbours.clear();
+    const int start = m_VertexHalfEdges[vertex];
+    int h = start;
+    while (h != NONE) {
+        neighbours.push_back(getTarget(h));
+        const int next = getNextAround(h);
+        // sur un bord, le dernier voisin n'est atteint que par le côté précédent du dernier triangle
+        if (next == NONE) neighbours.push_back(m_Indices[getPrev(h)]);
+        if (next == start) break;
+        h = next;
+    }
+}
+
+
+/**
+ * retourne les triangles qui contiennent le sommet, dans l'ordre de rotation
+ * @param vertex : numéro du sommet
+ * @param triangles : reçoit les numéros des triangles
+ */
+void HalfEdgeMesh::getVertexTriangles(GLuint vertex, std::vector<int>& triangles) const
+{
+    triangles.clear();
+    const int start = m_VertexHalfEdges[vertex];
+    int h = start;
+    while (h != NONE) {
+        triangles.push_back(getTriangle(h));
+        h = getNextAround(h);
+        if (h == start) break;
+    }
+}
+
+
+/**
+ * retourne chaque arête une seule fois, même si elle est partagée par deux triangles
+ * @param lines : reçoit les numéros des deux sommets de chaque arête
+ */
+void HalfEdgeMesh::getUniqueEdges(std::vector<GLuint>& lines) const
+{
+    lines.clear();
+    lines.reserve(m_Indices.size());
+    for (int h=0; h<(int)m_Indices.size(); h++) {
+        // une arête intérieure est prise par celle de ses deux demi-arêtes qui a le plus petit numéro
+        if (m_Twins[h] != NONE && m_Twins[h] < h) continue;
+        lines.push_back(m_Indices[h]);
+        lines.push_back(getTarget(h));
+    }
+}
@@ -0,0 +1,221 @@
+#ifndef LIBS_HALFEDGEMESH_H
+#define LIBS_HALFEDGEMESH_H
+
+// Définition de la classe HalfEdgeMesh : topologie d'un maillage en demi-arêtes
+
+#include <vector>
+
+#include <gl-matrix.h>
+#include <utils.h>
+
+
+class Mesh;
+
+
+/**
+ * Cette classe donne la topologie d'une liste de triangles sous forme de demi-arêtes, pour
+ * répondre en temps constant aux questions de voisinage : triangles et sommets autour d'un
+ * sommet, triangle de l'autre côté d'une arête, arêtes et sommets du bord.
+ *
+ * La demi-arête n°h est le côté n°h%3 du triangle n°h/3 : elle part du sommet indices[h] et
+ * arrive au sommet suivant du triangle. Les demi-arêtes suivante et précédente dans le triangle
+ * s'en déduisent, seule la demi-arête opposée (même arête parcourue en sens inverse par le triangle
+ * voisin) est mémorisée. Elle vaut NONE sur un bord du maillage ou sur une couture (sommets dédoublés).
+ *
+ * NB: la structure n'est pas mise à jour quand les triangles changent, il faut la reconstruire.
+ * Autour d'un sommet non-manifold (plusieurs éventails de triangles), seul l'un des éventails est parcouru.
+ */
+class HalfEdgeMesh
+{
+public:
+
+    /// absence de demi-arête : bord du maillage, ou sommet isolé
+    static const int NONE = -1;
+
+private:
+
+    /// numéros des sommets des triangles, 3 par triangle, donc sommet de départ de chaque demi-arête
+    std::vector<GLuint> m_Indices;
+
+    /// demi-arête opposée de chaque demi-arête, NONE sur un bord
+    std::vector<int> m_Twins;
+
+    /// une demi-arête qui part de chaque sommet, celle d'un bord s'il y en a un, NONE pour un sommet isolé
+    std::vector<int> m_VertexHalfEdges;
+
+public:
+
+    /** constructeur d'une structure vide, voir build */
+    HalfEdgeMesh();
+
+    /**
+     * constructeur, voir build
+     * @param indices : numéros des sommets, 3 par triangle
+     * @param vertexcount : nombre de sommets
+     */
+    HalfEdgeMesh(const std::vector<GLuint>& indices, size_t vertexcount);
+
+    /**
+     * constructeur à partir des triangles d'un maillage
+     * @param mesh : maillage dont il faut la topologie
+     */
+    HalfEdgeMesh(Mesh* mesh);
+
+    /**
+     * construit les demi-arêtes des triangles, en temps proportionnel à leur nombre : les demi-arêtes
+     * sont rangées par sommet de départ, l'opposée de a->b est cherchée parmi celles qui partent de b
+     * @param indices : numéros des sommets, 3 par triangle
+     * @param vertexcount : nombre de sommets
+     */
+    void build(const std::vector<GLuint>& indices, size_t vertexcount);
+
+    /**
+     * retourne le nombre de demi-arêtes, 3 par triangle
+     */
+    int getHalfEdgeCount() const
+    {
+        return m_Indices.size();
+    }
+
+    /**
+     * retourne le nombre de triangles
+     */
+    int getTriangleCount() const
+    {
+        return m_Indices.size() / 3;
+    }
+
+    /**
+     * retourne le nombre de sommets
+     */
+    int getVertexCount() const
+    {
+        return m_VertexHalfEdges.size();
+    }
+
+    /**
+     * retourne le triangle qui contient la demi-arête
+     * @param h : numéro de la demi-arête
+     */
+    static int getTriangle(int h)
+    {
+        return h / 3;
+    }
+
+    /**
+     * retourne la demi-arête suivante dans le même triangle
+     * @param h : numéro de la demi-arête
+     */
+    static int getNext(int h)
+    {
+        return (h % 3 == 2) ? h - 2 : h + 1;
+    }
+
+    /**
+     * retourne la demi-arête précédente dans le même triangle
+     * @param h : numéro de la demi-arête
+     */
+    static int getPrev(int h)
+    {
+        return (h % 3 == 0) ? h + 2 : h - 1;
+    }
+
+    /**
+     * retourne la demi-arête opposée, dans le triangle voisin
+     * @param h : numéro de la demi-arête
+     * @return NONE si h est sur un bord
+     */
+    int getTwin(int h) const
+    {
+        return m_Twins[h];
+    }
+
+    /**
+     * retourne le sommet de départ de la demi-arête
+     * @param h : numéro de la demi-arête
+     */
+    GLuint getOrigin(int h) const
+    {
+        return m_Indices[h];
+    }
+
+    /**
+     * retourne le sommet d'arrivée de la demi-arête
+     * @param h : numéro de la demi-arête
+     */
+    GLuint getTarget(int h) const
+    {
+        return m_Indices[getNext(h)];
+    }
+
+    /**
+     * indique si la demi-arête est sur un bord : aucun triangle de l'autre côté
+     * @param h : numéro de la demi-arête
+     */
+    bool isBoundary(int h) const
+    {
+        return m_Twins[h] == NONE;
+    }
+
+    /**
+     * retourne une demi-arête qui part du sommet. Pour un sommet du bord, c'est celle qui est sur
+     * le bord, ainsi getNextAround parcourt tous ses triangles à partir d'elle.
+     * @param vertex : numéro du sommet
+     * @return NONE si le sommet n'appartient à aucun triangle
+     */
+    int getVertexHalfEdge(GLuint vertex) const
+    {
+        return m_VertexHalfEdges[vertex];
+    }
+
+    /**
+     * indique si le sommet est sur un bord du maillage
+     * @param vertex : numéro du sommet
+     */
+    bool isBoundaryVertex(GLuint vertex) const
+    {
+        int h = m_VertexHalfEdges[vertex];
+        return h != NONE && m_Twins[h] == NONE;
+    }
+
+    /**
+     * retourne la demi-arête suivante autour du sommet de départ de h : elle part du même sommet,
+     * dans le triangle voisin
+     * @param h : numéro de la demi-arête
+     * @return NONE si le tour s'arrête sur un bord
+     */
+    int getNextAround(int h) const
+    {
+        return m_Twins[getPrev(h)];
+    }
+
+    /**
+     * cherche la demi-arête qui va de a à b, en temps proportionnel au nombre de voisins de a
+     * @param a : sommet de départ
+     * @param b : sommet d'arrivée
+     * @return NONE si aucun triangle ne contient a->b
+     */
+    int findHalfEdge(GLuint a, GLuint b) const;
+
+    /**
+     * retourne les sommets voisins du sommet (premier anneau), dans l'ordre de rotation
+     * @param vertex : numéro du sommet
+     * @param neighbours : reçoit les numéros des sommets voisins
+     */
+    void getOneRing(GLuint vertex, std::vector<GLuint>& neighbours) const;
+
+    /**
+     * retourne les triangles qui contiennent le sommet, dans l'ordre de rotation
+     * @param vertex : numéro du sommet
+     * @param triangles : reçoit les numéros des triangles
+     */
+    void getVertexTriangles(GLuint vertex, std::vector<int>& triangles) const;
+
+    /**
+     * retourne chaque arête une seule fois, même si elle est partagée par deux triangles
+     * @param lines : reçoit les numéros des deux sommets de chaque arête
+     */
+    void getUniqueEdges(std::vector<GLuint>& lines) const;
+};
+
+#endif
@@ -11,9 +11,17 @@
 #include <stdlib.h>
 #include <math.h>
 #include <ctype.h>
+#include <stdint.h>
 
 #include <utils.h>
 #include <Material.h>
+#include <ShaderProgram.h>
+#include <FrameUniforms.h>
+#include <GeometryArena.h>
+
+
+// nombre de matériaux créés, pour leur numéro
+static unsigned MaterialCount = 0;
 
 
 /**
@@ -26,6 +34,7 @@ Material::Material(std::string srcVertexShader, std::string srcFragmentShader, s
 {
     // nom du matériau pour la mise au point
     m_Name = name;
+    m_Id = ++MaterialCount;
 
     // compiler le shader
     setShaders(srcVertexShader, srcFragmentShader);
@@ -43,12 +52,72 @@ Material::Material(std::string name)
 {
     // nom du matériau pour la mise au point
     m_Name = name;
+    m_Id = ++MaterialCount;
 
     // matrice normale
     m_MatN = mat3::create();
 }
 
 
+/**
+ * retourne les déclarations GLSL à placer dans le vertex shader, après #version, pour lire les
+ * attributs des maillages quantifiés (voir Mesh::setQuantized) : dequantizePosition(glVertex)
+ * et dequantizeDirection(glNormal) ou (glTangent). Elles ne changent rien aux autres maillages.
+ * @return source GLSL des uniform et des fonctions de déquantification
+ */
+std::string Material::getDequantizationFunctions()
+{
+    return
+        "// déquantification des attributs, voir Mesh::setQuantized\n"
+        "uniform vec3 quantOffset;\n"
+        "uniform vec3 quantScale;\n"
+        "uniform bool quantOctahedral;\n"
+        "\n"
+        "vec3 dequantizePosition(vec3 position)\n"
+        "{\n"
+        "    return quantOffset + position * quantScale;\n"
+        "}\n"
+        "\n"
+        "vec3 dequantizeDirection(vec3 direction)\n"
+        "{\n"
+        "    if (! quantOctahedral) return direction;\n"
+        "    // déplier l'octaèdre : la moitié z < 0 était repliée sur les coins du carré\n"
+        "    vec3 n = vec3(direction.xy, 1.0 - abs(direction.x) - abs(direction.y));\n"
+        "    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+        "    return normalize(n);\n"
+        "}\n"
+        "\n";
+}
+
+
+/**
+ * retourne les déclarations GLSL à placer dans le vertex shader, après #version, pour dessiner
+ * plusieurs exemplaires d'un maillage en un seul appel (voir Mesh::onDrawInstanced) :
+ * instanceMatVM(matVM) et instanceMatN(matN, matVM). Sans exemplaires, elles rendent matVM et matN.
+ * NB: la matrice normale d'un exemplaire est mat3(matVM), les matrices des exemplaires ne doivent
+ * contenir que des rotations et des translations
+ * @return source GLSL de l'attribut, de l'uniform et des fonctions
+ */
+std::string Material::getInstancingFunctions()
+{
+    return
+        "// exemplaires multiples, voir Mesh::onDrawInstanced\n"
+        "uniform bool instanced;\n"
+        "in mat4 glInstanceMatrix;\n"
+        "\n"
+        "mat4 instanceMatVM(mat4 matVM)\n"
+        "{\n"
+        "    return instanced ? matVM * glInstanceMatrix : matVM;\n"
+        "}\n"
+        "\n"
+        "mat3 instanceMatN(mat3 matN, mat4 matVM)\n"
+        "{\n"
+        "    return instanced ? mat3(matVM) : matN;\n"
+        "}\n"
+        "\n";
+}
+
+
 void Material::setShaders(std::string srcVertexShader, std::string srcFragmentShader)
 {
     // test des paramètres
@@ -56,8 +125,9 @@ void Material::setShaders(std::string srcVertexShader, std::string srcFragmentSh
         throw "Missing shader source for material subclass "+m_Name;
     }
 
-    // compiler le shader
-    m_ShaderId = Utils::makeShaderProgram(srcVertexShader, srcFragmentShader, m_Name);
+    // compiler le shader, ou reprendre celui d'un matériau qui a les mêmes sources
+    m_Shader = ShaderProgram::get(srcVertexShader, srcFragmentShader, m_Name);
+    m_ShaderId = m_Shader->getId();
 
     // déterminer où sont les variables uniform (paramètres du matériau)
     m_MatPLoc   = glGetUniformLocation(m_ShaderId, "matP");
@@ -65,6 +135,21 @@ void Material::setShaders(std::string srcVertexShader, std::string srcFragmentSh
     m_MatNLoc   = glGetUniformLocation(m_ShaderId, "matN");
     m_TimeLoc   = glGetUniformLocation(m_ShaderId, "time");
 
+    // bloc des variables de l'image, absent si le shader n'emploie pas FrameUniforms::getDeclarations
+    GLuint frameblock = glGetUniformBlockIndex(m_ShaderId, "FrameData");
+    if (frameblock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(m_ShaderId, frameblock, FrameUniforms::BINDING);
+    }
+
+    // variables de déquantification, absentes si le shader n'emploie pas getDequantizationFunctions
+    m_QuantOffsetLoc     = glGetUniformLocation(m_ShaderId, "quantOffset");
+    m_QuantScaleLoc      = glGetUniformLocation(m_ShaderId, "quantScale");
+    m_QuantOctahedralLoc = glGetUniformLocation(m_ShaderId, "quantOctahedral");
+
+    // exemplaires multiples, absents si le shader n'emploie pas getInstancingFunctions
+    m_InstancedLoc      = glGetUniformLocation(m_ShaderId, "instanced");
+    m_InstanceMatrixLoc = glGetAttribLocation(m_ShaderId, "glInstanceMatrix");
+
     // déterminer où sont les variables attribute (associées aux VBO)
     m_VertexLoc    = glGetAttribLocation(m_ShaderId, "glVertex");
     m_ColorLoc     = glGetAttribLocation(m_ShaderId, "glColor");
@@ -72,15 +157,68 @@ void Material::setShaders(std::string srcVertexShader, std::string srcFragmentSh
     m_TangentLoc   = glGetAttribLocation(m_ShaderId, "glTangent");
     m_TexCoordsLoc = glGetAttribLocation(m_ShaderId, "glTexCoords");
 
+    // attributs à fournir dans le VBO entrelacé des maillages
+    m_AttributeMask = VertexFormat::COORDS_BIT;
+    if (m_ColorLoc     >= 0) m_AttributeMask |= VertexFormat::COLOR_BIT;
+    if (m_NormalLoc    >= 0) m_AttributeMask |= VertexFormat::NORMAL_BIT;
+    if (m_TangentLoc   >= 0) m_AttributeMask |= VertexFormat::TANGENT_BIT;
+    if (m_TexCoordsLoc >= 0) m_AttributeMask |= VertexFormat::TEXCOORDS_BIT;
+
+    // disposition des attributs, un octet par emplacement : les matériaux qui ont la même partagent les VAOs des maillages
+    m_VertexLayout = 0;
+    for (GLint location: { m_VertexLoc, m_ColorLoc, m_NormalLoc, m_TangentLoc, m_TexCoordsLoc, m_InstanceMatrixLoc }) {
+        m_VertexLayout = (m_VertexLayout << 8) | (uint64_t) ((location + 1) & 0xFF);
+    }
+
     // tests de validité minimaux
     if (m_VertexLoc < 0) {
         throw std::runtime_error("Vertex shader of "+m_Name+" uses another name for coordinates instead of attribute vec3 glVertex;");
     }
-    if (m_MatPLoc  < 0) std::cerr << "no uniform mat4 matP; in "<<m_Name<<" vertex shader ?"<<std::endl;
+    if (m_MatPLoc  < 0 && frameblock == GL_INVALID_INDEX) std::cerr << "no uniform mat4 matP; in "<<m_Name<<" vertex shader ?"<<std::endl;
     if (m_MatVMLoc < 0) std::cerr << "no uniform mat4 matVM; in "<<m_Name<<" vertex shader ?"<<std::endl;
 }
 
 
+/**
+ * active l'attribut indiqué dans le VBO entrelacé actuellement lié
+ * @param location : emplacement de l'attribut dans le shader, rien n'est fait s'il est négatif
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @param format : attributs présents dans le VBO
+ * @param quantized : true si les attributs du VBO sont quantifiés
+ */
+static void enableInterleavedAttribute(GLint location, int attribute, unsigned format, bool quantized)
+{
+    if (location < 0) return;
+    glEnableVertexAttribArray(location);
+    if (quantized) {
+        // entiers normalisés et demi-flottants, voir VertexFormat::quantizedSize
+        const GLboolean normalized = (attribute == VertexFormat::TEXCOORDS) ? GL_FALSE : GL_TRUE;
+        glVertexAttribPointer(location, VertexFormat::quantizedComponents(attribute), VertexFormat::quantizedType(attribute), normalized,
+            VertexFormat::quantizedStride(format),
+            (const GLvoid*) (intptr_t) VertexFormat::quantizedOffset(format, attribute));
+        return;
+    }
+    glVertexAttribPointer(location, VertexFormat::components(attribute), GL_FLOAT, GL_FALSE,
+        VertexFormat::stride(format) * sizeof(GLfloat),
+        (const GLvoid*) (VertexFormat::offset(format, attribute) * sizeof(GLfloat)));
+}
+
+
+/**
+ * active l'attribut indiqué dans son propre VBO
+ * @param location : emplacement de l'attribut dans le shader, rien n'est fait s'il est négatif
+ * @param bufferid : VBO de l'attribut, rien n'est fait s'il est négatif
+ * @param components : nombre de GLfloat par sommet
+ */
+static void enableAttribute(GLint location, GLint bufferid, int components)
+{
+    if (location < 0 || bufferid < 0) return;
+    glBindBuffer(GL_ARRAY_BUFFER, bufferid);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, components, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+
 /**
  * active le matériau : son shader et lie les variables uniform communes
  * @param mesh : maillage pour lequel on active ce matériau
@@ -89,15 +227,42 @@ void Material::setShaders(std::string srcVertexShader, std::string srcFragmentSh
  */
 void Material::select(Mesh* mesh, const mat4& matP, const mat4& matVM)
 {
-    // activer le shader
+    bindProgram();
+
+    // les VBOs sont mis à jour avant les variables uniform, ex: la boîte de quantification
+    bindVertexArray(mesh);
+    setUniforms(mesh, matP, matVM);
+    bindTextures();
+}
+
+
+/**
+ * active le shader du matériau
+ */
+void Material::bindProgram()
+{
     glUseProgram(m_ShaderId);
+}
 
-    // fournir les matrices P et VM au shader
-    mat4::glUniformMatrix(m_MatPLoc, matP);
+
+/**
+ * fournit au shader, qui doit être actif, les variables uniform d'un dessin : matrices, temps
+ * et boîte de quantification du maillage
+ * @param mesh : maillage dessiné, nullptr pour les sommets non quantifiés d'une GeometryArena
+ * @param matP : matrice de projection perpective
+ * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+ */
+void Material::setUniforms(Mesh* mesh, const mat4& matP, const mat4& matVM)
+{
+    // fournir les matrices P et VM au shader, P et le temps sont dans FrameData s'il emploie ce bloc
+    if (m_MatPLoc >= 0) mat4::glUniformMatrix(m_MatPLoc, matP);
     mat4::glUniformMatrix(m_MatVMLoc, matVM);
 
     // fournir le temps (il n'est pas forcément utilisé par le shader)
-    glUniform1f(m_TimeLoc, Utils::Time);
+    if (m_TimeLoc >= 0) glUniform1f(m_TimeLoc, Utils::Time);
+
+    // un seul exemplaire, sauf appel à selectInstances
+    glUniform1i(m_InstancedLoc, 0);
 
     // calcul de la matrice normale si elle est utilisée
     if (m_MatNLoc >= 0) {
@@ -107,51 +272,132 @@ void Material::select(Mesh* mesh, const mat4& matP, const mat4& matVM)
         mat3::glUniformMatrix(m_MatNLoc, m_MatN);
     }
 
-    // activer et lier le buffer contenant les coordonnées, attention ce sont des vec3 obligatoirement
-    GLint vertexBufferId = mesh->getVertexBufferId();
-    if (vertexBufferId <= 0) return;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferId);
-    glEnableVertexAttribArray(m_VertexLoc);
-    glVertexAttribPointer(m_VertexLoc, Utils::VEC3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // activer et lier le buffer contenant les couleurs s'il est utilisé dans le shader
-    if (m_ColorLoc >= 0) {
-        GLint colorBufferId = mesh->getColorBufferId();
-        if (colorBufferId >= 0) {
-            glBindBuffer(GL_ARRAY_BUFFER, colorBufferId);
-            glEnableVertexAttribArray(m_ColorLoc);
-            glVertexAttribPointer(m_ColorLoc, Utils::VEC3, GL_FLOAT, GL_FALSE, 0, 0);
-        }
+    // boîte des coordonnées quantifiées et codage des normales, les VBOs séparés ne sont jamais quantifiés
+    if (mesh != nullptr && mesh->isQuantized()) {
+        vec3::glUniform(m_QuantOffsetLoc, mesh->getQuantizationOffset());
+        vec3::glUniform(m_QuantScaleLoc,  mesh->getQuantizationScale());
+        glUniform1i(m_QuantOctahedralLoc, 1);
+    } else {
+        glUniform3f(m_QuantOffsetLoc, 0.0, 0.0, 0.0);
+        glUniform3f(m_QuantScaleLoc,  1.0, 1.0, 1.0);
+        glUniform1i(m_QuantOctahedralLoc, 0);
     }
+}
+
 
-    // activer et lier le buffer contenant les normales s'il est utilisé dans le shader
-    if (m_NormalLoc >= 0) {
-        GLint normalBufferId = mesh->getNormalBufferId();
-        if (normalBufferId >= 0) {
-            glBindBuffer(GL_ARRAY_BUFFER, normalBufferId);
-            glEnableVertexAttribArray(m_NormalLoc);
-            glVertexAttribPointer(m_NormalLoc, Utils::VEC3, GL_FLOAT, GL_FALSE, 0, 0);
-        }
+/**
+ * met à jour les VBOs du maillage employés par le shader et lie le VAO qui les décrit
+ * @param mesh : maillage dessiné
+ * @return false si le maillage n'a pas de sommets à dessiner
+ */
+bool Material::bindVertexArray(Mesh* mesh)
+{
+    // VBO entrelacé : un seul buffer, chaque attribut a son décalage dans le sommet
+    if (mesh->isInterleaved()) {
+        GLint interleavedBufferId = mesh->getInterleavedBufferId(m_AttributeMask);
+        if (interleavedBufferId <= 0) return false;
+
+        // les attributs ne sont décrits que lors de la création du VAO
+        if (mesh->bindVertexArray(m_VertexLayout)) return true;
+        glBindBuffer(GL_ARRAY_BUFFER, interleavedBufferId);
+        unsigned format = mesh->getInterleavedFormat();
+        bool quantized = mesh->isQuantized();
+        enableInterleavedAttribute(m_VertexLoc,    VertexFormat::COORDS,    format, quantized);
+        enableInterleavedAttribute(m_ColorLoc,     VertexFormat::COLOR,     format, quantized);
+        enableInterleavedAttribute(m_NormalLoc,    VertexFormat::NORMAL,    format, quantized);
+        enableInterleavedAttribute(m_TangentLoc,   VertexFormat::TANGENT,   format, quantized);
+        enableInterleavedAttribute(m_TexCoordsLoc, VertexFormat::TEXCOORDS, format, quantized);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
     }
 
-    // activer et lier le buffer contenant les tangentes s'il est utilisé dans le shader
-    if (m_TangentLoc >= 0) {
-        GLint tangentBufferId = mesh->getTangentBufferId();
-        if (tangentBufferId >= 0) {
-            glBindBuffer(GL_ARRAY_BUFFER, tangentBufferId);
-            glEnableVertexAttribArray(m_TangentLoc);
-            glVertexAttribPointer(m_TangentLoc, Utils::VEC3, GL_FLOAT, GL_FALSE, 0, 0);
-        }
+    // mettre à jour les buffers utilisés dans le shader, attention les coordonnées sont des vec3 obligatoirement
+    GLint vertexBufferId = mesh->getVertexBufferId();
+    if (vertexBufferId <= 0) return false;
+    GLint colorBufferId     = (m_ColorLoc     >= 0) ? mesh->getColorBufferId()     : -1;
+    GLint normalBufferId    = (m_NormalLoc    >= 0) ? mesh->getNormalBufferId()    : -1;
+    GLint tangentBufferId   = (m_TangentLoc   >= 0) ? mesh->getTangentBufferId()   : -1;
+    GLint texcoordsBufferId = (m_TexCoordsLoc >= 0) ? mesh->getTexCoordsBufferId() : -1;
+
+    // les attributs ne sont décrits que lors de la création du VAO
+    if (mesh->bindVertexArray(m_VertexLayout)) return true;
+    enableAttribute(m_VertexLoc,    vertexBufferId,    Utils::VEC3);
+    enableAttribute(m_ColorLoc,     colorBufferId,     Utils::VEC3);
+    enableAttribute(m_NormalLoc,    normalBufferId,    Utils::VEC3);
+    enableAttribute(m_TangentLoc,   tangentBufferId,   Utils::VEC3);
+    enableAttribute(m_TexCoordsLoc, texcoordsBufferId, Utils::VEC2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+
+/**
+ * lie le VAO qui décrit les sommets d'une arène pour ce matériau
+ * @param arena : arène dessinée, ses VBOs doivent être à jour
+ * @return false si l'arène n'a pas tous les attributs du shader
+ */
+bool Material::bindVertexArray(GeometryArena* arena)
+{
+    const unsigned format = arena->getFormat();
+    if ((m_AttributeMask & ~format) != 0 || arena->getVertexBufferId() <= 0) return false;
+
+    // les attributs ne sont décrits que lors de la création du VAO
+    if (arena->bindVertexArray(m_VertexLayout)) return true;
+    glBindBuffer(GL_ARRAY_BUFFER, arena->getVertexBufferId());
+    enableInterleavedAttribute(m_VertexLoc,    VertexFormat::COORDS,    format, false);
+    enableInterleavedAttribute(m_ColorLoc,     VertexFormat::COLOR,     format, false);
+    enableInterleavedAttribute(m_NormalLoc,    VertexFormat::NORMAL,    format, false);
+    enableInterleavedAttribute(m_TangentLoc,   VertexFormat::TANGENT,   format, false);
+    enableInterleavedAttribute(m_TexCoordsLoc, VertexFormat::TEXCOORDS, format, false);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+
+/**
+ * lie les textures du matériau à leurs unités, le shader doit être actif.
+ * Le matériau de base n'en a pas.
+ */
+void Material::bindTextures()
+{
+}
+
+
+/**
+ * lie les matrices des exemplaires au shader, à appeler entre select et deselect,
+ * avant chaque glDrawElementsInstanced
+ * @param bufferid : VBO contenant les matrices de modèle, 16 GLfloat par exemplaire
+ * @param first : numéro du premier exemplaire à dessiner dans ce VBO
+ * @return false si le shader n'emploie pas getInstancingFunctions
+ */
+bool Material::selectInstances(GLint bufferid, size_t first)
+{
+    if (! isInstanced()) return false;
+    glUniform1i(m_InstancedLoc, 1);
+
+    // une mat4 occupe quatre emplacements consécutifs, un par colonne, qui avancent d'un cran par exemplaire
+    const GLsizei stride = 16 * sizeof(GLfloat);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferid);
+    for (int column=0; column<4; column++) {
+        GLuint location = m_InstanceMatrixLoc + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*) (first * stride + column * 4 * sizeof(GLfloat)));
+        glVertexAttribDivisor(location, 1);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
 
-    // activer et lier le buffer contenant les coordonnées de textures s'il est utilisé dans le shader
-    if (m_TexCoordsLoc >= 0) {
-        GLint texcoordsBufferId = mesh->getTexCoordsBufferId();
-        if (texcoordsBufferId >= 0) {
-            glBindBuffer(GL_ARRAY_BUFFER, texcoordsBufferId);
-            glEnableVertexAttribArray(m_TexCoordsLoc);
-            glVertexAttribPointer(m_TexCoordsLoc, Utils::VEC2, GL_FLOAT, GL_FALSE, 0, 0);
-        }
+/**
+ * désactive les matrices des exemplaires liées par selectInstances
+ */
+void Material::deselectInstances()
+{
+    if (m_InstanceMatrixLoc < 0) return;
+    for (int column=0; column<4; column++) {
+        glVertexAttribDivisor(m_InstanceMatrixLoc + column, 0);
+        glDisableVertexAttribArray(m_InstanceMatrixLoc + column);
     }
 }
 
@@ -161,21 +407,11 @@ void Material::select(Mesh* mesh, const mat4& matP, const mat4& matVM)
  */
 void Material::deselect()
 {
-    // désactiver les buffers s'ils sont utilisés
-    glDisableVertexAttribArray(m_VertexLoc);
-    if (m_ColorLoc >= 0) {
-        glDisableVertexAttribArray(m_ColorLoc);
-    }
-    if (m_NormalLoc >= 0) {
-        glDisableVertexAttribArray(m_NormalLoc);
-    }
-    if (m_TangentLoc >= 0) {
-        glDisableVertexAttribArray(m_TangentLoc);
-    }
-    if (m_TexCoordsLoc >= 0) {
-        glDisableVertexAttribArray(m_TexCoordsLoc);
-    }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // désactiver les matrices des exemplaires
+    deselectInstances();
+
+    // les attributs restent décrits dans le VAO du maillage, il suffit de le délier
+    glBindVertexArray(0);
 
     // désactiver le shader
     glUseProgram(0);
@@ -187,7 +423,6 @@ void Material::deselect()
  */
 Material::~Material()
 {
-    // supprimer le shader
-    Utils::deleteShaderProgram(m_ShaderId);
+    // le shader est supprimé par le dernier matériau qui l'emploie
 }
 
@@ -8,6 +8,10 @@
 #include <utils.h>
 
 #include <Mesh.h>
+#include <ShaderProgram.h>
+
+
+class GeometryArena;
 
 
 class Material
@@ -28,6 +32,24 @@ protected:
      */
     Material(std::string name="undefined");
 
+    /**
+     * retourne les déclarations GLSL à placer dans le vertex shader, après #version, pour lire les
+     * attributs des maillages quantifiés (voir Mesh::setQuantized) : dequantizePosition(glVertex)
+     * et dequantizeDirection(glNormal) ou (glTangent). Elles ne changent rien aux autres maillages.
+     * @return source GLSL des uniform et des fonctions de déquantification
+     */
+    static std::string getDequantizationFunctions();
+
+    /**
+     * retourne les déclarations GLSL à placer dans le vertex shader, après #version, pour dessiner
+     * plusieurs exemplaires d'un maillage en un seul appel (voir Mesh::onDrawInstanced) :
+     * instanceMatVM(matVM) et instanceMatN(matN, matVM). Sans exemplaires, elles rendent matVM et matN.
+     * NB: la matrice normale d'un exemplaire est mat3(matVM), les matrices des exemplaires ne doivent
+     * contenir que des rotations et des translations
+     * @return source GLSL de l'attribut, de l'uniform et des fonctions
+     */
+    static std::string getInstancingFunctions();
+
 
 public:
 
@@ -50,18 +72,124 @@ public:
      */
     virtual void select(Mesh* mesh, const mat4& matP, const mat4& matVM);
 
+    /**
+     * active le shader du matériau
+     */
+    void bindProgram();
+
+    /**
+     * fournit au shader, qui doit être actif, les variables uniform d'un dessin : matrices, temps
+     * et boîte de quantification du maillage
+     * @param mesh : maillage dessiné, nullptr pour les sommets non quantifiés d'une GeometryArena
+     * @param matP : matrice de projection perpective
+     * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+     */
+    void setUniforms(Mesh* mesh, const mat4& matP, const mat4& matVM);
+
+    /**
+     * met à jour les VBOs du maillage employés par le shader et lie le VAO qui les décrit
+     * @param mesh : maillage dessiné
+     * @return false si le maillage n'a pas de sommets à dessiner
+     */
+    bool bindVertexArray(Mesh* mesh);
+
+    /**
+     * lie le VAO qui décrit les sommets d'une arène pour ce matériau
+     * @param arena : arène dessinée, ses VBOs doivent être à jour
+     * @return false si l'arène n'a pas tous les attributs du shader
+     */
+    bool bindVertexArray(GeometryArena* arena);
+
+    /**
+     * lie les textures du matériau à leurs unités, le shader doit être actif.
+     * Le matériau de base n'en a pas.
+     */
+    virtual void bindTextures();
+
     /**
      * Cette méthode désactive le matériau
      */
     virtual void deselect();
 
+    /**
+     * lie les matrices des exemplaires au shader, à appeler entre select et deselect,
+     * avant chaque glDrawElementsInstanced
+     * @param bufferid : VBO contenant les matrices de modèle, 16 GLfloat par exemplaire
+     * @param first : numéro du premier exemplaire à dessiner dans ce VBO
+     * @return false si le shader n'emploie pas getInstancingFunctions
+     */
+    bool selectInstances(GLint bufferid, size_t first);
+
+    /**
+     * désactive les matrices des exemplaires liées par selectInstances
+     */
+    void deselectInstances();
+
+    /**
+     * indique si le shader sait dessiner plusieurs exemplaires, voir getInstancingFunctions
+     * @return true si selectInstances est utilisable
+     */
+    bool isInstanced()
+    {
+        return m_InstanceMatrixLoc >= 0 && m_InstancedLoc >= 0;
+    }
+
+    /**
+     * retourne le numéro du matériau, unique et petit, pour trier les dessins (voir RenderQueue)
+     * @return numéro à partir de 1
+     */
+    unsigned getId()
+    {
+        return m_Id;
+    }
+
+    /**
+     * retourne l'identifiant OpenGL du shader du matériau
+     * @return identifiant du programme
+     */
+    GLint getShaderId()
+    {
+        return m_ShaderId;
+    }
+
+    /**
+     * retourne l'identifiant OpenGL de la texture principale du matériau, pour trier les dessins
+     * @return identifiant de la texture, 0 s'il n'y en a pas
+     */
+    virtual GLuint getTextureId()
+    {
+        return 0;
+    }
+
+    /**
+     * retourne les attributs des sommets employés par le shader
+     * @return masque de VertexFormat
+     */
+    unsigned getAttributeMask()
+    {
+        return m_AttributeMask;
+    }
+
+    /**
+     * retourne la disposition des attributs du shader : les emplacements de tous ses attributs
+     * @return clé des VAOs des maillages, voir Mesh::bindVertexArray
+     */
+    uint64_t getVertexLayout()
+    {
+        return m_VertexLayout;
+    }
+
 
 protected:
 
     /** nom du matériau **/
     std::string m_Name;
 
+    /** numéro du matériau, voir getId */
+    unsigned m_Id;
+
     /** identifiants liés au shader */
+    std::shared_ptr<ShaderProgram> m_Shader;
     GLint m_ShaderId;
     GLint m_MatPLoc;
     GLint m_MatVMLoc;
@@ -72,6 +200,17 @@ protected:
     GLint m_NormalLoc;
     GLint m_TangentLoc;
     GLint m_TexCoordsLoc;
+    GLint m_QuantOffsetLoc;
+    GLint m_QuantScaleLoc;
+    GLint m_QuantOctahedralLoc;
+    GLint m_InstanceMatrixLoc;
+    GLint m_InstancedLoc;
+
+    /** attributs employés par le shader, masque de VertexFormat */
+    unsigned m_AttributeMask;
+
+    /** emplacements des attributs, voir Mesh::bindVertexArray */
+    uint64_t m_VertexLayout;
 
     /** matrice normale */
     mat3 m_MatN;
@@ -9,538 +9,1923 @@
 #include <iterator>
 #include <vector>
 #include <stdexcept>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <utils.h>
 #include <Mesh.h>
-
-// IMPORTANT: cette représentation des mesh inefficace ne peut pas convenir à un projet important
-// Consulter le livre Synthèse d'images avec OpenGL ES de Pierre Nerzic pour une meilleure modélisation (half-edge)
+#include <MeshOptimizer.h>
+#include <RenderQueue.h>
+#include <MeshSimplifier.h>
+#include <HalfEdgeMesh.h>
+#include <GeometryArena.h>
+#include <StreamBuffer.h>
 
 using namespace mesh;
 
+// les tableaux d'attributs sont envoyés tels quels dans les VBOs et les fichiers binaires
+static_assert(sizeof(vec3) == 3*sizeof(GLfloat), "vec3 must be 3 packed GLfloats");
+static_assert(sizeof(vec2) == 2*sizeof(GLfloat), "vec2 must be 2 packed GLfloats");
+
+
+/**
+ * constructeur. On lui fournit au moins un matériau (sous-classe de Material), pour les triangles et/ou les arêtes.
+ * @param name : nom du maillage (pour la mise au point)
+ * @param facesmaterial : sous-classe de Material pour dessiner les facettes
+ * @param edgesmaterial : sous-classe de Material pour dessiner les arêtes
+ */
+Mesh::Mesh(std::string name, Material* facesmaterial, Material* edgesmaterial)
+{
+    m_Name = name;
+
+    // VBO entrelacé par défaut
+    m_Interleaved         = true;
+    m_InterleavedBufferId = -1;
+    m_InterleavedFormat   = 0;
+    m_InterleavedCapacity = 0;
+
+    // attributs en GLfloat par défaut
+    m_Quantized          = false;
+    m_QuantizationOffset = vec3::create();
+    m_QuantizationScale  = vec3::create();
+
+    // identifiants des VBOs séparés
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        m_AttributeBufferId[attribute] = -1;
+        m_AttributeCapacity[attribute] = 0;
+    }
+    m_FacesIndexBufferId   = -1;
+    m_EdgesIndexBufferId   = -1;
+    m_FacesCapacity        = 0;
+    m_EdgesCapacity        = 0;
+    m_EdgesCount           = 0;
+    m_EdgesChanged         = true;
+    m_FacesIndexBufferType = 0;
+    m_EdgesIndexBufferType = 0;
+
+    // volumes englobants calculés à la première demande
+    m_BoundsMin     = vec3::create();
+    m_BoundsMax     = vec3::create();
+    m_SphereCenter  = vec3::create();
+    m_SphereRadius  = 0.0f;
+    m_BoundsChanged = true;
+
+    // pas de niveaux de détail tant que generateLods n'est pas appelée
+    m_LodIndexBufferId   = -1;
+    m_LodIndexBufferType = 0;
+    m_LodsChanged        = false;
+
+    // VBO des matrices des exemplaires, créé par le premier onDrawInstanced
+    m_InstanceBufferId = -1;
+
+    // copié dans une arène par son premier GeometryArena::addDraws
+    m_Arena = nullptr;
+
+    // matériaux, l'un peut être null
+    m_FacesMaterial = facesmaterial;
+    m_EdgesMaterial = edgesmaterial;
+}
+
+
+/**
+ * affecte les matériaux après création de l'instance
+ * @param facesmaterial : sous-classe de Material pour dessiner les facettes
+ * @param edgesmaterial : sous-classe de Material pour dessiner les arêtes
+ */
+void Mesh::setMaterials(Material* facesmaterial, Material* edgesmaterial)
+{
+    // matériaux, l'un peut être null
+    m_FacesMaterial = facesmaterial;
+    m_EdgesMaterial = edgesmaterial;
+}
+
+
+/**
+ * recalcule la boîte et la sphère englobantes si les coordonnées ont changé depuis le dernier calcul
+ */
+void Mesh::updateBounds()
+{
+    // le compactage peut déplacer des coordonnées
+    compact();
+    if (! m_BoundsChanged) return;
+    m_BoundsChanged = false;
+
+    // boîte englobante
+    if (m_Coords.empty()) {
+        vec3::zero(m_BoundsMin);
+        vec3::zero(m_BoundsMax);
+    } else {
+        vec3::copy(m_BoundsMin, m_Coords[0]);
+        vec3::copy(m_BoundsMax, m_Coords[0]);
+        for (const vec3& coords: m_Coords) {
+            vec3::min(m_BoundsMin, m_BoundsMin, coords);
+            vec3::max(m_BoundsMax, m_BoundsMax, coords);
+        }
+    }
+
+    // sphère centrée sur la boîte, passant par le sommet le plus éloigné
+    vec3::add(m_SphereCenter, m_BoundsMin, m_BoundsMax);
+    vec3::scale(m_SphereCenter, m_SphereCenter, 0.5);
+    float radius2 = 0.0f;
+    for (const vec3& coords: m_Coords) {
+        radius2 = std::max(radius2, vec3::squaredDistance(coords, m_SphereCenter));
+    }
+    m_SphereRadius = sqrtf(radius2);
+}
+
+
+/**
+ * retourne le coin minimal de la boîte englobante alignée sur les axes, (0,0,0) si le maillage est vide
+ * @return coordonnées minimales des sommets sur chaque axe
+ */
+const vec3& Mesh::getBoundsMin()
+{
+    updateBounds();
+    return m_BoundsMin;
+}
+
+
+/**
+ * retourne le coin maximal de la boîte englobante alignée sur les axes, (0,0,0) si le maillage est vide
+ * @return coordonnées maximales des sommets sur chaque axe
+ */
+const vec3& Mesh::getBoundsMax()
+{
+    updateBounds();
+    return m_BoundsMax;
+}
+
+
+/**
+ * retourne le centre de la sphère englobante : c'est le centre de la boîte englobante
+ * @return centre de la sphère
+ */
+const vec3& Mesh::getBoundingSphereCenter()
+{
+    updateBounds();
+    return m_SphereCenter;
+}
+
+
+/**
+ * retourne le rayon de la sphère englobante : distance du sommet le plus éloigné de son centre
+ * @return rayon de la sphère
+ */
+float Mesh::getBoundingSphereRadius()
+{
+    updateBounds();
+    return m_SphereRadius;
+}
+
+
+/**
+ * retourne le sommet n°i (0..) du maillage
+ * @param i : numéro 0..NV-1 du sommet
+ * @return le Vertex() demandé, invalide si i n'est pas dans les bornes (voir Vertex::isValid)
+ */
+Vertex Mesh::getVertex(int i)
+{
+    if (i < 0 || i >= getVertexCount()) return Vertex();
+    return makeVertex(i);
+}
+
+
+/**
+ * retourne le triangle n°i (0..) du maillage
+ * @param i : numéro 0..NT-1 du triangle
+ * @return le Triangle() demandé, invalide si i n'est pas dans les bornes (voir Triangle::isValid)
+ */
+Triangle Mesh::getTriangle(int i)
+{
+    if (i < 0 || i >= getTriangleCount()) return Triangle();
+    return makeTriangle(i);
+}
+
+
+/**
+ * retourne une poignée sur le sommet ou le triangle situé à la position indiquée, sans compactage
+ * @param position : numéro actuel du sommet ou du triangle
+ */
+Vertex Mesh::makeVertex(long position)
+{
+    if (! slotsInSync()) syncSlots();
+    const long slot = m_VertexSlots.slots[position];
+    if (slot < 0) return Vertex();
+    return Vertex(this, slot, m_VertexSlots.generations[slot]);
+}
+Triangle Mesh::makeTriangle(long position)
+{
+    if (! slotsInSync()) syncSlots();
+    const long slot = m_TriangleSlots.slots[position];
+    if (slot < 0) return Triangle();
+    return Triangle(this, slot, m_TriangleSlots.generations[slot]);
+}
+
+
+/**
+ * affiche le nombre de sommets et de triangles sur stdout
+ */
+void Mesh::info()
+{
+    std::cout<<m_Name<<" : "<<getVertexCount()<<" vertices,"<<getTriangleCount()<<" triangles"<<std::endl;
+}
+
+
+/**
+ * Cette méthode ajoute un sommet à la fin des tableaux. Il est magenta, sans normale
+ * ni coordonnées de texture, employer les setters de Vertex pour les définir.
+ * @param xyz : coordonnées du sommet
+ * @return le nouveau sommet
+ */
+Vertex Mesh::addVertex(vec3 xyz)
+{
+    // les places des sommets supprimés ne sont pas reprises : des triangles y font encore référence
+    if (! slotsInSync()) syncSlots();
+    m_Coords.push_back(xyz);
+    m_Colors.push_back(vec3::fromValues(1, 0, 1));
+    m_TexCoords.push_back(vec2::create());
+    m_Normals.push_back(vec3::create());
+    m_Tangents.push_back(vec3::create());
+
+    // ce sommet sera envoyé au prochain dessin
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        markDirty(attribute, m_Coords.size()-1);
+    }
+
+    return makeVertex(m_Coords.size()-1);
+}
+Vertex Mesh::addVertex(float x, float y, float z)
+{
+    return addVertex(vec3::fromValues(x,y,z));
+}
+Vertex Mesh::addVertex(double x, double y, double z)
+{
+    return addVertex(vec3::fromValues(x,y,z));
+}
+
+
+/**
+ * Cette méthode crée et rajoute un triangle au maillage.
+ * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
+ * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
+ * @param v1 : le premier coin du triangle
+ * @param v2 : le deuxième coin du triangle
+ * @param v3 : le troisième coin du triangle
+ * @return le nouveau triangle, ajouté au maillage
+ */
+Triangle Mesh::addTriangle(const Vertex& v1, const Vertex& v2, const Vertex& v3)
+{
+    if (v1.getMesh() != this || v2.getMesh() != this || v3.getMesh() != this) return Triangle();
+    if (! v1.isValid() || ! v2.isValid() || ! v3.isValid()) return Triangle();
+    if (! slotsInSync()) syncSlots();
+
+    // reprendre la place d'un triangle supprimé, sinon ajouter à la fin
+    long position;
+    if (m_TriangleHoles.empty()) {
+        position = m_Indices.size() / 3;
+        m_Indices.resize(m_Indices.size() + 3);
+    } else {
+        position = m_TriangleHoles.back();
+        m_TriangleHoles.pop_back();
+        m_TriangleSlots.holes--;
+    }
+    m_Indices[position*3 + 0] = v1.getIndex();
+    m_Indices[position*3 + 1] = v2.getIndex();
+    m_Indices[position*3 + 2] = v3.getIndex();
+    m_TriangleSlots.allocate(position);
+
+    // ce triangle sera envoyé au prochain dessin
+    markTrianglesDirty(position);
+
+    return makeTriangle(position);
+}
+
+
+/**
+ * Cette méthode crée et rajoute un quadrilatère au maillage. En fait, cela
+ * revient à créer deux triangles, (v1, v2, s4) et (s4, v2, v3).
+ * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
+ * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
+ * NB : les triangles sont définis dans l'ordre qui facilite la création de rubans
+ * @param v1 : l'un des coins du quad
+ * @param v2 : l'un des coins du quad
+ * @param v3 : l'un des coins du quad
+ * @param s4 : l'un des coins du quad
+ */
+void Mesh::addQuad(const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex& s4)
+{
+    addTriangle(v1, v2, s4);
+    addTriangle(s4, v2, v3);
+}
+
+
+/**
+ * Cette méthode supprime le triangle du maillage, en temps constant : ses poignées deviennent
+ * invalides et sa place est réutilisée par le prochain addTriangle ou retirée par compact.
+ * @param triangle : celui qu'il faut supprimer
+ */
+void Mesh::delTriangle(const Triangle& triangle)
+{
+    if (triangle.getMesh() != this || triangle.getIndex() < 0) return;
+    if (! slotsInSync()) syncSlots();
+
+    // sa place reste dans le tableau jusqu'au compactage ou au prochain ajout
+    m_TriangleHoles.push_back(triangle.getIndex());
+    m_TriangleSlots.release(triangle.getSlot());
+
+    // les niveaux de détail contiennent peut-être ce triangle
+    clearLods();
+}
+
+
+/**
+ * Cette méthode supprime le sommet du maillage, en temps constant : ses poignées deviennent
+ * invalides, ainsi que celles des triangles qui le contiennent. Ceux-ci sont retirés avec
+ * le sommet par compact.
+ * @param vertex : celui qu'il faut supprimer
+ */
+void Mesh::delVertex(const Vertex& vertex)
+{
+    if (! vertex.isValid() || vertex.getMesh() != this) return;
+    if (! slotsInSync()) syncSlots();
+
+    // le sommet et ses triangles restent dans les tableaux jusqu'au compactage
+    m_VertexSlots.release(vertex.getSlot());
+
+    // les niveaux de détail contiennent peut-être ses triangles
+    clearLods();
+}
+
+
+/**
+ * attribue des emplacements aux éléments ajoutés directement dans les tableaux et
+ * libère ceux des éléments qui en ont été retirés directement
+ */
+void Mesh::syncSlots()
+{
+    SlotTable* tables[2] = { &m_VertexSlots, &m_TriangleSlots };
+    const size_t counts[2] = { m_Coords.size(), m_Indices.size()/3 };
+    for (int t=0; t<2; t++) {
+        SlotTable& table = *tables[t];
+        const size_t count = counts[t];
+
+        // éléments retirés de la fin des tableaux
+        for (size_t position=count; position<table.slots.size(); position++) {
+            if (table.slots[position] >= 0) table.release(table.slots[position]);
+            table.holes--;
+        }
+        if (table.slots.size() > count) table.slots.resize(count);
+
+        // éléments ajoutés à la fin des tableaux
+        for (size_t position=table.slots.size(); position<count; position++) {
+            table.allocate(position);
+        }
+    }
+
+    // les trous qui étaient au-delà de la fin des triangles ont disparu
+    const long trianglecount = counts[1];
+    m_TriangleHoles.erase(
+        std::remove_if(m_TriangleHoles.begin(), m_TriangleHoles.end(), [trianglecount](long position) { return position >= trianglecount; }),
+        m_TriangleHoles.end());
+}
+
+
+/**
+ * retire des tableaux les sommets et triangles supprimés, ainsi que les triangles dont un
+ * sommet a été supprimé. Les éléments restants gardent leur ordre et leurs emplacements.
+ */
+void Mesh::compactSlots()
+{
+    syncSlots();
+
+    // sommets : ramener les sommets restants au début des tableaux, remap donne leurs nouveaux numéros
+    const GLuint REMOVED = ~0u;
+    std::vector<GLuint> remap;
+    if (m_VertexSlots.holes > 0) {
+        const size_t vertexcount = m_Coords.size();
+        remap.resize(vertexcount);
+        size_t kept = 0;
+        size_t first = vertexcount;
+        for (size_t v=0; v<vertexcount; v++) {
+            const long slot = m_VertexSlots.slots[v];
+            if (slot < 0) {
+                remap[v] = REMOVED;
+                first = std::min(first, v);
+                continue;
+            }
+            remap[v] = kept;
+            if (kept != v) {
+                m_Coords[kept]    = m_Coords[v];
+                m_Colors[kept]    = m_Colors[v];
+                m_TexCoords[kept] = m_TexCoords[v];
+                m_Normals[kept]   = m_Normals[v];
+                m_Tangents[kept]  = m_Tangents[v];
+                m_VertexSlots.slots[kept] = slot;
+                m_VertexSlots.positions[slot] = kept;
+            }
+            kept++;
+        }
+        m_Coords.resize(kept);
+        m_Colors.resize(kept);
+        m_TexCoords.resize(kept);
+        m_Normals.resize(kept);
+        m_Tangents.resize(kept);
+        m_VertexSlots.slots.resize(kept);
+        m_VertexSlots.holes = 0;
+
+        // les sommets décalés sont à renvoyer
+        for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+            markDirty(attribute, first, kept - first);
+        }
+    }
+
+    // triangles : retirer les trous et ceux qui emploient un sommet supprimé, renuméroter les autres
+    if (m_TriangleSlots.holes > 0 || ! remap.empty()) {
+        const size_t trianglecount = m_Indices.size() / 3;
+        size_t kept = 0;
+        size_t first = trianglecount;
+        for (size_t t=0; t<trianglecount; t++) {
+            long slot = m_TriangleSlots.slots[t];
+            GLuint corners[3] = { m_Indices[t*3 + 0], m_Indices[t*3 + 1], m_Indices[t*3 + 2] };
+            if (slot >= 0 && ! remap.empty()) {
+                for (int k=0; k<3; k++) corners[k] = remap[corners[k]];
+                if (corners[0] == REMOVED || corners[1] == REMOVED || corners[2] == REMOVED) {
+                    m_TriangleSlots.release(slot);
+                    slot = -1;
+                }
+            }
+            if (slot < 0) continue;
+
+            // premier triangle dont le contenu change à sa nouvelle position
+            GLuint* target = &m_Indices[kept*3];
+            if (target[0] != corners[0] || target[1] != corners[1] || target[2] != corners[2]) {
+                first = std::min(first, kept);
+                target[0] = corners[0];
+                target[1] = corners[1];
+                target[2] = corners[2];
+            }
+            m_TriangleSlots.slots[kept] = slot;
+            m_TriangleSlots.positions[slot] = kept;
+            kept++;
+        }
+        m_Indices.resize(kept*3);
+        m_TriangleSlots.slots.resize(kept);
+        m_TriangleSlots.holes = 0;
+        m_TriangleHoles.clear();
+
+        // les triangles décalés sont à renvoyer, les niveaux de détail ont déjà été supprimés
+        if (first < kept) markTrianglesDirty(first, kept - first);
+        if (kept < trianglecount) m_EdgesChanged = true;
+    }
+}
+
+
+/**
+ * applique une renumérotation aux éléments d'un tableau d'attributs
+ * @param values : tableau à réordonner, values[v] va en remap[v]
+ * @param remap : nouveau numéro de chaque élément
+ */
+template<typename T> static void permute(std::vector<T>& values, const std::vector<GLuint>& remap)
+{
+    std::vector<T> result(values.size());
+    for (size_t v=0; v<values.size(); v++) result[remap[v]] = values[v];
+    values.swap(result);
+}
+
+
+/**
+ * Cette méthode change l'ordre des sommets dans les tableaux, leurs poignées les suivent.
+ * NB: les indices des triangles ne sont pas modifiés, c'est à l'appelant de les renuméroter
+ * @param remap : nouveau numéro de chaque sommet
+ */
+void Mesh::permuteVertices(const std::vector<GLuint>& remap)
+{
+    compact();
+    permute(m_Coords, remap);
+    permute(m_Colors, remap);
+    permute(m_TexCoords, remap);
+    permute(m_Normals, remap);
+    permute(m_Tangents, remap);
+
+    // les emplacements suivent leurs sommets
+    std::vector<long> slots(m_VertexSlots.slots.size());
+    for (size_t v=0; v<slots.size(); v++) {
+        const long slot = m_VertexSlots.slots[v];
+        slots[remap[v]] = slot;
+        m_VertexSlots.positions[slot] = remap[v];
+    }
+    m_VertexSlots.slots.swap(slots);
+
+    // tout est à renvoyer
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        markDirty(attribute, 0, m_Coords.size());
+    }
+}
+
+
+/**
+ * Cette méthode change l'ordre des triangles dans le tableau des indices, leurs poignées les suivent.
+ * @param order : ancien numéro du triangle à placer à chaque position, ex: order[0] devient le premier
+ */
+void Mesh::permuteTriangles(const std::vector<uint32_t>& order)
+{
+    compact();
+    const size_t trianglecount = m_Indices.size() / 3;
+    std::vector<GLuint> indices(m_Indices.size());
+    std::vector<long> slots(trianglecount);
+    for (size_t t=0; t<trianglecount; t++) {
+        const uint32_t old = order[t];
+        indices[t*3 + 0] = m_Indices[old*3 + 0];
+        indices[t*3 + 1] = m_Indices[old*3 + 1];
+        indices[t*3 + 2] = m_Indices[old*3 + 2];
+
+        // les emplacements suivent leurs triangles
+        const long slot = m_TriangleSlots.slots[old];
+        slots[t] = slot;
+        m_TriangleSlots.positions[slot] = t;
+    }
+    m_Indices.swap(indices);
+    m_TriangleSlots.slots.swap(slots);
+
+    // tout est à renvoyer
+    markTrianglesDirty(0, trianglecount);
+}
+
+
+/**
+ * Cette méthode recalcule les normales des sommets.
+ * Les normales des triangles sont calculées d'après leurs côtés.
+ * Les normales des sommets sont les moyennes des normales des triangles
+ * auxquels ils appartiennent.
+ * NB: chaque triangle ajoute sa normale à ses trois sommets en une seule passe
+ * sur le tableau des indices, au lieu de chercher pour chaque sommet les triangles qui le contiennent.
+ */
+void Mesh::computeNormals()
+{
+    compact();
+
+    // remettre à zéro les normales des sommets
+    for (vec3& normal: m_Normals) {
+        vec3::zero(normal);
+    }
+
+    // calculer les normales des triangles et les accumuler sur leurs sommets
+    vec3 cAB = vec3::create();
+    vec3 cAC = vec3::create();
+    vec3 normal = vec3::create();
+    for (size_t i=0; i<m_Indices.size(); i+=3) {
+        const GLuint* corners = &m_Indices[i];
+        vec3::subtract(cAB, m_Coords[corners[1]], m_Coords[corners[0]]);
+        vec3::subtract(cAC, m_Coords[corners[2]], m_Coords[corners[0]]);
+        // la normale du triangle n'est pas normalisée, elle tient compte de sa surface
+        vec3::cross(normal, cAB, cAC);
+        for (int k=0; k<3; k++) {
+            vec3& sum = m_Normals[corners[k]];
+            vec3::add(sum, sum, normal);
+        }
+    }
+
+    // normaliser les normales des sommets
+    for (vec3& sum: m_Normals) {
+        vec3::normalize(sum, sum);
+    }
+
+    // toutes les normales sont à renvoyer
+    markDirty(VertexFormat::NORMAL, 0, m_Normals.size());
+}
+
+
+/**
+ * Cette méthode recalcule les tangentes des sommets.
+ * Les tangentes des triangles sont calculées d'après leurs côtés et les coordonnées de texture.
+ * Les tangentes des sommets sont les moyennes des tangentes des triangles
+ * auxquels ils appartiennent.
+ * NB: même principe que computeNormals, une seule passe sur les triangles
+ */
+void Mesh::computeTangents()
+{
+    compact();
+
+    // remettre à zéro les tangentes des sommets
+    for (vec3& tangent: m_Tangents) {
+        vec3::zero(tangent);
+    }
+
+    // calculer les tangentes des triangles et les accumuler sur leurs sommets
+    for (int it=0; it<getTriangleCount(); it++) {
+        vec3 tangent = makeTriangle(it).getTangent();
+        const GLuint* corners = &m_Indices[it*3];
+        for (int k=0; k<3; k++) {
+            vec3& sum = m_Tangents[corners[k]];
+            vec3::add(sum, sum, tangent);
+        }
+    }
+
+    // normaliser les tangentes des sommets
+    for (vec3& sum: m_Tangents) {
+        vec3::normalize(sum, sum);
+    }
+
+    // toutes les tangentes sont à renvoyer
+    markDirty(VertexFormat::TANGENT, 0, m_Tangents.size());
+}
+
+
+/**
+ * Table de hachage à adressage ouvert qui associe un triplet d'indices (v,vt,vn) d'un fichier OBJ
+ * au numéro du sommet du maillage qui a été créé pour lui. Deux coins de faces qui ont le même triplet
+ * partagent le même sommet.
+ */
+class VertexWeldTable
+{
+private:
+
+    struct Entry
+    {
+        int nv, nt, nn;
+        int vertex;
+    };
+
+    // cases de la table, leur nombre est une puissance de 2
+    std::vector<Entry> m_Entries;
+    size_t m_Count;
+
+    static size_t hash(int nv, int nt, int nn)
+    {
+        uint64_t h = (uint32_t)nv * 0x9E3779B97F4A7C15ULL;
+        h ^= (uint32_t)nt * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+        h ^= (uint32_t)nn * 0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+        return h ^ (h >> 29);
+    }
+
+    // double la taille de la table et y replace les entrées
+    void grow()
+    {
+        std::vector<Entry> old;
+        old.swap(m_Entries);
+        m_Entries.assign(old.size() * 2, Entry{0, 0, 0, -1});
+        m_Count = 0;
+        for (Entry& entry: old) {
+            if (entry.vertex >= 0) find(entry.nv, entry.nt, entry.nn) = entry.vertex;
+        }
+    }
+
+public:
+
+    VertexWeldTable() : m_Entries(1024, Entry{0, 0, 0, -1}), m_Count(0) {}
+
+    /**
+     * retourne la case associée au triplet, elle contient -1 si le triplet est nouveau
+     * et c'est alors à l'appelant d'y placer le numéro du sommet créé
+     */
+    int& find(int nv, int nt, int nn)
+    {
+        // garder un taux de remplissage inférieur à 1/2
+        if (2 * (m_Count + 1) > m_Entries.size()) grow();
+
+        // sondage linéaire
+        size_t mask = m_Entries.size() - 1;
+        size_t i = hash(nv, nt, nn) & mask;
+        while (m_Entries[i].vertex >= 0) {
+            Entry& entry = m_Entries[i];
+            if (entry.nv == nv && entry.nt == nt && entry.nn == nn) return entry.vertex;
+            i = (i + 1) & mask;
+        }
+        Entry& entry = m_Entries[i];
+        entry.nv = nv; entry.nt = nt; entry.nn = nn;
+        m_Count++;
+        return entry.vertex;
+    }
+};
+
+
+/**
+ * passe les espaces et tabulations (mais pas la fin de ligne)
+ */
+static inline void skipBlanks(const char*& p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+}
+
+
+/**
+ * lit un entier signé à partir de p, p est avancé derrière
+ * @return false s'il n'y a pas de nombre à cet endroit ou s'il dépasse INT_MAX, p n'est alors pas avancé
+ */
+static inline bool parseInt(const char*& p, const char* end, int& value)
+{
+    bool negative = false;
+    const char* q = p;
+    if (q < end && (*q == '-' || *q == '+')) negative = (*q++ == '-');
+    if (q >= end || *q < '0' || *q > '9') return false;
+    int64_t n = 0;
+    while (q < end && *q >= '0' && *q <= '9') {
+        n = n * 10 + (*q++ - '0');
+        if (n > INT_MAX) return false;
+    }
+    value = (int) (negative ? -n : n);
+    p = q;
+    return true;
+}
+
+
+/**
+ * lit un réel à partir de p, p est avancé derrière. strtof ne connaît pas end : le texte doit
+ * être suivi d'un '\0' ou d'une fin de ligne, voir loadObj
+ * @return false s'il n'y a pas de nombre à cet endroit, value vaut alors 0
+ */
+static inline bool parseFloat(const char*& p, const char* end, float& value)
+{
+    skipBlanks(p, end);
+    value = 0.0;
+    if (p >= end || *p == '\n') return false;
+    char* after;
+    value = strtof(p, &after);
+    if (after == p) return false;
+    p = after;
+    return true;
+}
+
+
+/**
+ * compare le mot [begin,end[ au mot-clé en minuscules, sans tenir compte de la casse
+ */
+static inline bool isKeyword(const char* begin, const char* end, const char* keyword)
+{
+    while (begin < end && *keyword != '\0') {
+        if (tolower((unsigned char) *begin) != *keyword) return false;
+        begin++;
+        keyword++;
+    }
+    return begin == end && *keyword == '\0';
+}
+
+
+/**
+ * Coin de face lu dans un fichier OBJ : indices v, vt, vn à partir de 0.
+ * Un indice négatif dans le fichier est relatif aux lignes qui le précèdent, il est alors
+ * mémorisé par rapport au début du morceau de fichier qui le contient (voir ObjChunk)
+ * et sera rendu absolu lors de la fusion des morceaux.
+ */
+struct ObjCorner
+{
+    int index[3];               // v, vt, vn
+    unsigned char present;      // bit i : index[i] est présent dans le fichier
+    unsigned char relative;     // bit i : index[i] est relatif au début du morceau
+};
+
+
+/**
+ * Morceau d'un fichier OBJ, composé de lignes entières, et ce qu'on en a extrait
+ */
+struct ObjChunk
+{
+    // partie du fichier à analyser
+    const char* begin;
+    const char* end;
+
+    // attributs lus dans ce morceau
+    std::vector<vec3> coordlist;
+    std::vector<vec2> texcoordlist;
+    std::vector<vec3> normallist;
+
+    // coins de toutes les faces à la suite, et nombre de coins de chaque face
+    std::vector<ObjCorner> corners;
+    std::vector<int> faces;
+};
+
+
+/**
+ * lit le prochain coin de face v, v/vt, v//vn ou v/vt/vn à partir de p, p est avancé derrière
+ * @param counts : nombres de v, vt et vn déjà lus dans le morceau, pour les indices relatifs
+ * @return false s'il n'y a plus de coin sur la ligne
+ */
+static inline bool parseCorner(const char*& p, const char* end, const int counts[3], ObjCorner& corner)
+{
+    skipBlanks(p, end);
+    if (p >= end || *p == '\n') return false;
+
+    // lire jusqu'à trois nombres séparés par des /, celui du milieu peut manquer
+    int values[3] = { 0, 0, 0 };
+    parseInt(p, end, values[0]);
+    if (p < end && *p == '/') {
+        p++;
+        parseInt(p, end, values[1]);
+        if (p < end && *p == '/') {
+            p++;
+            parseInt(p, end, values[2]);
+        }
+    }
+    // ignorer la fin d'un mot mal formé
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+
+    // passer les numéros à partir de 0, les négatifs sont comptés par rapport au début du morceau
+    corner.present = 0;
+    corner.relative = 0;
+    for (int i=0; i<3; i++) {
+        int n = values[i];
+        if (n == 0) {
+            corner.index[i] = -1;
+            continue;
+        }
+        corner.present |= 1 << i;
+        if (n > 0) {
+            corner.index[i] = n - 1;
+        } else {
+            corner.index[i] = counts[i] + n;
+            corner.relative |= 1 << i;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * analyse les lignes d'un morceau de fichier OBJ, peut être appelée en parallèle sur plusieurs morceaux
+ * @param chunk : morceau à analyser, ses tableaux sont remplis
+ */
+static void parseObjChunk(ObjChunk* chunk)
+{
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    while (p < end) {
+        // fin de la ligne courante
+        const char* eol = (const char*) memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+
+        // extraire le premier mot de la ligne
+        skipBlanks(p, eol);
+        const char* word = p;
+        while (p < eol && *p != ' ' && *p != '\t' && *p != '\r') p++;
+
+        if (isKeyword(word, p, "f")) {
+            // lire tous les coins de la face
+            const int counts[3] = { (int)chunk->coordlist.size(), (int)chunk->texcoordlist.size(), (int)chunk->normallist.size() };
+            ObjCorner corner;
+            int count = 0;
+            while (parseCorner(p, eol, counts, corner)) {
+                chunk->corners.push_back(corner);
+                count++;
+            }
+            if (count > 0) chunk->faces.push_back(count);
+        } else
+        if (isKeyword(word, p, "v")) {
+            // coordonnées du sommet
+            float x, y, z;
+            parseFloat(p, eol, x);
+            parseFloat(p, eol, y);
+            parseFloat(p, eol, z);
+            chunk->coordlist.push_back(vec3::fromValues(x,y,z));
+        } else
+        if (isKeyword(word, p, "vt")) {
+            // coordonnées de texture
+            float u, v;
+            parseFloat(p, eol, u);
+            parseFloat(p, eol, v);
+            chunk->texcoordlist.push_back(vec2::fromValues(u,v));
+        } else
+        if (isKeyword(word, p, "vn")) {
+            // coordonnées de la normale
+            float nx, ny, nz;
+            parseFloat(p, eol, nx);
+            parseFloat(p, eol, ny);
+            parseFloat(p, eol, nz);
+            chunk->normallist.push_back(vec3::fromValues(nx,ny,nz));
+        }
+
+        // ligne suivante
+        p = eol + 1;
+    }
+}
+
+
+/**
+ * retourne le numéro du sommet correspondant aux indices (v,vt,vn) à partir de 0, en le créant s'il n'existe pas encore
+ * @return -1 si le coin de face n'est pas correct
+ */
+static int findOrCreateVertex(
+    Mesh* mesh,
+    int nv, int nt, int nn,
+    VertexWeldTable &vertextable,
+    std::vector<vec3> &coordlist,
+    std::vector<vec2> &texcoordlist,
+    std::vector<vec3> &normallist)
+{
+    // vérifier les indices des coordonnées 3D, des coordonnées de texture et de la normale
+    if (nv < 0 || nv >= (int)coordlist.size()) return -1;
+    if (nt >= (int)texcoordlist.size()) nt = -1;
+    if (nn >= (int)normallist.size()) nn = -1;
+
+    // ce triplet a-t-il déjà donné un sommet ?
+    int& vertex = vertextable.find(nv, nt, nn);
+    if (vertex >= 0) return vertex;
+
+    // il faut créer un nouveau sommet car soit nouveau, soit un peu différent des autres
+    Vertex created = mesh->addVertex(coordlist[nv]);
+    if (nt >= 0) created.setTexCoords(texcoordlist[nt]);
+    if (nn >= 0) created.setNormal(normallist[nn]);
+    vertex = created.getIndex();
+    return vertex;
+}
+
+
+/**
+ * Cette méthode lit le fichier indiqué, il contient un maillage au format OBJ
+ * Lors du premier chargement, une copie binaire du maillage est enregistrée à côté
+ * du fichier OBJ (extension .mesh), elle est relue directement lors des chargements suivants
+ * tant que le fichier OBJ n'a pas été modifié.
+ * Les gros fichiers sont découpés en morceaux analysés en parallèle, le résultat est
+ * identique à une analyse séquentielle.
+ * @param filename : nom complet du fichier à lire
+ * @param threads : nombre maximal de threads d'analyse, 0 pour le nombre de coeurs
+ * @param options : combinaison de LoadOptions, traitements appliqués après la lecture,
+ * la copie binaire contient leur résultat
+ */
+void Mesh::loadObj(std::string filename, int threads, unsigned options)
+{
+    // les sommets lus sont ajoutés à la suite des sommets actuels, sans trous
+    compact();
+
+    // copie binaire du maillage, employée si elle est plus récente que le fichier obj et faite avec les mêmes options
+    std::string binfilename = filename + ".mesh";
+    if (loadBinary(binfilename, filename, options)) {
+        std::cout<<m_Name<<" : "<<binfilename<<" loaded,"<<getVertexCount()<<" vertices,"<<getTriangleCount()<<" triangles"<<std::endl;
+        return;
+    }
+
+    // la copie binaire ne peut être faite que si le maillage ne contient que le fichier obj
+    bool cacheable = m_Coords.empty() && m_Indices.empty();
+
+    // lecture du fichier entier en mémoire, les lignes n'ont donc pas de longueur maximale
+    std::ifstream inputStream;
+    inputStream.open(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (! inputStream.is_open()) {
+        std::cerr << "Error : \"" << filename << "\" cannot be loaded, check pathname and permissions." << std::endl;
+        return;
+    }
+    inputStream.seekg(0, std::ios::end);
+    std::vector<char> content((size_t) inputStream.tellg());
+    inputStream.seekg(0, std::ios::beg);
+    inputStream.read(content.data(), content.size());
+    inputStream.close();
+
+    // sentinelle après la fin, hors de [begin, end[ : strtof (parseFloat) s'y arrête même sans fin de ligne finale
+    const size_t size = content.size();
+    content.push_back('\0');
+
+    // nombre de morceaux : un par thread, mais pas de morceaux trop petits
+    const size_t MIN_CHUNK_SIZE = 256*1024;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    int chunkcount = std::max<size_t>(1, std::min<size_t>(threads, size / MIN_CHUNK_SIZE));
+
+    // découpage du fichier en morceaux qui se terminent par une fin de ligne
+    std::vector<ObjChunk> chunks(chunkcount);
+    const char* begin = content.data();
+    const char* end = begin + size;
+    for (int c=0; c<chunkcount; c++) {
+        const char* limit = (c == chunkcount-1) ? end : content.data() + size * (c+1) / chunkcount;
+        if (limit < begin) limit = begin;
+        const char* eol = (const char*) memchr(limit, '\n', end - limit);
+        chunks[c].begin = begin;
+        chunks[c].end = (eol == nullptr) ? end : eol + 1;
+        begin = chunks[c].end;
+    }
+
+    // analyse des morceaux en parallèle, le premier dans ce thread
+    std::vector<std::thread> workers;
+    for (int c=1; c<chunkcount; c++) {
+        workers.push_back(std::thread(parseObjChunk, &chunks[c]));
+    }
+    parseObjChunk(&chunks[0]);
+    for (std::thread& worker: workers) worker.join();
+
+    // fusion des attributs : chaque morceau commence après la somme de ceux qui le précèdent
+    std::vector<vec3> coordlist;
+    std::vector<vec2> texcoordlist;
+    std::vector<vec3> normallist;
+    std::vector<int> bases(3 * chunkcount);
+    size_t coordcount = 0, texcoordcount = 0, normalcount = 0;
+    for (int c=0; c<chunkcount; c++) {
+        bases[3*c+0] = coordcount;    coordcount    += chunks[c].coordlist.size();
+        bases[3*c+1] = texcoordcount; texcoordcount += chunks[c].texcoordlist.size();
+        bases[3*c+2] = normalcount;   normalcount   += chunks[c].normallist.size();
+    }
+    coordlist.reserve(coordcount);
+    texcoordlist.reserve(texcoordcount);
+    normallist.reserve(normalcount);
+    for (ObjChunk& chunk: chunks) {
+        coordlist.insert(coordlist.end(), chunk.coordlist.begin(), chunk.coordlist.end());
+        texcoordlist.insert(texcoordlist.end(), chunk.texcoordlist.begin(), chunk.texcoordlist.end());
+        normallist.insert(normallist.end(), chunk.normallist.begin(), chunk.normallist.end());
+        std::vector<vec3>().swap(chunk.coordlist);
+        std::vector<vec2>().swap(chunk.texcoordlist);
+        std::vector<vec3>().swap(chunk.normallist);
+    }
+
+    // création des sommets et des triangles dans l'ordre du fichier
+    const int firsttriangle = getTriangleCount();
+    VertexWeldTable vertextable;
+    std::vector<int> facevertices;
+    for (int c=0; c<chunkcount; c++) {
+        const ObjChunk& chunk = chunks[c];
+        size_t ic = 0;
+        for (int count: chunk.faces) {
+            // numéros des sommets de la face, -1 pour les coins incorrects
+            facevertices.clear();
+            for (int i=0; i<count; i++, ic++) {
+                const ObjCorner& corner = chunk.corners[ic];
+                int indices[3];
+                for (int k=0; k<3; k++) {
+                    indices[k] = corner.index[k];
+                    if (corner.relative & (1 << k)) indices[k] += bases[3*c+k];
+                    if (! (corner.present & (1 << k))) indices[k] = -1;
+                }
+                facevertices.push_back(findOrCreateVertex(this, indices[0], indices[1], indices[2], vertextable, coordlist, texcoordlist, normallist));
+            }
+            // découpage de la face en éventail de triangles
+            for (int i=2; i<count; i++) {
+                int v1 = facevertices[0];
+                int v2 = facevertices[i-1];
+                int v3 = facevertices[i];
+                if (v1 >= 0 && v2 >= 0 && v3 >= 0) {
+                    m_Indices.push_back(v1);
+                    m_Indices.push_back(v2);
+                    m_Indices.push_back(v3);
+                }
+            }
+        }
+    }
+    markTrianglesDirty(firsttriangle, getTriangleCount() - firsttriangle);
+
+    // réordonner les triangles et les sommets pour la carte graphique
+    if (options & LOAD_OPTIMIZE) MeshOptimizer::optimize(this);
+
+    // niveaux de détail, après l'optimisation car elle renumérote les sommets
+    if (options & LOAD_LODS) generateLods();
+
+    // message
+    std::cout<<m_Name<<" : obj loaded,"<<getVertexCount()<<" vertices,"<<getTriangleCount()<<" triangles,"<<getLodCount()<<" levels of detail"<<std::endl;
+
+    // enregistrer la copie binaire pour les prochains chargements
+    if (cacheable) saveBinary(binfilename, filename, options);
+}
+
+
+// entête des fichiers binaires de maillage, suivi des tableaux de coordonnées (3 floats par sommet),
+// normales (3 floats), coordonnées de texture (2 floats), des indices des triangles (3 uint32),
+// de la description des niveaux de détail (MeshFileLod) puis de leurs indices (3 uint32 par triangle)
+struct MeshFileHeader
+{
+    char magic[4];              // "MESH"
+    uint32_t version;           // version du format, voir MESH_FILE_VERSION
+    uint32_t vertexCount;       // nombre de sommets
+    uint32_t triangleCount;     // nombre de triangles
+    int64_t sourceTime;         // date de modification du fichier source en ns, 0 si aucun
+    int64_t sourceSize;         // taille du fichier source, 0 si aucun
+    uint32_t options;           // Mesh::LoadOptions appliquées au maillage
+    uint32_t lodCount;          // nombre de niveaux de détail simplifiés
+};
+struct MeshFileLod
+{
+    uint32_t triangleCount;     // nombre de triangles du niveau
+    float error;                // erreur géométrique du niveau
+};
+static const uint32_t MESH_FILE_VERSION = 2;
+
+
+/**
+ * retourne la date de modification et la taille d'un fichier
+ * @param filename : nom du fichier, "" si aucun
+ * @param time : date de modification en nanosecondes
+ * @param size : taille du fichier en octets
+ * @return false si le fichier n'existe pas
+ */
+static bool getFileStamp(std::string filename, int64_t& time, int64_t& size)
+{
+    time = 0;
+    size = 0;
+    if (filename.empty()) return true;
+    struct stat infos;
+    if (stat(filename.c_str(), &infos) != 0) return false;
+    time = (int64_t)infos.st_mtim.tv_sec * 1000000000 + infos.st_mtim.tv_nsec;
+    size = infos.st_size;
+    return true;
+}
+
+
+/**
+ * Cette méthode enregistre le maillage dans un fichier binaire : entête puis tableaux
+ * des coordonnées, normales, coordonnées de texture et indices des triangles, puis niveaux de détail
+ * @param filename : nom complet du fichier à écrire
+ * @param sourcefilename : fichier d'origine du maillage (sa date et sa taille sont mémorisées), ou ""
+ * @param options : LoadOptions appliquées au maillage, mémorisées dans le fichier
+ * @return true si le fichier a pu être écrit
+ */
+bool Mesh::saveBinary(std::string filename, std::string sourcefilename, unsigned options)
+{
+    compact();
+
+    // entête
+    MeshFileHeader header;
+    memcpy(header.magic, "MESH", 4);
+    header.version = MESH_FILE_VERSION;
+    header.vertexCount = getVertexCount();
+    header.triangleCount = getTriangleCount();
+    header.options = options;
+    header.lodCount = m_Lods.size();
+    if (! getFileStamp(sourcefilename, header.sourceTime, header.sourceSize)) return false;
+
+    // écriture dans un fichier temporaire puis renommage, pour ne jamais laisser de fichier incomplet
+    std::string tmpfilename = filename + ".tmp";
+    std::ofstream output(tmpfilename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (! output.is_open()) {
+        std::cerr << "Warning : \"" << filename << "\" cannot be written, mesh will not be cached." << std::endl;
+        return false;
+    }
+    output.write((const char*) &header, sizeof(header));
+    output.write((const char*) m_Coords.data(),    m_Coords.size()    * sizeof(vec3));
+    output.write((const char*) m_Normals.data(),   m_Normals.size()   * sizeof(vec3));
+    output.write((const char*) m_TexCoords.data(), m_TexCoords.size() * sizeof(vec2));
+    output.write((const char*) m_Indices.data(),   m_Indices.size()   * sizeof(GLuint));
+    for (const LodLevel& lod: m_Lods) {
+        MeshFileLod entry = { (uint32_t) lod.count, lod.error };
+        output.write((const char*) &entry, sizeof(entry));
+    }
+    output.write((const char*) m_LodIndices.data(), m_LodIndices.size() * sizeof(GLuint));
+    output.close();
+    if (output.fail() || rename(tmpfilename.c_str(), filename.c_str()) != 0) {
+        unlink(tmpfilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Cette méthode ajoute au maillage le contenu d'un fichier binaire écrit par saveBinary.
+ * Le fichier est projeté en mémoire (mmap) et n'est pas analysé. Ses niveaux de détail ne
+ * sont repris que si le maillage était vide.
+ * @param filename : nom complet du fichier à lire
+ * @param sourcefilename : fichier d'origine du maillage, le fichier binaire est refusé s'il est plus ancien, ou ""
+ * @param options : LoadOptions attendues, le fichier est refusé s'il a été fait avec d'autres
+ * @return false si le fichier est absent, invalide ou périmé
+ */
+bool Mesh::loadBinary(std::string filename, std::string sourcefilename, unsigned options)
+{
+    compact();
+
+    // ouverture et projection du fichier en mémoire
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat infos;
+    if (fstat(fd, &infos) != 0 || (size_t)infos.st_size < sizeof(MeshFileHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t length = infos.st_size;
+    void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    // vérification de l'entête : format, version, fichier source, options et taille ; les tailles
+    // sont calculées en size_t et comparées à ce qui reste du fichier avant de former un pointeur
+    const MeshFileHeader* header = (const MeshFileHeader*) data;
+    const size_t vertexbytes   = (size_t) header->vertexCount * 8 * sizeof(float);
+    const size_t trianglebytes = (size_t) header->triangleCount * 3 * sizeof(uint32_t);
+    const size_t lodbytes      = (size_t) header->lodCount * sizeof(MeshFileLod);
+    size_t remaining = length - sizeof(MeshFileHeader);
+    int64_t sourceTime, sourceSize;
+    bool valid =
+        memcmp(header->magic, "MESH", 4) == 0 &&
+        header->version == MESH_FILE_VERSION &&
+        getFileStamp(sourcefilename, sourceTime, sourceSize) &&
+        header->sourceTime == sourceTime &&
+        header->sourceSize == sourceSize &&
+        header->options == options &&
+        vertexbytes <= remaining &&
+        trianglebytes <= remaining - vertexbytes &&
+        lodbytes <= remaining - vertexbytes - trianglebytes;
+    const MeshFileLod* lods = nullptr;
+    size_t lodtrianglecount = 0;
+    if (valid) {
+        const size_t lodoffset = sizeof(MeshFileHeader) + vertexbytes + trianglebytes;
+        lods = (const MeshFileLod*) ((const char*) data + lodoffset);
+        remaining = length - lodoffset - lodbytes;
+        for (uint32_t l=0; l<header->lodCount; l++) lodtrianglecount += lods[l].triangleCount;
+        valid = lodtrianglecount <= remaining / (3 * sizeof(uint32_t)) && remaining == lodtrianglecount * 3 * sizeof(uint32_t);
+    }
+    if (! valid) {
+        munmap(data, length);
+        return false;
+    }
+
+    // tableaux contigus qui suivent l'entête
+    const uint32_t nv = header->vertexCount;
+    const float* coords    = (const float*) (header + 1);
+    const float* normals   = coords  + 3 * (size_t) nv;
+    const float* texcoords = normals + 3 * (size_t) nv;
+    const uint32_t* indices = (const uint32_t*) (texcoords + 2 * (size_t) nv);
+    const uint32_t* lodindices = (const uint32_t*) (lods + header->lodCount);
+
+    // un fichier abîmé ne doit pas donner un maillage faux : il sera relu à partir de l'OBJ
+    for (size_t i=0; i<3 * (size_t) header->triangleCount; i++) {
+        if (indices[i] >= nv) valid = false;
+    }
+    for (size_t i=0; i<3 * lodtrianglecount; i++) {
+        if (lodindices[i] >= nv) valid = false;
+    }
+    if (! valid) {
+        munmap(data, length);
+        return false;
+    }
+
+    // recopie des tableaux à la suite de ceux du maillage
+    const bool empty = m_Coords.empty() && m_Indices.empty();
+    const uint32_t first = getVertexCount();
+    const uint32_t firsttriangle = getTriangleCount();
+    m_Coords.insert(m_Coords.end(), (const vec3*) coords, (const vec3*) coords + nv);
+    m_Normals.insert(m_Normals.end(), (const vec3*) normals, (const vec3*) normals + nv);
+    m_TexCoords.insert(m_TexCoords.end(), (const vec2*) texcoords, (const vec2*) texcoords + nv);
+    m_Colors.resize(m_Coords.size(), vec3::fromValues(1, 0, 1));
+    m_Tangents.resize(m_Coords.size(), vec3::create());
+    m_Indices.reserve(m_Indices.size() + 3 * header->triangleCount);
+    for (size_t i=0; i<3 * (size_t) header->triangleCount; i++) {
+        m_Indices.push_back(first + indices[i]);
+    }
+
+    // les nouveaux sommets et triangles seront envoyés au prochain dessin
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        markDirty(attribute, first, nv);
+    }
+    markTrianglesDirty(firsttriangle, getTriangleCount() - firsttriangle);
+
+    // niveaux de détail, ils ne décrivent que le contenu du fichier
+    if (empty) {
+        for (uint32_t l=0; l<header->lodCount; l++) {
+            LodLevel lod = { m_LodIndices.size() / 3, lods[l].triangleCount, lods[l].error };
+            m_LodIndices.insert(m_LodIndices.end(), lodindices, lodindices + 3 * lod.count);
+            lodindices += 3 * lod.count;
+            m_Lods.push_back(lod);
+        }
+        m_LodsChanged = true;
+    }
+
+    munmap(data, length);
+    return true;
+}
+
+
+/**
+ * signale que des sommets ont été modifiés : la plage sera renvoyée au prochain dessin
+ * NB: les setters de Vertex l'appellent, il faut l'appeler après une modification directe des tableaux
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @param first : numéro du premier sommet modifié
+ * @param count : nombre de sommets modifiés
+ */
+void Mesh::markDirty(int attribute, size_t first, size_t count)
+{
+    m_DirtyAttributes[attribute].add(first, first + count);
+
+    // les volumes englobants sont à recalculer
+    if (attribute == VertexFormat::COORDS) m_BoundsChanged = true;
+
+    // la copie dans l'arène aussi
+    if (m_Arena != nullptr) m_Arena->markDirty(this, attribute, first, count);
+}
+
+
+/**
+ * signale que des triangles ont été modifiés : leurs indices seront renvoyés au prochain dessin
+ * @param first : numéro du premier triangle modifié
+ * @param count : nombre de triangles modifiés
+ */
+void Mesh::markTrianglesDirty(size_t first, size_t count)
+{
+    m_DirtyFaces.add(first, first + count);
+    m_EdgesChanged = true;
+    if (m_Arena != nullptr) m_Arena->markIndicesDirty(this);
+
+    // les niveaux de détail ne correspondent plus au maillage
+    clearLods();
+}
+
+
+/**
+ * Cette méthode construit les niveaux de détail du maillage par simplifications successives
+ * (voir MeshSimplifier), chacun ayant environ ratio fois moins de triangles que le précédent.
+ * Ils emploient les mêmes sommets : seuls les indices des triangles sont ajoutés.
+ * La construction s'arrête plus tôt si le maillage ne peut plus être assez simplifié.
+ * NB: toute modification des triangles supprime les niveaux, il faut alors les reconstruire
+ * @param count : nombre de niveaux souhaité, y compris le maillage complet
+ * @param ratio : rapport du nombre de triangles entre deux niveaux successifs
+ */
+void Mesh::generateLods(int count, float ratio)
+{
+    compact();
+    clearLods();
+
+    // un niveau qui garde plus de 90% des triangles du précédent ne vaut pas la peine
+    const float MIN_REDUCTION = 0.9f;
+
+    // chaque niveau est simplifié depuis le maillage complet, pour que son erreur soit mesurée par rapport à lui
+    std::vector<GLuint> lodindices;
+    size_t previouscount = getTriangleCount();
+    float previouserror = 0.0f;
+    for (int level=1; level<count; level++) {
+        float error = MeshSimplifier::simplify(m_Indices, m_Coords, previouscount * ratio, lodindices);
+        size_t trianglecount = lodindices.size() / 3;
+        if (trianglecount == 0 || trianglecount > previouscount * MIN_REDUCTION) break;
+
+        // ordre des triangles favorable au cache de sommets, comme pour le maillage complet
+        MeshOptimizer::optimizeVertexCache(lodindices, m_Coords.size());
+
+        // l'erreur ne doit pas diminuer d'un niveau au suivant, selectLod les parcourt dans l'ordre
+        LodLevel lod = { m_LodIndices.size() / 3, trianglecount, std::max(error, previouserror) };
+        m_LodIndices.insert(m_LodIndices.end(), lodindices.begin(), lodindices.end());
+        m_Lods.push_back(lod);
+        previouscount = trianglecount;
+        previouserror = lod.error;
+    }
+    m_LodsChanged = true;
+    if (m_Arena != nullptr) m_Arena->markIndicesDirty(this);
+}
+
+
+/**
+ * supprime les niveaux de détail, il ne reste que le maillage complet
+ */
+void Mesh::clearLods()
+{
+    if (m_Lods.empty()) return;
+    m_Lods.clear();
+    std::vector<GLuint>().swap(m_LodIndices);
+    m_LodsChanged = true;
+    if (m_Arena != nullptr) m_Arena->markIndicesDirty(this);
+}
+
+
+/**
+ * retourne le nombre de triangles d'un niveau de détail
+ * @param level : niveau entre 0 (maillage complet) et getLodCount()-1
+ * @return nombre de triangles du niveau
+ */
+int Mesh::getLodTriangleCount(int level)
+{
+    if (level <= 0 || level > (int) m_Lods.size()) return getTriangleCount();
+    return m_Lods[level-1].count;
+}
+
+
+/**
+ * retourne l'erreur géométrique d'un niveau de détail, voir MeshSimplifier::simplify
+ * @param level : niveau entre 0 (maillage complet) et getLodCount()-1
+ * @return écart maximal estimé avec le maillage complet, dans l'unité des coordonnées
+ */
+float Mesh::getLodError(int level)
+{
+    if (level <= 0 || level > (int) m_Lods.size()) return 0.0f;
+    return m_Lods[level-1].error;
+}
+
 
 /**
- * constructeur. On lui fournit au moins un matériau (sous-classe de Material), pour les triangles et/ou les arêtes.
- * @param name : nom du maillage (pour la mise au point)
- * @param facesmaterial : sous-classe de Material pour dessiner les facettes
- * @param edgesmaterial : sous-classe de Material pour dessiner les arêtes
+ * choisit le niveau de détail le plus grossier dont l'erreur reste inférieure à la tolérance à
+ * l'écran. Pour ne pas alterner entre deux niveaux d'une image à l'autre, le niveau actuel n'est
+ * remplacé par un plus grossier que si celui-ci est nettement sous la tolérance (LOD_HYSTERESIS).
+ * @param pixelsperunit : nombre de pixels qu'occupe une unité de longueur à la distance de l'objet
+ * @param current : niveau actuellement dessiné
+ * @param tolerance : erreur tolérée, en pixels
+ * @return niveau à dessiner
  */
-Mesh::Mesh(std::string name, Material* facesmaterial, Material* edgesmaterial)
+int Mesh::selectLod(float pixelsperunit, int current, float tolerance)
 {
-    m_Name = name;
+    const int count = getLodCount();
+    int level = std::max(0, std::min(current, count-1));
 
-    // identifiants des VBOs
-    m_VertexBufferId     = -1;
-    m_ColorBufferId      = -1;
-    m_TexCoordsBufferId  = -1;
-    m_NormalBufferId     = -1;
-    m_TangentBufferId    = -1;
-    m_FacesIndexBufferId = -1;
-    m_EdgesIndexBufferId = -1;
+    // niveau plus fin dès que l'erreur du niveau actuel devient visible
+    while (level > 0 && getLodError(level) * pixelsperunit > tolerance) level--;
 
-    // matériaux, l'un peut être null
-    m_FacesMaterial = facesmaterial;
-    m_EdgesMaterial = edgesmaterial;
+    // niveau plus grossier seulement avec de la marge
+    while (level+1 < count && getLodError(level+1) * pixelsperunit <= tolerance * LOD_HYSTERESIS) level++;
 
-    // refaire les VBOs
-    m_UpdateVBOs = true;
+    return level;
 }
 
 
 /**
- * affecte les matériaux après création de l'instance
- * @param facesmaterial : sous-classe de Material pour dessiner les facettes
- * @param edgesmaterial : sous-classe de Material pour dessiner les arêtes
+ * supprime tous les VBOs, ils seront entièrement reconstruits au prochain dessin
  */
-void Mesh::setMaterials(Material* facesmaterial, Material* edgesmaterial)
+void Mesh::deleteBuffers()
 {
-    // matériaux, l'un peut être null
-    m_FacesMaterial = facesmaterial;
-    m_EdgesMaterial = edgesmaterial;
+    Utils::deleteVBO(m_InterleavedBufferId);
+    m_InterleavedBufferId = -1;
+    m_InterleavedCapacity = 0;
+    m_InterleavedFormat = 0;
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        Utils::deleteVBO(m_AttributeBufferId[attribute]);
+        m_AttributeBufferId[attribute] = -1;
+        m_AttributeCapacity[attribute] = 0;
+    }
+    Utils::deleteVBO(m_FacesIndexBufferId);
+    m_FacesIndexBufferId = -1;
+    m_FacesCapacity = 0;
+    Utils::deleteVBO(m_EdgesIndexBufferId);
+    m_EdgesIndexBufferId = -1;
+    m_EdgesCapacity = 0;
+    Utils::deleteVBO(m_LodIndexBufferId);
+    m_LodIndexBufferId = -1;
+    m_LodsChanged = true;
+    Utils::deleteVBO(m_InstanceBufferId);
+    m_InstanceBufferId = -1;
+    deleteVertexArrays();
 }
 
 
 /**
- * Cette méthode ajoute le sommet fourni à la fin de la liste
- * @param vertex sommet à rajouter
+ * lie le VAO du maillage correspondant à la disposition des attributs d'un matériau. Il est créé
+ * lors du premier appel, le matériau doit alors y décrire ses attributs ; ensuite, une seule
+ * liaison suffit à les retrouver tous. Les VAOs sont supprimés quand les VBOs des sommets changent.
+ * @param layout : disposition des attributs, voir Material::getVertexLayout
+ * @return true si le VAO existait déjà, false s'il vient d'être créé et que ses attributs sont à décrire
  */
-void Mesh::pushVertex(Vertex* vertex)
+bool Mesh::bindVertexArray(uint64_t layout)
 {
-    m_VertexList.push_back(vertex);
-
-    // refaire les VBOs
-    m_UpdateVBOs = true;
+    // il n'y a que quelques matériaux par maillage
+    for (const VertexArray& vertexarray: m_VertexArrays) {
+        if (vertexarray.layout == layout) {
+            glBindVertexArray(vertexarray.id);
+            return true;
+        }
+    }
+    GLuint id;
+    glGenVertexArrays(1, &id);
+    glBindVertexArray(id);
+    m_VertexArrays.push_back(VertexArray{layout, id});
+    return false;
 }
 
 
 /**
- * Cette méthode enlève le sommet fourni de la liste
- * NB: la méthode ne le supprime pas (voir son destructeur pour cela)
- * @see #delVertex
- * @param vertex sommet à enlever
+ * supprime les VAOs, ils seront reconstruits au prochain dessin
  */
-void Mesh::popVertex(Vertex* vertex)
+void Mesh::deleteVertexArrays()
 {
-    m_VertexList.erase(
-        std::remove_if(
-            m_VertexList.begin(),
-            m_VertexList.end(),
-            [vertex](Vertex* v){ return v == vertex;}),
-        m_VertexList.end());
-
-    // refaire les VBOs
-    m_UpdateVBOs = true;
+    for (const VertexArray& vertexarray: m_VertexArrays) {
+        glDeleteVertexArrays(1, &vertexarray.id);
+    }
+    m_VertexArrays.clear();
 }
 
 
 /**
- * Cette méthode ajoute le triangle fourni à la fin de la liste
- * @param triangle à rajouter
+ * prépare un VBO pour recevoir count éléments : il est créé s'il n'existe pas et réalloué si sa
+ * capacité est dépassée, et il reste lié à target. Après une (ré)allocation, tout est à envoyer.
+ * La première allocation est à la taille exacte, les suivantes prennent de la marge car le maillage
+ * est en cours de modification.
+ * @param target : GL_ARRAY_BUFFER ou GL_ELEMENT_ARRAY_BUFFER
+ * @param id : identifiant du VBO, -1 s'il n'existe pas encore
+ * @param capacity : nombre d'éléments que peut contenir le VBO, 0 pour forcer la réallocation
+ * @param elementsize : taille d'un élément en octets
+ * @param count : nombre d'éléments à y placer
+ * @param dirty : plage d'éléments à envoyer, elle est étendue à tout le VBO s'il est réalloué
  */
-void Mesh::pushTriangle(Triangle* triangle)
+static void reserveBuffer(GLenum target, GLint& id, size_t& capacity, size_t elementsize, size_t count, Mesh::DirtyRange& dirty)
 {
-    m_TriangleList.push_back(triangle);
+    // rien à envoyer : le VBO n'est pas lié, pour ne pas défaire les liaisons du dessin en cours
+    dirty.end = std::min(dirty.end, count);
+    if (id >= 0 && count <= capacity && dirty.empty()) {
+        dirty.clear();
+        return;
+    }
 
-    // refaire les VBOs
-    m_UpdateVBOs = true;
+    if (id < 0) {
+        GLuint newid;
+        glGenBuffers(1, &newid);
+        id = newid;
+        capacity = 0;
+    }
+    glBindBuffer(target, id);
+    if (count > capacity) {
+        GLenum usage = (capacity == 0) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+        capacity = (capacity == 0) ? count : std::max(count, capacity + capacity/2);
+        glBufferData(target, capacity * elementsize, nullptr, usage);
+        dirty.begin = 0;
+        dirty.end = count;
+    }
+    dirty.end = std::min(dirty.end, count);
 }
 
 
 /**
- * Cette méthode enlève le triangle fourni de la liste
- * NB: la méthode ne le supprime pas (voir son destructeur pour cela)
- * @see #delTriangle
- * @param triangle à enlever
+ * envoie la plage [dirty.begin, dirty.end[ des éléments dans le VBO lié à target, puis vide la plage
+ * @param target : GL_ARRAY_BUFFER ou GL_ELEMENT_ARRAY_BUFFER
+ * @param elementsize : taille d'un élément en octets
+ * @param data : données du premier élément de la plage
+ * @param dirty : plage des éléments à envoyer
  */
-void Mesh::popTriangle(Triangle* triangle)
+static void uploadRange(GLenum target, size_t elementsize, const GLvoid* data, Mesh::DirtyRange& dirty)
 {
-    m_TriangleList.erase(
-        std::remove_if(
-            m_TriangleList.begin(),
-            m_TriangleList.end(),
-            [triangle](Triangle* t){ return t == triangle;}),
-        m_TriangleList.end());
-
-    // refaire les VBOs
-    m_UpdateVBOs = true;
+    if (dirty.empty()) {
+        dirty.clear();
+        return;
+    }
+    glBufferSubData(target, dirty.begin * elementsize, (dirty.end - dirty.begin) * elementsize, data);
+    dirty.clear();
+    glBindBuffer(target, 0);
 }
 
 
 /**
- * Cette méthode crée et rajoute un triangle au maillage.
- * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
- * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
- * @param v1 : le premier coin du triangle
- * @param v2 : le deuxième coin du triangle
- * @param v3 : le troisième coin du triangle
- * @return le nouveau triangle, ajouté au maillage
+ * choisit la disposition des attributs dans les VBOs : un seul VBO entrelacé (par défaut)
+ * ou un VBO par attribut
+ * @param interleaved : true pour le VBO entrelacé
  */
-Triangle* Mesh::addTriangle(Vertex* v1, Vertex* v2, Vertex* v3)
+void Mesh::setInterleaved(bool interleaved)
 {
-    return new Triangle(this, v1, v2, v3);
+    if (interleaved == m_Interleaved) return;
+    m_Interleaved = interleaved;
+
+    // refaire les VBOs
+    deleteBuffers();
 }
 
 
 /**
- * Cette méthode crée et rajoute un quadrilatère au maillage. En fait, cela
- * revient à créer deux triangles, (v1, v2, s4) et (s4, v2, v3).
- * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
- * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
- * NB : les triangles sont définis dans l'ordre qui facilite la création de rubans
- * @param v1 : l'un des coins du quad
- * @param v2 : l'un des coins du quad
- * @param v3 : l'un des coins du quad
- * @param s4 : l'un des coins du quad
+ * choisit des attributs quantifiés dans le VBO entrelacé (voir VertexFormat::quantizedSize) :
+ * un sommet de coordonnées, coordonnées de texture et normale passe de 32 à 16 octets. Les shaders
+ * des matériaux doivent alors employer les fonctions de Material::getDequantizationFunctions.
+ * NB: sans effet sur les VBOs séparés, voir setInterleaved
+ * @param quantized : true pour quantifier les attributs
  */
-void Mesh::addQuad(Vertex* v1, Vertex* v2, Vertex* v3, Vertex* s4)
+void Mesh::setQuantized(bool quantized)
 {
-    addTriangle(v1, v2, s4);
-    addTriangle(s4, v2, v3);
+    if (quantized == m_Quantized) return;
+    m_Quantized = quantized;
+
+    // la boîte de quantification sera recalculée, refaire les VBOs
+    vec3::zero(m_QuantizationOffset);
+    vec3::zero(m_QuantizationScale);
+    deleteBuffers();
 }
 
 
 /**
- * Cette méthode supprime le triangle du maillage en mettant à jour toutes
- * les listes
- * @param triangle : celui qu'il faut supprimer
+ * convertit un flottant en demi-flottant IEEE 754 (binary16), arrondi au plus proche
+ * @param value : nombre à convertir
+ * @return bits du demi-flottant
  */
-void Mesh::delTriangle(Triangle* triangle)
+static uint16_t floatToHalf(float value)
 {
-    delete triangle;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const int exponent = ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // infini et NaN, trop grand, trop petit même pour un dénormalisé
+    if (((bits >> 23) & 0xFF) == 0xFF) return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31) return sign | 0x7C00;
+    if (exponent <= -11) return sign;
+
+    // dénormalisé : le 1 implicite devient explicite
+    if (exponent <= 0) {
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint16_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1) half++;
+        return sign | half;
+    }
+
+    // normalisé, l'arrondi peut propager une retenue dans l'exposant, ce qui reste correct
+    uint16_t half = (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) half++;
+    return sign | half;
 }
 
 
 /**
- * Cette méthode supprime le sommet du maillage en mettant à jour toutes
- * les listes : tous les triangles qui le contiennent sont aussi supprimés.
- * @param vertex : celui qu'il faut supprimer
+ * convertit un nombre entre -1 et 1 en entier 16 bits signé normalisé
  */
-void Mesh::delVertex(Vertex* vertex)
+static int16_t toSnorm16(float value)
 {
-    delete vertex;
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return (int16_t) roundf(value * 32767.0f);
 }
 
 
 /**
- * Cette méthode recalcule les normales des triangles et sommets.
- * Les normales des triangles sont calculées d'après leurs côtés.
- * Les normales des sommets sont les moyennes des normales des triangles
- * auxquels ils appartiennent.
+ * code une direction sur deux nombres entre -1 et 1 : projection sur l'octaèdre |x|+|y|+|z| = 1,
+ * dont la moitié z < 0 est repliée sur les coins du carré
+ * @param direction : vecteur à coder, pas forcément normé
+ * @param result : reçoit les deux entiers 16 bits signés normalisés
  */
-void Mesh::computeNormals()
+static void octahedralEncode(const GLfloat* direction, int16_t* result)
 {
-    // calculer les normales des triangles
-    for (Triangle* triangle: m_TriangleList) {
-        triangle->computeNormal();
+    float x = direction[0], y = direction[1], z = direction[2];
+    const float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+    if (l1 <= 0.0f) {
+        result[0] = result[1] = 0;
+        return;
     }
-
-    // calculer les normales des sommets
-    int iv = 0;
-    for (Vertex* vertex: m_VertexList) {
-        // renuméroter le sommet (numéro dans les VBOs)
-        vertex->setIndex(iv);
-        iv++;
-        // recalculer la normale de ce sommet
-        vertex->computeNormal();
+    x /= l1;
+    y /= l1;
+    if (z < 0.0f) {
+        const float folded = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded;
     }
+    result[0] = toSnorm16(x);
+    result[1] = toSnorm16(y);
 }
 
 
 /**
- * Cette méthode recalcule les tangentes des triangles et sommets.
- * Les tangentes des triangles sont calculées d'après leurs côtés et les coordonnées de texture.
- * Les tangentes des sommets sont les moyennes des tangentes des triangles
- * auxquels ils appartiennent.
+ * écrit un attribut quantifié d'un sommet, voir VertexFormat::quantizedSize
+ * @param destination : emplacement de l'attribut dans le sommet
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @param source : composantes GLfloat de l'attribut
+ * @param offset : coin minimal de la boîte de quantification des coordonnées
+ * @param scale : taille de la boîte de quantification des coordonnées
  */
-void Mesh::computeTangents()
+static void quantizeAttribute(uint8_t* destination, int attribute, const GLfloat* source, const GLfloat* offset, const GLfloat* scale)
 {
-    // calculer les tangentes des triangles
-    for (Triangle* triangle: m_TriangleList) {
-        triangle->computeTangent();
+    switch (attribute) {
+    case VertexFormat::COORDS: {
+        uint16_t* coords = (uint16_t*) destination;
+        for (int c=0; c<3; c++) {
+            const float t = (scale[c] > 0.0f) ? (source[c] - offset[c]) / scale[c] : 0.0f;
+            coords[c] = (uint16_t) roundf(std::max(0.0f, std::min(1.0f, t)) * 65535.0f);
+        }
+        coords[3] = 0;
+        break;
     }
-
-    // calculer les tangentes des sommets
-    for (Vertex* vertex: m_VertexList) {
-        // recalculer la tangente de ce sommet
-        vertex->computeTangent();
+    case VertexFormat::COLOR:
+        for (int c=0; c<3; c++) destination[c] = (uint8_t) roundf(std::max(0.0f, std::min(1.0f, source[c])) * 255.0f);
+        destination[3] = 255;
+        break;
+    case VertexFormat::TEXCOORDS: {
+        uint16_t* texcoords = (uint16_t*) destination;
+        texcoords[0] = floatToHalf(source[0]);
+        texcoords[1] = floatToHalf(source[1]);
+        break;
+    }
+    default:
+        octahedralEncode(source, (int16_t*) destination);
+        break;
     }
 }
 
 
-static Vertex* findOrCreateVertex(
-    Mesh* mesh,
-    char* nvntnn,
-    std::map<int, std::list<Vertex*>> &vertexlist,
-    std::vector<vec3> &coordlist,
-    std::vector<vec2> &texcoordlist,
-    std::vector<vec3> &normallist)
+/**
+ * retourne le tableau de l'attribut indiqué, sous forme de GLfloat consécutifs
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @return tableau de VertexFormat::components(attribute) GLfloat par sommet, nullptr s'il n'y a aucun sommet
+ */
+GLfloat* Mesh::getAttributeData(int attribute)
 {
-    // indices des coordonnées 3D, des coordonnées de texture et de la normale
-    int nv = 0;
-    int nt = 0;
-    int nn = 0;
-    sscanf(nvntnn, "%d", &nv);
-    sscanf(nvntnn, "%d//%d", &nv, &nn);
-    sscanf(nvntnn, "%d/%d", &nv, &nt);
-    sscanf(nvntnn, "%d/%d/%d", &nv, &nt, &nn);
-    if (nv == 0) return nullptr;
-    if (nv < 0) nv = coordlist.size() + nv; else nv = nv - 1;
-    if (nt < 0) nt = texcoordlist.size() + nt; else nt = nt - 1;
-    if (nt >= texcoordlist.size()) nt = -1;
-    if (nn < 0) nn = normallist.size() + nn; else nn = nn - 1;
-    if (nn >= normallist.size()) nn = -1;
-
-    // identifiant du sommet courant
-    int index = (nv*1000000 + nt)*1000000 + nn;
-
-    // parcourir les sommets de la liste nv et voir s'il y a le même
-    std::list<Vertex*>& siblings = vertexlist[nv];
-    for (Vertex* other: siblings) {
-        // si les noms sont égaux, c'est le même sommet
-        if (index == other->getIndex()) return other;
+    compact();
+    if (m_Coords.empty()) return nullptr;
+    switch (attribute) {
+    case VertexFormat::COORDS:    return &m_Coords[0][0];
+    case VertexFormat::COLOR:     return &m_Colors[0][0];
+    case VertexFormat::TEXCOORDS: return &m_TexCoords[0][0];
+    case VertexFormat::NORMAL:    return &m_Normals[0][0];
+    case VertexFormat::TANGENT:   return &m_Tangents[0][0];
+    default:                      return nullptr;
     }
-
-    // il faut créer un nouveau sommet car soit nouveau, soit un peu différent des autres
-    Vertex* vertex = new Vertex(mesh, coordlist[nv]);
-    vertex->setIndex(index);
-    if (nt >= 0) vertex->setTexCoords(texcoordlist[nt]);
-    if (nn >= 0) vertex->setNormal(normallist[nn]);
-
-    // on ajoute ce sommet dans la liste de ceux qui ont le même numéro nv
-    siblings.push_front(vertex);
-    return vertex;
 }
 
 
 /**
- * Cette méthode lit le fichier indiqué, il contient un maillage au format OBJ
- * @param filename : nom complet du fichier à lire
+ * Cette méthode retourne l'identifiant du VBO entrelacé contenant au moins les attributs demandés.
+ * Elle construit ce VBO s'il n'est pas encore créé ou s'il lui manque des attributs, sinon elle
+ * y envoie seulement les sommets modifiés. Seuls les attributs demandés par les matériaux du
+ * maillage sont envoyés, voir getInterleavedFormat.
+ * @param mask : attributs nécessaires, combinaison des VertexFormat::Mask, les coordonnées sont toujours présentes
+ * @return identifiant OpenGL du VBO entrelacé
  */
-void Mesh::loadObj(std::string filename)
+GLint Mesh::getInterleavedBufferId(unsigned mask)
 {
-    // tableaux des sommets qu'on va extraire du fichier obj, ils sont groupés par indice nv
-    std::map<int, std::list<Vertex*>> vertexlist;
+    // les VBOs ne contiennent pas les éléments supprimés
+    compact();
+    mask |= VertexFormat::COORDS_BIT;
+
+    // s'il manque des attributs, il faut tout refaire ; on garde ceux déjà présents, ils servent à un autre matériau
+    if ((mask & ~m_InterleavedFormat) != 0) {
+        mask |= m_InterleavedFormat;
+        m_InterleavedFormat = mask;
+        m_InterleavedCapacity = 0;
+
+        // les décalages des attributs changent, les VAOs sont à redécrire
+        deleteVertexArrays();
+    }
+    const unsigned format = m_InterleavedFormat;
 
-    // tableau des coordonnées, des textures et des normales
-    std::vector<vec3> coordlist;
-    std::vector<vec2> texcoordlist;
-    std::vector<vec3> normallist;
+    // plage des sommets dont au moins un attribut du VBO a changé
+    DirtyRange dirty;
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        if (format & (1u << attribute)) dirty.add(m_DirtyAttributes[attribute]);
+    }
 
-    // ouverture du fichier
-    std::ifstream inputStream;
-    inputStream.open(filename.c_str(), std::ifstream::in);
-    if (! inputStream.is_open()) {
-        std::cerr << "Error : \"" << filename << "\" cannot be loaded, check pathname and permissions." << std::endl;
-        return;
+    // attributs quantifiés : si des sommets sortent de la boîte de quantification, elle est
+    // recalculée et tous les sommets sont à renvoyer
+    if (m_Quantized) {
+        const vec3& boundsmin = getBoundsMin();
+        const vec3& boundsmax = getBoundsMax();
+        vec3 offset = m_QuantizationOffset;
+        vec3 scale = m_QuantizationScale;
+        vec3 lower = boundsmin;
+        vec3 upper = boundsmax;
+        bool inside = true;
+        for (int c=0; c<3; c++) {
+            if (lower[c] < offset[c] || upper[c] > offset[c] + scale[c]) inside = false;
+        }
+        if (! inside) {
+            vec3::copy(m_QuantizationOffset, boundsmin);
+            vec3::subtract(m_QuantizationScale, boundsmax, boundsmin);
+            dirty.add(0, m_Coords.size());
+        }
+        return uploadQuantized(format, dirty);
     }
 
-    // parcourir le fichier obj ligne par ligne
-    char* word = NULL;
-    char* saveptr_mot = NULL;
-    int line_number = 0;
-    char line[180];
-    while (inputStream.getline(line, sizeof(line))) {
-        line_number++;
-        // extraire le premier mot de la ligne
-        word = strtok_r(line," \t", &saveptr_mot);
-        if (word == NULL) continue;
-        // mettre le mot en minuscules
-        for (char* c=word; *c!='\0'; ++c) *c = tolower(*c);
-
-        if (strcmp(word,"f") == 0) {
-            // lire les numéros du premier point
-            if (! (word = strtok_r(NULL, " \t", &saveptr_mot))) continue;
-            Vertex* v1 = findOrCreateVertex(this, word, vertexlist, coordlist, texcoordlist, normallist);
-            // lire les numéros du deuxième point
-            if (! (word = strtok_r(NULL, " \t", &saveptr_mot))) continue;
-            Vertex* v2 = findOrCreateVertex(this, word, vertexlist, coordlist, texcoordlist, normallist);
-            // lire et traiter les points suivants
-            while ((word = strtok_r(NULL, " \t", &saveptr_mot))) {
-                Vertex* v3 = findOrCreateVertex(this, word, vertexlist, coordlist, texcoordlist, normallist);
-                // ajouter un triangle v1,v2,v3
-                if (v1 != nullptr && v2 != nullptr && v3 != nullptr) {
-                    addTriangle(v1,v2,v3);
-                }
-                // préparer le passage au triangle suivant
-                v2 = v3;
-            }
-        } else
-        if (strcmp(word,"v") == 0) {
-            // coordonnées du sommet
-            float x = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            float y = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            float z = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            vec3 coords = vec3::fromValues(x,y,z);
-            coordlist.push_back(coords);
-        } else
-        if (strcmp(word,"vt") == 0) {
-            // coordonnées de texture
-            float u = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            float v = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            texcoordlist.push_back(vec2::fromValues(u,v));
-        } else
-        if (strcmp(word,"vn") == 0) {
-            // coordonnées de la normale
-            float nx = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            float ny = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            float nz = atof(strtok_r(NULL, " \t", &saveptr_mot));
-            normallist.push_back(vec3::fromValues(nx,ny,nz));
+    // créer, agrandir ou mettre à jour le VBO
+    const int stride = VertexFormat::stride(format);
+    const size_t elementsize = stride * sizeof(GLfloat);
+    reserveBuffer(GL_ARRAY_BUFFER, m_InterleavedBufferId, m_InterleavedCapacity, elementsize, m_Coords.size(), dirty);
+
+    // recopier chaque attribut à sa place dans les sommets de la plage, qui est vide s'il n'y a aucun sommet
+    const size_t count = dirty.empty() ? 0 : dirty.end - dirty.begin;
+    std::vector<GLfloat> array(count * stride);
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        if ((format & (1u << attribute)) == 0) continue;
+        m_DirtyAttributes[attribute].clear();
+        if (count == 0) continue;
+        const int components = VertexFormat::components(attribute);
+        const GLfloat* source = getAttributeData(attribute) + dirty.begin * components;
+        GLfloat* destination = array.data() + VertexFormat::offset(format, attribute);
+        for (size_t i=dirty.begin; i<dirty.end; i++) {
+            for (int c=0; c<components; c++) destination[c] = source[c];
+            source += components;
+            destination += stride;
         }
     }
+    uploadRange(GL_ARRAY_BUFFER, elementsize, array.data(), dirty);
 
-    // message
-    std::cout<<m_Name<<" : obj loaded,"<<m_VertexList.size()<<" vertices,"<<m_TriangleList.size()<<" triangles"<<std::endl;
+    // retourner l'identifiant du VBO
+    return m_InterleavedBufferId;
 }
 
 
 /**
- * Cette méthode retourne l'identifiant du VBO contenant les coordonnées 3D des sommets.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
- * Cette méthode met aussi à jour tous les indices m_Index des sommets
- * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des coordonnées
+ * met à jour le VBO entrelacé quantifié : les sommets de la plage sont quantifiés puis envoyés
+ * @param format : attributs présents dans le VBO
+ * @param dirty : plage des sommets à envoyer
+ * @return identifiant OpenGL du VBO entrelacé
  */
-GLint Mesh::getVertexBufferId()
+GLint Mesh::uploadQuantized(unsigned format, DirtyRange& dirty)
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_VertexBufferId >= 0) {
-        Utils::deleteVBO(m_VertexBufferId);
-        m_VertexBufferId = -1;
+    const int stride = VertexFormat::quantizedStride(format);
+    reserveBuffer(GL_ARRAY_BUFFER, m_InterleavedBufferId, m_InterleavedCapacity, stride, m_Coords.size(), dirty);
+
+    // boîte de quantification des coordonnées
+    vec3 box[2] = { m_QuantizationOffset, m_QuantizationScale };
+    const GLfloat offset[3] = { box[0][0], box[0][1], box[0][2] };
+    const GLfloat scale[3]  = { box[1][0], box[1][1], box[1][2] };
+
+    // quantifier chaque attribut à sa place dans les sommets de la plage, qui est vide s'il n'y a aucun sommet
+    const size_t count = dirty.empty() ? 0 : dirty.end - dirty.begin;
+    std::vector<uint8_t> array(count * stride);
+    for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+        if ((format & (1u << attribute)) == 0) continue;
+        m_DirtyAttributes[attribute].clear();
+        if (count == 0) continue;
+        const int components = VertexFormat::components(attribute);
+        const GLfloat* source = getAttributeData(attribute) + dirty.begin * components;
+        uint8_t* destination = array.data() + VertexFormat::quantizedOffset(format, attribute);
+        for (size_t i=dirty.begin; i<dirty.end; i++) {
+            quantizeAttribute(destination, attribute, source, offset, scale);
+            source += components;
+            destination += stride;
+        }
     }
+    uploadRange(GL_ARRAY_BUFFER, stride, array.data(), dirty);
+
+    // retourner l'identifiant du VBO
+    return m_InterleavedBufferId;
+}
 
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_VertexBufferId < 0) {
 
-        std::vector<float> array;
-        int num = 0;
-        for (Vertex* v: m_VertexList) {
-            v->setIndex(num);
-            num++;
-            vec3& data = v->getCoords();
-            array.push_back(data[0]); array.push_back(data[1]); array.push_back(data[2]);
-        }
-        m_VertexBufferId = Utils::makeFloatVBO(array, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    }
+/**
+ * Cette méthode retourne l'identifiant du VBO contenant l'attribut indiqué, seul.
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
+ * @param attribute : l'un des VertexFormat::Attribute
+ * @return identifiant OpenGL du VBO
+ */
+GLint Mesh::getAttributeBufferId(int attribute)
+{
+    compact();
+    const size_t elementsize = VertexFormat::components(attribute) * sizeof(GLfloat);
+    DirtyRange& dirty = m_DirtyAttributes[attribute];
+    reserveBuffer(GL_ARRAY_BUFFER, m_AttributeBufferId[attribute], m_AttributeCapacity[attribute], elementsize, m_Coords.size(), dirty);
+
+    // les sommets sont déjà rangés dans un tableau contigu
+    const GLfloat* data = dirty.empty() ? nullptr : getAttributeData(attribute) + dirty.begin * VertexFormat::components(attribute);
+    uploadRange(GL_ARRAY_BUFFER, elementsize, data, dirty);
 
     // retourner l'identifiant du VBO
-    return m_VertexBufferId;
+    return m_AttributeBufferId[attribute];
+}
+
+
+/**
+ * Cette méthode retourne l'identifiant du VBO contenant les coordonnées 3D des sommets.
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
+ * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des coordonnées
+ */
+GLint Mesh::getVertexBufferId()
+{
+    return getAttributeBufferId(VertexFormat::COORDS);
 }
 
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les couleurs des sommets.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des couleurs
  */
 GLint Mesh::getColorBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_ColorBufferId >= 0) {
-        Utils::deleteVBO(m_ColorBufferId);
-        m_ColorBufferId = -1;
-    }
-
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_ColorBufferId < 0) {
-
-        std::vector<float> array;
-        for (Vertex* v: m_VertexList) {
-            vec3& data = v->getColor();
-            array.push_back(data[0]); array.push_back(data[1]); array.push_back(data[2]);
-        }
-        m_ColorBufferId = Utils::makeFloatVBO(array, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    }
-
-    // retourner l'identifiant du VBO
-    return m_ColorBufferId;
+    return getAttributeBufferId(VertexFormat::COLOR);
 }
 
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les coordonnées de texture des sommets.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des coordonnées de texture 2D
  */
 GLint Mesh::getTexCoordsBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_TexCoordsBufferId >= 0) {
-        Utils::deleteVBO(m_TexCoordsBufferId);
-        m_TexCoordsBufferId = -1;
-    }
-
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_TexCoordsBufferId < 0) {
-
-        std::vector<float> array;
-        for (Vertex* v: m_VertexList) {
-            vec2& data = v->getTexCoords();
-            array.push_back(data[0]); array.push_back(data[1]);
-        }
-        m_TexCoordsBufferId = Utils::makeFloatVBO(array, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    }
-
-    // retourner l'identifiant du VBO
-    return m_TexCoordsBufferId;
+    return getAttributeBufferId(VertexFormat::TEXCOORDS);
 }
 
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les normales des sommets.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des normales
  */
 GLint Mesh::getNormalBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_NormalBufferId >= 0) {
-        Utils::deleteVBO(m_NormalBufferId);
-        m_NormalBufferId = -1;
-    }
-
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_NormalBufferId < 0) {
-
-        std::vector<float> array;
-        for (Vertex* v: m_VertexList) {
-            vec3& data = v->getNormal();
-            array.push_back(data[0]); array.push_back(data[1]); array.push_back(data[2]);
-        }
-        m_NormalBufferId = Utils::makeFloatVBO(array, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    }
-
-    // retourner l'identifiant du VBO
-    return m_NormalBufferId;
+    return getAttributeBufferId(VertexFormat::NORMAL);
 }
 
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les tangentes des sommets.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des tangentes
  */
 GLint Mesh::getTangentBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_TangentBufferId >= 0) {
-        Utils::deleteVBO(m_TangentBufferId);
-        m_TangentBufferId = -1;
-    }
-
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_TangentBufferId < 0) {
-
-        std::vector<float> array;
-        for (Vertex* v: m_VertexList) {
-            vec3& data = v->getTangent();
-            array.push_back(data[0]); array.push_back(data[1]); array.push_back(data[2]);
-        }
-        m_TangentBufferId = Utils::makeFloatVBO(array, GL_ARRAY_BUFFER, GL_STATIC_DRAW);
-    }
-
-    // retourner l'identifiant du VBO
-    return m_TangentBufferId;
+    return getAttributeBufferId(VertexFormat::TANGENT);
 }
 
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les indices pour dessiner les triangles en primitives indexées.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
- * Il faut avoir appelé getVertexBufferId auparavant pour que les indices soient corrects et cohérents
+ * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les triangles modifiés
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des indices de triangles
  */
 GLint Mesh::getFacesIndexBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_FacesIndexBufferId >= 0) {
-        Utils::deleteVBO(m_FacesIndexBufferId);
-        m_FacesIndexBufferId = -1;
-    }
+    compact();
 
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_FacesIndexBufferId < 0) {
+    // selon le nombre de sommets : entiers 32 bits ou shorts 16 bits, il faut tout refaire si ça change
+    GLint type = (m_Coords.size() > 65535) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    if (type != m_FacesIndexBufferType) {
+        m_FacesIndexBufferType = type;
+        m_FacesCapacity = 0;
+    }
 
-        // selon le nombre d'indices : entiers 32 bits ou shorts 16 bits
-        if (m_TriangleList.size() > 65532/3) {
-            // créer le VBO des indices int pour dessiner les triangles
-            std::vector<GLuint> indexlist;
-            for (Triangle* t: m_TriangleList) {
-                indexlist.push_back(t->getVertex(0)->getIndex());
-                indexlist.push_back(t->getVertex(1)->getIndex());
-                indexlist.push_back(t->getVertex(2)->getIndex());
-            }
-            m_FacesIndexBufferId = Utils::makeIntVBO(indexlist, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-            m_FacesIndexBufferType = GL_UNSIGNED_INT;
-        } else {
-            // créer le VBO des indices short pour dessiner les triangles
-            std::vector<GLushort> indexlist;
-            for (Triangle* t: m_TriangleList) {
-                indexlist.push_back(t->getVertex(0)->getIndex());
-                indexlist.push_back(t->getVertex(1)->getIndex());
-                indexlist.push_back(t->getVertex(2)->getIndex());
-            }
-            m_FacesIndexBufferId = Utils::makeShortVBO(indexlist, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-            m_FacesIndexBufferType = GL_UNSIGNED_SHORT;
-        }
+    // un élément = les 3 indices d'un triangle
+    DirtyRange& dirty = m_DirtyFaces;
+    if (type == GL_UNSIGNED_INT) {
+        // le tableau des indices est envoyé tel quel
+        reserveBuffer(GL_ELEMENT_ARRAY_BUFFER, m_FacesIndexBufferId, m_FacesCapacity, 3*sizeof(GLuint), getTriangleCount(), dirty);
+        uploadRange(GL_ELEMENT_ARRAY_BUFFER, 3*sizeof(GLuint), m_Indices.data() + dirty.begin*3, dirty);
+    } else {
+        // conversion en shorts de la plage modifiée
+        reserveBuffer(GL_ELEMENT_ARRAY_BUFFER, m_FacesIndexBufferId, m_FacesCapacity, 3*sizeof(GLushort), getTriangleCount(), dirty);
+        std::vector<GLushort> indexlist(m_Indices.begin() + dirty.begin*3, m_Indices.begin() + dirty.end*3);
+        uploadRange(GL_ELEMENT_ARRAY_BUFFER, 3*sizeof(GLushort), indexlist.data(), dirty);
     }
 
     // retourner l'identifiant du VBO
@@ -550,71 +1935,179 @@ GLint Mesh::getFacesIndexBufferId()
 
 /**
  * Cette méthode retourne l'identifiant du VBO contenant les indices pour dessiner les arêtes en primitives indexées.
- * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
- * Il faut avoir appelé getVertexBufferId auparavant pour que les indices soient corrects et cohérents
+ * Chaque arête n'y figure qu'une fois, même si elle est partagée par deux triangles (voir HalfEdgeMesh),
+ * il est donc entièrement reconstruit quand des triangles ont été modifiés.
  * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des indices de lignes
  */
 GLint Mesh::getEdgesIndexBufferId()
 {
-    // faut-il refaire le VBO ?
-    if (m_UpdateVBOs && m_EdgesIndexBufferId >= 0) {
-        Utils::deleteVBO(m_EdgesIndexBufferId);
-        m_EdgesIndexBufferId = -1;
+    compact();
+
+    // selon le nombre de sommets : entiers 32 bits ou shorts 16 bits, il faut tout refaire si ça change
+    GLint type = (m_Coords.size() > 65535) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    if (type != m_EdgesIndexBufferType) {
+        m_EdgesIndexBufferType = type;
+        m_EdgesCapacity = 0;
+        m_EdgesChanged = true;
     }
+    if (m_EdgesIndexBufferId >= 0 && ! m_EdgesChanged) return m_EdgesIndexBufferId;
+
+    // arêtes uniques, un élément = les 2 indices d'une arête
+    std::vector<GLuint> indexlist;
+    HalfEdgeMesh(m_Indices, m_Coords.size()).getUniqueEdges(indexlist);
+    m_EdgesCount = indexlist.size() / 2;
+    DirtyRange dirty;
+    dirty.add(0, m_EdgesCount);
+    const size_t indexsize = (type == GL_UNSIGNED_INT) ? sizeof(GLuint) : sizeof(GLushort);
+    reserveBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EdgesIndexBufferId, m_EdgesCapacity, 2*indexsize, m_EdgesCount, dirty);
+    if (type == GL_UNSIGNED_INT) {
+        uploadRange(GL_ELEMENT_ARRAY_BUFFER, 2*indexsize, indexlist.data(), dirty);
+    } else {
+        std::vector<GLushort> shortlist(indexlist.begin(), indexlist.end());
+        uploadRange(GL_ELEMENT_ARRAY_BUFFER, 2*indexsize, shortlist.data(), dirty);
+    }
+    m_EdgesChanged = false;
 
-    // créer le VBO s'il n'a pas été déjà créé
-    if (m_EdgesIndexBufferId < 0) {
-
-        // selon le nombre d'indices : entiers 32 bits ou shorts 16 bits
-        if (m_TriangleList.size() > 65532/6) {
-            // VBO des indices des arêtes
-            std::vector<GLuint> indexlist;
-            for (Triangle* t: m_TriangleList) {
-                indexlist.push_back(t->getVertex(0)->getIndex());
-                indexlist.push_back(t->getVertex(1)->getIndex());
+    // retourner l'identifiant du VBO
+    return m_EdgesIndexBufferId;
+}
 
-                indexlist.push_back(t->getVertex(1)->getIndex());
-                indexlist.push_back(t->getVertex(2)->getIndex());
 
-                indexlist.push_back(t->getVertex(2)->getIndex());
-                indexlist.push_back(t->getVertex(0)->getIndex());
-            }
-            m_EdgesIndexBufferId = Utils::makeIntVBO(indexlist, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-            m_EdgesIndexBufferType = GL_UNSIGNED_INT;
+/**
+ * Cette méthode retourne l'identifiant du VBO contenant les indices des triangles de tous les
+ * niveaux de détail simplifiés, à la suite, voir LodLevel. Elle le construit s'il n'est pas à jour.
+ * @return identifiant OpenGL du VBO, -1 s'il n'y a pas de niveaux de détail
+ */
+GLint Mesh::getLodIndexBufferId()
+{
+    if (m_Lods.empty()) return -1;
+
+    // les niveaux ne sont pas modifiés par parties : tout le VBO est renvoyé s'ils ont changé
+    if (m_LodsChanged) {
+        Utils::deleteVBO(m_LodIndexBufferId);
+        if (m_Coords.size() > 65535) {
+            m_LodIndexBufferType = GL_UNSIGNED_INT;
+            m_LodIndexBufferId = Utils::makeIntVBO(m_LodIndices.data(), m_LodIndices.size(), GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
         } else {
-            // VBO des indices des arêtes
-            std::vector<GLushort> indexlist;
-            for (Triangle* t: m_TriangleList) {
-                indexlist.push_back(t->getVertex(0)->getIndex());
-                indexlist.push_back(t->getVertex(1)->getIndex());
+            m_LodIndexBufferType = GL_UNSIGNED_SHORT;
+            std::vector<GLushort> indexlist(m_LodIndices.begin(), m_LodIndices.end());
+            m_LodIndexBufferId = Utils::makeShortVBO(indexlist, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+        }
+        m_LodsChanged = false;
+    }
+    return m_LodIndexBufferId;
+}
 
-                indexlist.push_back(t->getVertex(1)->getIndex());
-                indexlist.push_back(t->getVertex(2)->getIndex());
 
-                indexlist.push_back(t->getVertex(2)->getIndex());
-                indexlist.push_back(t->getVertex(0)->getIndex());
-            }
-            m_EdgesIndexBufferId = Utils::makeShortVBO(indexlist, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
-            m_EdgesIndexBufferType = GL_UNSIGNED_SHORT;
+/**
+ * construit dès maintenant les VBOs dont les matériaux auront besoin, au lieu d'attendre le
+ * premier dessin, ex: pour qu'un maillage chargé en arrière-plan soit prêt quand il apparaît
+ */
+void Mesh::prepareBuffers()
+{
+    // attributs employés par les shaders
+    unsigned mask = 0;
+    if (m_FacesMaterial != nullptr) mask |= m_FacesMaterial->getAttributeMask();
+    if (m_EdgesMaterial != nullptr) mask |= m_EdgesMaterial->getAttributeMask();
+
+    // VBOs des sommets
+    if (m_Interleaved) {
+        getInterleavedBufferId(mask);
+    } else {
+        for (int attribute=0; attribute<VertexFormat::ATTRIBUTE_COUNT; attribute++) {
+            if (mask & (1u << attribute)) getAttributeBufferId(attribute);
         }
     }
 
-    // retourner l'identifiant du VBO
-    return m_EdgesIndexBufferId;
+    // VBOs des indices
+    if (m_FacesMaterial != nullptr) {
+        getFacesIndexBufferId();
+        getLodIndexBufferId();
+    }
+    if (m_EdgesMaterial != nullptr) getEdgesIndexBufferId();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+/**
+ * dessine les triangles d'un niveau de détail avec le matériau déjà activé
+ * @param level : niveau de détail, voir selectLod
+ * @param instances : nombre d'exemplaires, 0 pour un dessin simple
+ * @param boundindices : VBO d'indices déjà lié, il n'est pas relié s'il n'a pas changé ; reçoit celui de ce dessin
+ */
+void Mesh::drawFaces(int level, GLsizei instances, GLint& boundindices)
+{
+    GLint indexbufferid;
+    GLsizei count;
+    GLenum type;
+    const GLvoid* offset;
+    if (level > 0 && level < getLodCount()) {
+        // triangles du niveau de détail, à leur place dans le VBO des niveaux
+        const LodLevel& lod = m_Lods[level-1];
+        indexbufferid = getLodIndexBufferId();
+        size_t indexsize = (m_LodIndexBufferType == GL_UNSIGNED_INT) ? sizeof(GLuint) : sizeof(GLushort);
+        count = lod.count * 3;
+        type = m_LodIndexBufferType;
+        offset = (const GLvoid*) (lod.first * 3 * indexsize);
+    } else {
+        indexbufferid = getFacesIndexBufferId();
+        count = m_Indices.size();
+        type = m_FacesIndexBufferType;
+        offset = 0;
+    }
+
+    // activer et lier le buffer contenant les indices
+    if (indexbufferid != boundindices) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbufferid);
+        boundindices = indexbufferid;
+    }
+
+    // dessiner les triangles
+    if (instances > 0) {
+        glDrawElementsInstanced(GL_TRIANGLES, count, type, offset, instances);
+    } else {
+        glDrawElements(GL_TRIANGLES, count, type, offset);
+    }
+}
+
+
+/**
+ * dessine les arêtes du maillage complet avec le matériau déjà activé
+ * @param instances : nombre d'exemplaires, 0 pour un dessin simple
+ * @param boundindices : VBO d'indices déjà lié, il n'est pas relié s'il n'a pas changé ; reçoit celui de ce dessin
+ */
+void Mesh::drawEdges(GLsizei instances, GLint& boundindices)
+{
+    // activer et lier le buffer contenant les indices
+    GLint edgesindexbufferid = getEdgesIndexBufferId();
+    if (edgesindexbufferid != boundindices) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgesindexbufferid);
+        boundindices = edgesindexbufferid;
+    }
+
+    // dessiner les arêtes
+    if (instances > 0) {
+        glDrawElementsInstanced(GL_LINES, m_EdgesCount * 2, m_EdgesIndexBufferType, 0, instances);
+    } else {
+        glDrawElements(GL_LINES, m_EdgesCount * 2, m_EdgesIndexBufferType, 0);
+    }
 }
 
 
 /**
  * dessiner le maillage s'il est prêt. S'il y a un matériau pour les faces, elles sont dessinées, pareil pour les arêtes.
+ * Les arêtes sont toujours celles du maillage complet.
  * @param matP : matrice de projection perpective
  * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+ * @param level : niveau de détail des faces, voir selectLod
  */
-void Mesh::onDraw(const mat4& matP, const mat4& matVM)
+void Mesh::onDraw(const mat4& matP, const mat4& matVM, int level)
 {
     // le matériau des facettes est-il défini ?
     if (m_FacesMaterial != nullptr) {
 
-        // décalage des polygones s'il y a aussi les arêtespushVertex
+        // décalage des polygones s'il y a aussi les arêtes
         if (m_EdgesMaterial != nullptr) {
             glEnable(GL_POLYGON_OFFSET_FILL);
             glPolygonOffset(1.0, 1.0);
@@ -623,15 +2116,9 @@ void Mesh::onDraw(const mat4& matP, const mat4& matVM)
         // activer le matériau des triangles
         m_FacesMaterial->select(this, matP, matVM);
 
-        // activer et lier le buffer contenant les indices
-        int facesindexbufferid = getFacesIndexBufferId();
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facesindexbufferid);
-
-        // les VBOs sont à jour
-        m_UpdateVBOs = false;
-
         // dessiner les triangles
-        glDrawElements(GL_TRIANGLES, m_TriangleList.size() * 3, m_FacesIndexBufferType, 0);
+        GLint boundindices = -1;
+        drawFaces(level, 0, boundindices);
 
         // désactiver le matériau
         m_FacesMaterial->deselect();
@@ -651,12 +2138,9 @@ void Mesh::onDraw(const mat4& matP, const mat4& matVM)
         // activer le matériau des arêtes
         m_EdgesMaterial->select(this, matP, matVM);
 
-        // activer et lier le buffer contenant les indices
-        int edgesindexbufferid = getEdgesIndexBufferId();
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgesindexbufferid);
-
-        // dessiner les triangles
-        glDrawElements(GL_LINES, m_TriangleList.size() * 6, m_EdgesIndexBufferType, 0);
+        // dessiner les arêtes
+        GLint boundindices = -1;
+        drawEdges(0, boundindices);
 
         // désactiver le matériau
         m_EdgesMaterial->deselect();
@@ -667,14 +2151,125 @@ void Mesh::onDraw(const mat4& matP, const mat4& matVM)
 }
 
 
+/**
+ * dessine plusieurs exemplaires du maillage, un seul appel OpenGL par niveau de détail et par matériau,
+ * voir submitInstanced
+ * @param matP : matrice de projection perpective
+ * @param matV : matrice de la caméra
+ * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+ * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+ */
+void Mesh::onDrawInstanced(const mat4& matP, const mat4& matV, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts)
+{
+    RenderQueue queue;
+    submitInstanced(queue, matV, matrices, levelcounts);
+    queue.execute(matP);
+}
+
+
+/**
+ * ajoute le dessin du maillage à une file de rendu : ses faces et ses arêtes, comme onDraw
+ * @param queue : file de rendu, voir RenderQueue::execute
+ * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+ * @param level : niveau de détail des faces, voir selectLod
+ */
+void Mesh::submit(RenderQueue& queue, const mat4& matVM, int level)
+{
+    // les faces sont décalées s'il y a aussi les arêtes
+    if (m_FacesMaterial != nullptr) {
+        RenderQueue::Pass pass = (m_EdgesMaterial != nullptr) ? RenderQueue::PASS_FACES_OFFSET : RenderQueue::PASS_FACES;
+        queue.submit(pass, this, m_FacesMaterial, matVM, level);
+    }
+    if (m_EdgesMaterial != nullptr) {
+        queue.submit(RenderQueue::PASS_EDGES, this, m_EdgesMaterial, matVM);
+    }
+}
+
+
+/**
+ * ajoute à une file de rendu le dessin de plusieurs exemplaires du maillage, un seul appel OpenGL par
+ * niveau de détail et par matériau. Les matrices des exemplaires sont envoyées dès maintenant dans un VBO,
+ * celui de la file s'il y en a un (voir RenderQueue::setStreamBuffer), et lues par le shader, voir Material::getInstancingFunctions. Si un matériau ne les emploie pas, ses
+ * exemplaires sont dessinés un par un.
+ * @param queue : file de rendu, voir RenderQueue::execute
+ * @param matV : matrice de la caméra
+ * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+ * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+ */
+void Mesh::submitInstanced(RenderQueue& queue, const mat4& matV, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts)
+{
+    if (matrices.empty()) return;
+
+    // écrire les matrices dans le VBO circulaire de l'image, sinon dans celui du maillage, réalloué
+    // à chaque image pour ne pas attendre que la carte graphique ait fini la précédente
+    const size_t matrixsize = 16 * sizeof(GLfloat);
+    StreamBuffer* stream = queue.getStreamBuffer();
+    GLintptr offset = (stream != nullptr) ? stream->write(matrices.data(), matrices.size() * sizeof(GLfloat), matrixsize) : -1;
+    GLint bufferid;
+    if (offset >= 0) {
+        bufferid = stream->getBufferId();
+    } else {
+        if (m_InstanceBufferId < 0) {
+            GLuint id;
+            glGenBuffers(1, &id);
+            m_InstanceBufferId = id;
+        }
+        bufferid = m_InstanceBufferId;
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBufferId);
+        glBufferData(GL_ARRAY_BUFFER, matrices.size() * sizeof(GLfloat), matrices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        offset = 0;
+    }
+
+    // chaque matériau : les exemplaires de chaque niveau de détail en un seul appel
+    const RenderQueue::Pass facespass = (m_EdgesMaterial != nullptr) ? RenderQueue::PASS_FACES_OFFSET : RenderQueue::PASS_FACES;
+    mat4 matVM = mat4::create();
+    mat4 model = mat4::create();
+    size_t first = 0;
+    const size_t base = offset / matrixsize;
+    for (size_t level=0; level<levelcounts.size(); level++) {
+        const int count = levelcounts[level];
+        if (count <= 0) continue;
+        for (int m=0; m<2; m++) {
+            Material* material = (m == 0) ? m_FacesMaterial : m_EdgesMaterial;
+            if (material == nullptr) continue;
+            const RenderQueue::Pass pass = (m == 0) ? facespass : RenderQueue::PASS_EDGES;
+            if (material->isInstanced()) {
+                queue.submitInstances(pass, this, material, matV, bufferid, base + first, count, level);
+            } else {
+                // matériau sans exemplaires : un dessin par matrice
+                for (int i=0; i<count; i++) {
+                    for (int k=0; k<16; k++) model[k] = matrices[(first + i) * 16 + k];
+                    mat4::multiply(matVM, matV, model);
+                    queue.submit(pass, this, material, matVM, level);
+                }
+            }
+        }
+        first += count;
+    }
+}
+
+
 /**
  * modifie les coordonnées des sommets par la matrice indiquée
  * @param matT mat4 qui est appliquée sur chaque sommet
  */
 void Mesh::transform(mat4 matT)
 {
-    for (Vertex* vertex: m_VertexList) {
-        vec3::transformMat4(vertex->getCoords(), vertex->getCoords(), matT);
+    for (vec3& coords: m_Coords) {
+        vec3::transformMat4(coords, coords, matT);
+    }
+
+    // toutes les coordonnées sont à renvoyer
+    markDirty(VertexFormat::COORDS, 0, m_Coords.size());
+
+    // les erreurs des niveaux de détail changent comme les longueurs : plus grand facteur d'échelle des axes
+    float scale = 0.0f;
+    for (int axis=0; axis<3; axis++) {
+        scale = std::max(scale, vec3::length(vec3::fromValues(matT[4*axis], matT[4*axis+1], matT[4*axis+2])));
+    }
+    for (LodLevel& lod: m_Lods) {
+        lod.error *= scale;
     }
 }
 
@@ -686,24 +2281,10 @@ void Mesh::transform(mat4 matT)
  */
 Mesh::~Mesh()
 {
-    // supprimer les triangles
-    for (Triangle* triangle: m_TriangleList) {
-        triangle->setMesh(nullptr);
-        delete triangle;
-    }
-
-    // supprimer les sommets
-    for (Vertex* vertex: m_VertexList) {
-        vertex->setMesh(nullptr);
-        delete vertex;
-    }
+    // libérer sa place dans l'arène
+    if (m_Arena != nullptr) m_Arena->remove(this);
 
     // supprimer les VBOs (le shader n'est pas créé ici)
-    Utils::deleteVBO(m_VertexBufferId);
-    Utils::deleteVBO(m_ColorBufferId);
-    Utils::deleteVBO(m_TexCoordsBufferId);
-    Utils::deleteVBO(m_NormalBufferId);
-    Utils::deleteVBO(m_FacesIndexBufferId);
-    Utils::deleteVBO(m_EdgesIndexBufferId);
+    deleteBuffers();
 }
 
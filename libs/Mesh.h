@@ -3,17 +3,22 @@
 
 // Définition de la classe Mesh
 
-// IMPORTANT: cette représentation des mesh (point-triangle) est très inefficace et ne peut pas convenir à un projet important
-// Consulter le livre Synthèse d'images avec OpenGL ES de Pierre Nerzic pour une meilleure modélisation (half-edge)
+// Les sommets sont rangés en tableaux d'attributs (coordonnées, normales...) et les triangles en
+// tableau d'indices : les VBOs sont construits directement à partir de ces tableaux.
+// Les questions de voisinage (triangles autour d'un sommet, bords...) se posent à un HalfEdgeMesh construit
+// à partir des triangles, voir le livre Synthèse d'images avec OpenGL ES de Pierre Nerzic (half-edge)
 
 
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <list>
 #include <string>
+#include <stdint.h>
 
 #include <gl-matrix.h>
 #include <utils.h>
+#include <VertexFormat.h>
 
 
 // pré-déclarations
@@ -23,6 +28,8 @@ namespace mesh {
     class Triangle;
 }
 class Material;
+class RenderQueue;
+class GeometryArena;
 
 #include <Material.h>
 #include <MeshVertex.h>
@@ -33,41 +40,280 @@ using namespace mesh;
 
 
 /**
- * Cette classe représente l'ensemble du maillage : listes des sommets et des triangles, avec une méthode de dessin
+ * Cette classe représente l'ensemble du maillage : tableaux des attributs des sommets et des indices
+ * des triangles, avec une méthode de dessin. Les classes Vertex et Triangle ne sont que des poignées
+ * sur ces tableaux.
  */
 class Mesh
 {
+public:
+
+    /**
+     * plage [begin, end[ de sommets ou de triangles modifiés depuis le dernier envoi dans un VBO
+     */
+    struct DirtyRange
+    {
+        size_t begin, end;
+
+        DirtyRange() : begin(0), end(0) {}
+
+        bool empty() const
+        {
+            return begin >= end;
+        }
+
+        void clear()
+        {
+            begin = end = 0;
+        }
+
+        /** étend la plage pour qu'elle contienne aussi [first, last[ */
+        void add(size_t first, size_t last)
+        {
+            if (first >= last) return;
+            if (empty()) {
+                begin = first;
+                end = last;
+            } else {
+                begin = std::min(begin, first);
+                end = std::max(end, last);
+            }
+        }
+        void add(const DirtyRange& other)
+        {
+            add(other.begin, other.end);
+        }
+    };
+
+    /**
+     * table des poignées des sommets ou des triangles. Chaque élément reçoit un emplacement qui
+     * mémorise sa position actuelle dans les tableaux et une génération. Supprimer l'élément laisse
+     * un trou à sa position, incrémente la génération de son emplacement, ce qui invalide toutes ses
+     * poignées, et libère l'emplacement pour un prochain élément. Les trous sont supprimés plus tard,
+     * en une fois, par Mesh::compact : les positions changent alors mais pas les emplacements.
+     */
+    struct SlotTable
+    {
+        /// position de l'élément de chaque emplacement, -1 si l'emplacement est libre
+        std::vector<long> positions;
+
+        /// génération de chaque emplacement
+        std::vector<uint32_t> generations;
+
+        /// emplacements libres, réutilisés en premier
+        std::vector<long> freeslots;
+
+        /// emplacement de l'élément de chaque position, -1 pour un trou
+        std::vector<long> slots;
+
+        /// nombre de trous dans slots
+        size_t holes;
+
+        SlotTable() : holes(0) {}
+
+        /** attribue un emplacement à l'élément situé à la position indiquée et le retourne */
+        long allocate(long position)
+        {
+            long slot;
+            if (freeslots.empty()) {
+                slot = positions.size();
+                positions.push_back(position);
+                generations.push_back(0);
+            } else {
+                slot = freeslots.back();
+                freeslots.pop_back();
+                positions[slot] = position;
+            }
+            if ((size_t) position >= slots.size()) slots.resize(position+1, -1);
+            slots[position] = slot;
+            return slot;
+        }
+
+        /** libère l'emplacement, son élément laisse un trou */
+        void release(long slot)
+        {
+            slots[positions[slot]] = -1;
+            positions[slot] = -1;
+            generations[slot]++;
+            freeslots.push_back(slot);
+            holes++;
+        }
+
+        /** retourne la position de l'élément désigné par une poignée, -1 si elle n'est plus valable */
+        long getPosition(long slot, uint32_t generation) const
+        {
+            if (slot < 0 || (size_t) slot >= positions.size() || generations[slot] != generation) return -1;
+            return positions[slot];
+        }
+    };
+
+    /**
+     * niveau de détail simplifié : plage de triangles dans le tableau des indices des niveaux,
+     * ils emploient les mêmes sommets que le maillage complet
+     */
+    struct LodLevel
+    {
+        /// numéro du premier triangle du niveau
+        size_t first;
+
+        /// nombre de triangles du niveau
+        size_t count;
+
+        /// écart maximal estimé avec le maillage complet, dans l'unité des coordonnées
+        float error;
+    };
+
+    /// options de loadObj, à combiner
+    enum LoadOptions {
+        /// réordonner les triangles et les sommets pour la carte graphique, voir MeshOptimizer::optimize
+        LOAD_OPTIMIZE = 1,
+        /// générer les niveaux de détail, voir generateLods
+        LOAD_LODS = 2,
+    };
+
+    /// nombre de niveaux de détail par défaut, y compris le maillage complet
+    static const int LOD_COUNT = 4;
+
+    /// marge de selectLod pour passer à un niveau plus grossier, évite les allers-retours à la limite
+    static constexpr float LOD_HYSTERESIS = 0.75f;
+
 private:
 
+    // les poignées accèdent aux tableaux sans provoquer de compactage
+    friend class mesh::Vertex;
+    friend class mesh::Triangle;
+
+    // l'arène copie les indices des niveaux de détail
+    friend class GeometryArena;
+
     /// nom du maillage
     std::string m_Name;
 
-    /// liste des sommets (accès direct => vector)
-    std::vector<Vertex*> m_VertexList;
+    /// attributs des sommets, un tableau contigu par attribut (vec3 = 3 GLfloat consécutifs)
+    std::vector<vec3> m_Coords;
+    std::vector<vec3> m_Colors;
+    std::vector<vec2> m_TexCoords;
+    std::vector<vec3> m_Normals;
+    std::vector<vec3> m_Tangents;
+
+    /// numéros des sommets des triangles, 3 par triangle
+    std::vector<GLuint> m_Indices;
+
+    // poignées des sommets et des triangles, et positions des triangles supprimés réutilisables par addTriangle
+    SlotTable m_VertexSlots;
+    SlotTable m_TriangleSlots;
+    std::vector<long> m_TriangleHoles;
+
+    // si true, les attributs sont rangés dans un seul VBO entrelacé
+    bool m_Interleaved;
+
+    // VBO entrelacé, attributs qu'il contient (masque de VertexFormat) et capacité en sommets
+    GLint m_InterleavedBufferId;
+    unsigned m_InterleavedFormat;
+    size_t m_InterleavedCapacity;
 
-    /// liste des triangles (accès direct => vector)
-    std::vector<Triangle*> m_TriangleList;
+    // si true, les attributs du VBO entrelacé sont quantifiés, les coordonnées relativement à la boîte offset + [0,1]*scale
+    bool m_Quantized;
+    vec3 m_QuantizationOffset;
+    vec3 m_QuantizationScale;
 
-    // si true, les VBOS seront refaits au prochain dessin
-    bool m_UpdateVBOs;
+    // VBOs séparés, un par attribut, et leurs capacités en sommets
+    GLint m_AttributeBufferId[VertexFormat::ATTRIBUTE_COUNT];
+    size_t m_AttributeCapacity[VertexFormat::ATTRIBUTE_COUNT];
 
-    // identifiants des VBOs
-    GLint m_VertexBufferId;
-    GLint m_ColorBufferId;
-    GLint m_TexCoordsBufferId;
-    GLint m_NormalBufferId;
-    GLint m_TangentBufferId;
+    // VBOs des indices, leurs capacités en triangles et en arêtes, et le nombre d'arêtes uniques
     GLint m_FacesIndexBufferId;
     GLint m_EdgesIndexBufferId;
+    size_t m_FacesCapacity;
+    size_t m_EdgesCapacity;
+    size_t m_EdgesCount;
 
     // types des VBOS d'index
     GLint m_FacesIndexBufferType;
     GLint m_EdgesIndexBufferType;
 
+    // plages de sommets modifiés, par attribut, et de triangles modifiés
+    DirtyRange m_DirtyAttributes[VertexFormat::ATTRIBUTE_COUNT];
+    DirtyRange m_DirtyFaces;
+
+    // les arêtes uniques sont à recalculer entièrement
+    bool m_EdgesChanged;
+
+    // boîte englobante alignée sur les axes et sphère englobante, recalculées si les coordonnées ont changé
+    vec3 m_BoundsMin;
+    vec3 m_BoundsMax;
+    vec3 m_SphereCenter;
+    float m_SphereRadius;
+    bool m_BoundsChanged;
+
+    // niveaux de détail simplifiés, le niveau 0 (maillage complet) n'y est pas, et leurs indices
+    std::vector<LodLevel> m_Lods;
+    std::vector<GLuint> m_LodIndices;
+
+    // VBO des indices des niveaux de détail, son type, et s'il faut le renvoyer
+    GLint m_LodIndexBufferId;
+    GLint m_LodIndexBufferType;
+    bool m_LodsChanged;
+
+    // VBO des matrices des exemplaires, voir onDrawInstanced et submitInstanced sans StreamBuffer
+    GLint m_InstanceBufferId;
+
+    // VAOs : un par disposition des attributs des matériaux qui ont dessiné ce maillage, voir bindVertexArray
+    struct VertexArray
+    {
+        uint64_t layout;
+        GLuint id;
+    };
+    std::vector<VertexArray> m_VertexArrays;
+
+    // arène qui contient une copie du maillage, voir GeometryArena::addDraws
+    GeometryArena* m_Arena;
+
     // matériaux, l'un peut être null
     Material* m_FacesMaterial;
     Material* m_EdgesMaterial;
 
+    /**
+     * recalcule la boîte et la sphère englobantes si les coordonnées ont changé depuis le dernier calcul
+     */
+    void updateBounds();
+
+    /**
+     * met à jour le VBO entrelacé quantifié, voir getInterleavedBufferId
+     * @param format : attributs présents dans le VBO
+     * @param dirty : plage des sommets à envoyer
+     * @return identifiant OpenGL du VBO entrelacé
+     */
+    GLint uploadQuantized(unsigned format, DirtyRange& dirty);
+
+    /**
+     * indique si les tables des poignées couvrent exactement les tableaux, ce qui n'est plus
+     * le cas après un ajout direct dans les tableaux (ex: loadObj, loadBinary)
+     */
+    bool slotsInSync() const
+    {
+        return m_VertexSlots.slots.size() == m_Coords.size() && m_TriangleSlots.slots.size() == m_Indices.size()/3;
+    }
+
+    /**
+     * attribue des emplacements aux éléments ajoutés directement dans les tableaux et
+     * libère ceux des éléments qui en ont été retirés directement
+     */
+    void syncSlots();
+
+    /**
+     * retire des tableaux les sommets et triangles supprimés, ainsi que les triangles dont un
+     * sommet a été supprimé, voir compact
+     */
+    void compactSlots();
+
+    /**
+     * retourne une poignée sur le sommet ou le triangle situé à la position indiquée, sans compactage
+     * @param position : numéro actuel du sommet ou du triangle
+     */
+    Vertex makeVertex(long position);
+    Triangle makeTriangle(long position);
+
 public:
 
     /**
@@ -101,22 +347,67 @@ public:
 
 
     /**
-     * retourne la liste des sommets du maillage
-     * @return liste des sommets
+     * retourne le tableau des coordonnées des sommets, le sommet n°i est en [i]
+     * NB: après avoir modifié directement ce tableau ou les suivants, appeler markDirty
+     * NB: les tableaux retournés sont compactés, voir compact ; pour réordonner les sommets, employer permuteVertices
+     * @return coordonnées des sommets
      */
-    std::vector<Vertex*>& getVertexList()
+    std::vector<vec3>& getCoords()
     {
-        return m_VertexList;
+        compact();
+        return m_Coords;
     }
 
+    /**
+     * retourne le tableau des couleurs des sommets
+     * @return couleurs des sommets
+     */
+    std::vector<vec3>& getColors()
+    {
+        compact();
+        return m_Colors;
+    }
 
     /**
-     * retourne la liste des triangles du maillage
-     * @return liste des triangles
+     * retourne le tableau des coordonnées de texture des sommets
+     * @return coordonnées de texture des sommets
      */
-    std::vector<Triangle*>& getTriangleList()
+    std::vector<vec2>& getTexCoords()
     {
-        return m_TriangleList;
+        compact();
+        return m_TexCoords;
+    }
+
+    /**
+     * retourne le tableau des normales des sommets
+     * @return normales des sommets
+     */
+    std::vector<vec3>& getNormals()
+    {
+        compact();
+        return m_Normals;
+    }
+
+    /**
+     * retourne le tableau des tangentes des sommets
+     * @return tangentes des sommets
+     */
+    std::vector<vec3>& getTangents()
+    {
+        compact();
+        return m_Tangents;
+    }
+
+    /**
+     * retourne le tableau des numéros des sommets des triangles, 3 par triangle
+     * NB: après avoir modifié directement ce tableau, appeler markTrianglesDirty. Les poignées des
+     * triangles suivent les positions : réordonner les triangles leur fait désigner d'autres triangles
+     * @return indices des triangles
+     */
+    std::vector<GLuint>& getIndices()
+    {
+        compact();
+        return m_Indices;
     }
 
 
@@ -126,7 +417,8 @@ public:
      */
     int getVertexCount()
     {
-        return m_VertexList.size();
+        compact();
+        return m_Coords.size();
     }
 
 
@@ -136,55 +428,62 @@ public:
      */
     int getTriangleCount()
     {
-        return m_TriangleList.size();
+        compact();
+        return m_Indices.size() / 3;
     }
 
     /**
-     * retourne le triangle n°i (0..) du maillage, ou nullptr si i n'est pas correct
-     * @param i : numéro 0..NT-1 du triangle
-     * @return le Triangle() demandé ou nullptr si i n'est pas dans les bornes
+     * retourne le coin minimal de la boîte englobante alignée sur les axes, (0,0,0) si le maillage est vide
+     * @return coordonnées minimales des sommets sur chaque axe
      */
-    Vertex* getVertex(int i);
+    const vec3& getBoundsMin();
 
     /**
-     * retourne le triangle n°i (0..) du maillage, ou nullptr si i n'est pas correct
-     * @param i : numéro 0..NT-1 du triangle
-     * @return le Triangle() demandé ou nullptr si i n'est pas dans les bornes
+     * retourne le coin maximal de la boîte englobante alignée sur les axes, (0,0,0) si le maillage est vide
+     * @return coordonnées maximales des sommets sur chaque axe
      */
-    Triangle* getTriangle(int i);
+    const vec3& getBoundsMax();
 
     /**
-     * affiche le nombre de sommets et de triangles sur stdout
+     * retourne le centre de la sphère englobante : c'est le centre de la boîte englobante
+     * @return centre de la sphère
      */
-    void info();
+    const vec3& getBoundingSphereCenter();
 
     /**
-     * Cette méthode ajoute le sommet fourni à la fin de la liste
-     * @param vertex sommet à rajouter
+     * retourne le rayon de la sphère englobante : distance du sommet le plus éloigné de son centre
+     * @return rayon de la sphère
      */
-    void pushVertex(Vertex* vertex);
+    float getBoundingSphereRadius();
 
     /**
-     * Cette méthode enlève le sommet fourni de la liste
-     * NB: la méthode ne le supprime pas (voir son destructeur pour cela)
-     * @see #delVertex
-     * @param vertex sommet à enlever
+     * retourne le sommet n°i (0..) du maillage
+     * @param i : numéro 0..NV-1 du sommet
+     * @return le Vertex() demandé, invalide si i n'est pas dans les bornes (voir Vertex::isValid)
      */
-    void popVertex(Vertex* vertex);
+    Vertex getVertex(int i);
 
     /**
-     * Cette méthode ajoute le triangle fourni à la fin de la liste
-     * @param triangle à rajouter
+     * retourne le triangle n°i (0..) du maillage
+     * @param i : numéro 0..NT-1 du triangle
+     * @return le Triangle() demandé, invalide si i n'est pas dans les bornes (voir Triangle::isValid)
      */
-    void pushTriangle(Triangle* triangle);
+    Triangle getTriangle(int i);
 
     /**
-     * Cette méthode enlève le triangle fourni de la liste
-     * NB: la méthode ne le supprime pas (voir son destructeur pour cela)
-     * @see #delTriangle
-     * @param triangle à enlever
+     * affiche le nombre de sommets et de triangles sur stdout
      */
-    void popTriangle(Triangle* triangle);
+    void info();
+
+    /**
+     * Cette méthode ajoute un sommet à la fin des tableaux. Il est magenta, sans normale
+     * ni coordonnées de texture, employer les setters de Vertex pour les définir.
+     * @param xyz : coordonnées du sommet
+     * @return le nouveau sommet
+     */
+    Vertex addVertex(vec3 xyz);
+    Vertex addVertex(float x, float y, float z);
+    Vertex addVertex(double x, double y, double z);
 
     /**
      * Cette méthode crée et rajoute un triangle au maillage.
@@ -195,7 +494,7 @@ public:
      * @param v3 : le troisième coin du triangle
      * @return le nouveau triangle, ajouté au maillage
      */
-    Triangle* addTriangle(Vertex* v1, Vertex* v2, Vertex* v3);
+    Triangle addTriangle(const Vertex& v1, const Vertex& v2, const Vertex& v3);
 
     /**
      * Cette méthode crée et rajoute un quadrilatère au maillage. En fait, cela
@@ -208,21 +507,47 @@ public:
      * @param v3 : l'un des coins du quad
      * @param s4 : l'un des coins du quad
      */
-    void addQuad(Vertex* v1, Vertex* v2, Vertex* v3, Vertex* s4);
+    void addQuad(const Vertex& v1, const Vertex& v2, const Vertex& v3, const Vertex& s4);
 
     /**
-     * Cette méthode supprime le triangle du maillage en mettant à jour toutes
-     * les listes
+     * Cette méthode supprime le triangle du maillage, en temps constant : ses poignées deviennent
+     * invalides et sa place est réutilisée par le prochain addTriangle ou retirée par compact.
      * @param triangle : celui qu'il faut supprimer
      */
-    void delTriangle(Triangle* triangle);
+    void delTriangle(const Triangle& triangle);
 
     /**
-     * Cette méthode supprime le sommet du maillage en mettant à jour toutes
-     * les listes : tous les triangles qui le contiennent sont aussi supprimés.
+     * Cette méthode supprime le sommet du maillage, en temps constant : ses poignées deviennent
+     * invalides, ainsi que celles des triangles qui le contiennent. Ceux-ci sont retirés avec
+     * le sommet par compact.
      * @param vertex : celui qu'il faut supprimer
      */
-    void delVertex(Vertex* vertex);
+    void delVertex(const Vertex& vertex);
+
+    /**
+     * Cette méthode retire des tableaux les sommets et triangles supprimés depuis le dernier appel.
+     * Les sommets et triangles restants sont renumérotés dans le même ordre, leurs poignées
+     * restent valables. Elle est appelée par toutes les méthodes qui emploient les tableaux
+     * (getters des tableaux et des nombres d'éléments, VBOs, calculs...) et ne fait rien s'il n'y a
+     * rien à retirer.
+     */
+    void compact()
+    {
+        if (m_VertexSlots.holes > 0 || m_TriangleSlots.holes > 0 || ! slotsInSync()) compactSlots();
+    }
+
+    /**
+     * Cette méthode change l'ordre des sommets dans les tableaux, leurs poignées les suivent.
+     * NB: les indices des triangles ne sont pas modifiés, c'est à l'appelant de les renuméroter
+     * @param remap : nouveau numéro de chaque sommet
+     */
+    void permuteVertices(const std::vector<GLuint>& remap);
+
+    /**
+     * Cette méthode change l'ordre des triangles dans le tableau des indices, leurs poignées les suivent.
+     * @param order : ancien numéro du triangle à placer à chaque position, ex: order[0] devient le premier
+     */
+    void permuteTriangles(const std::vector<uint32_t>& order);
 
 
     /**
@@ -244,14 +569,217 @@ public:
 
     /**
      * Cette méthode lit le fichier indiqué, il contient un maillage au format OBJ
+     * Lors du premier chargement, une copie binaire du maillage est enregistrée à côté
+     * du fichier OBJ (extension .mesh), elle est relue directement lors des chargements suivants
+     * tant que le fichier OBJ n'a pas été modifié.
+     * Les gros fichiers sont découpés en morceaux analysés en parallèle, le résultat est
+     * identique à une analyse séquentielle.
+     * @param filename : nom complet du fichier à lire
+     * @param threads : nombre maximal de threads d'analyse, 0 pour le nombre de coeurs
+     * @param options : combinaison de LoadOptions, traitements appliqués après la lecture,
+     * la copie binaire contient leur résultat
+     */
+    void loadObj(std::string filename, int threads=0, unsigned options=0);
+
+    /**
+     * Cette méthode enregistre le maillage dans un fichier binaire : entête puis tableaux
+     * des coordonnées, normales, coordonnées de texture et indices des triangles, puis niveaux de détail
+     * @param filename : nom complet du fichier à écrire
+     * @param sourcefilename : fichier d'origine du maillage (sa date et sa taille sont mémorisées), ou ""
+     * @param options : LoadOptions appliquées au maillage, mémorisées dans le fichier
+     * @return true si le fichier a pu être écrit
+     */
+    bool saveBinary(std::string filename, std::string sourcefilename="", unsigned options=0);
+
+    /**
+     * Cette méthode ajoute au maillage le contenu d'un fichier binaire écrit par saveBinary.
+     * Le fichier est projeté en mémoire (mmap) et n'est pas analysé. Ses niveaux de détail ne
+     * sont repris que si le maillage était vide.
      * @param filename : nom complet du fichier à lire
+     * @param sourcefilename : fichier d'origine du maillage, le fichier binaire est refusé s'il est plus ancien, ou ""
+     * @param options : LoadOptions attendues, le fichier est refusé s'il a été fait avec d'autres
+     * @return false si le fichier est absent, invalide ou périmé
+     */
+    bool loadBinary(std::string filename, std::string sourcefilename="", unsigned options=0);
+
+
+    /**
+     * Cette méthode construit les niveaux de détail du maillage par simplifications successives
+     * (voir MeshSimplifier), chacun ayant environ ratio fois moins de triangles que le précédent.
+     * Ils emploient les mêmes sommets : seuls les indices des triangles sont ajoutés.
+     * La construction s'arrête plus tôt si le maillage ne peut plus être assez simplifié.
+     * NB: toute modification des triangles supprime les niveaux, il faut alors les reconstruire
+     * @param count : nombre de niveaux souhaité, y compris le maillage complet
+     * @param ratio : rapport du nombre de triangles entre deux niveaux successifs
+     */
+    void generateLods(int count=LOD_COUNT, float ratio=0.5f);
+
+    /**
+     * supprime les niveaux de détail, il ne reste que le maillage complet
+     */
+    void clearLods();
+
+    /**
+     * retourne le nombre de niveaux de détail, y compris le maillage complet (niveau 0)
+     * @return nombre de niveaux, 1 s'il n'y a pas eu de generateLods
+     */
+    int getLodCount()
+    {
+        return 1 + m_Lods.size();
+    }
+
+    /**
+     * retourne le nombre de triangles d'un niveau de détail
+     * @param level : niveau entre 0 (maillage complet) et getLodCount()-1
+     * @return nombre de triangles du niveau
+     */
+    int getLodTriangleCount(int level);
+
+    /**
+     * retourne l'erreur géométrique d'un niveau de détail, voir MeshSimplifier::simplify
+     * @param level : niveau entre 0 (maillage complet) et getLodCount()-1
+     * @return écart maximal estimé avec le maillage complet, dans l'unité des coordonnées
+     */
+    float getLodError(int level);
+
+    /**
+     * choisit le niveau de détail le plus grossier dont l'erreur reste inférieure à la tolérance à
+     * l'écran. Pour ne pas alterner entre deux niveaux d'une image à l'autre, le niveau actuel n'est
+     * remplacé par un plus grossier que si celui-ci est nettement sous la tolérance (LOD_HYSTERESIS).
+     * @param pixelsperunit : nombre de pixels qu'occupe une unité de longueur à la distance de l'objet
+     * @param current : niveau actuellement dessiné
+     * @param tolerance : erreur tolérée, en pixels
+     * @return niveau à dessiner
+     */
+    int selectLod(float pixelsperunit, int current, float tolerance=1.0f);
+
+
+    /**
+     * signale que des sommets ont été modifiés : la plage sera renvoyée au prochain dessin
+     * NB: les setters de Vertex l'appellent, il faut l'appeler après une modification directe des tableaux
+     * @param attribute : l'un des VertexFormat::Attribute
+     * @param first : numéro du premier sommet modifié
+     * @param count : nombre de sommets modifiés
+     */
+    void markDirty(int attribute, size_t first, size_t count=1);
+
+    /**
+     * signale que des triangles ont été modifiés : leurs indices seront renvoyés au prochain dessin
+     * @param first : numéro du premier triangle modifié
+     * @param count : nombre de triangles modifiés
+     */
+    void markTrianglesDirty(size_t first, size_t count=1);
+
+    /**
+     * supprime tous les VBOs, ils seront entièrement reconstruits au prochain dessin
+     */
+    void deleteBuffers();
+
+    /**
+     * lie le VAO du maillage correspondant à la disposition des attributs d'un matériau. Il est créé
+     * lors du premier appel, le matériau doit alors y décrire ses attributs ; ensuite, une seule
+     * liaison suffit à les retrouver tous. Les VAOs sont supprimés quand les VBOs des sommets changent.
+     * @param layout : disposition des attributs, voir Material::getVertexLayout
+     * @return true si le VAO existait déjà, false s'il vient d'être créé et que ses attributs sont à décrire
+     */
+    bool bindVertexArray(uint64_t layout);
+
+    /**
+     * supprime les VAOs, ils seront reconstruits au prochain dessin
+     */
+    void deleteVertexArrays();
+
+    /**
+     * choisit la disposition des attributs dans les VBOs : un seul VBO entrelacé (par défaut)
+     * ou un VBO par attribut
+     * @param interleaved : true pour le VBO entrelacé
+     */
+    void setInterleaved(bool interleaved);
+
+    /**
+     * indique si les attributs sont rangés dans un seul VBO entrelacé
+     * @return true si c'est le cas, voir getInterleavedBufferId
+     */
+    bool isInterleaved()
+    {
+        return m_Interleaved;
+    }
+
+    /**
+     * choisit des attributs quantifiés dans le VBO entrelacé (voir VertexFormat::quantizedSize) :
+     * un sommet de coordonnées, coordonnées de texture et normale passe de 32 à 16 octets. Les shaders
+     * des matériaux doivent alors employer les fonctions de Material::getDequantizationFunctions.
+     * NB: sans effet sur les VBOs séparés, voir setInterleaved
+     * @param quantized : true pour quantifier les attributs
+     */
+    void setQuantized(bool quantized);
+
+    /**
+     * indique si le VBO entrelacé contient des attributs quantifiés
+     * @return true si c'est le cas
+     */
+    bool isQuantized()
+    {
+        return m_Quantized && m_Interleaved;
+    }
+
+    /**
+     * retourne le coin minimal de la boîte dans laquelle les coordonnées sont quantifiées,
+     * c'est la boîte englobante, sauf qu'elle ne rétrécit pas quand les sommets bougent
+     * @return coordonnées du sommet quantifié (0,0,0)
      */
-    void loadObj(std::string filename);
+    const vec3& getQuantizationOffset()
+    {
+        return m_QuantizationOffset;
+    }
+
+    /**
+     * retourne la taille de la boîte dans laquelle les coordonnées sont quantifiées
+     * @return écart entre les sommets quantifiés (1,1,1) et (0,0,0)
+     */
+    const vec3& getQuantizationScale()
+    {
+        return m_QuantizationScale;
+    }
+
+    /**
+     * retourne le tableau de l'attribut indiqué, sous forme de GLfloat consécutifs
+     * @param attribute : l'un des VertexFormat::Attribute
+     * @return tableau de VertexFormat::components(attribute) GLfloat par sommet, nullptr s'il n'y a aucun sommet
+     */
+    GLfloat* getAttributeData(int attribute);
+
+    /**
+     * Cette méthode retourne l'identifiant du VBO entrelacé contenant au moins les attributs demandés.
+     * Elle construit ce VBO s'il n'est pas encore créé ou s'il lui manque des attributs, sinon elle
+     * y envoie seulement les sommets modifiés. Seuls les attributs demandés par les matériaux du
+     * maillage sont envoyés, voir getInterleavedFormat.
+     * @param mask : attributs nécessaires, combinaison des VertexFormat::Mask, les coordonnées sont toujours présentes
+     * @return identifiant OpenGL du VBO entrelacé
+     */
+    GLint getInterleavedBufferId(unsigned mask);
+
+    /**
+     * retourne les attributs contenus dans le VBO entrelacé, pour calculer le pas et les décalages
+     * avec VertexFormat::stride et VertexFormat::offset
+     * @return masque des attributs
+     */
+    unsigned getInterleavedFormat()
+    {
+        return m_InterleavedFormat;
+    }
 
+    /**
+     * Cette méthode retourne l'identifiant du VBO contenant l'attribut indiqué, seul.
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
+     * @param attribute : l'un des VertexFormat::Attribute
+     * @return identifiant OpenGL du VBO
+     */
+    GLint getAttributeBufferId(int attribute);
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les coordonnées 3D des sommets.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
      * Cette méthode met aussi à jour tous les indices m_Index des sommets
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des coordonnées
      */
@@ -259,57 +787,117 @@ public:
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les couleurs des sommets.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des couleurs
      */
     GLint getColorBufferId();
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les coordonnées de texture des sommets.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des coordonnées de texture 2D
      */
     GLint getTexCoordsBufferId();
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les normales des sommets.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des normales
      */
     GLint getNormalBufferId();
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les tangentes des sommets.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les sommets modifiés
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des tangentes
      */
     GLint getTangentBufferId();
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les indices pour dessiner les triangles en primitives indexées.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
-     * Il faut avoir appelé getVertexBufferId auparavant pour que les indices soient corrects et cohérents
+     * Elle construit ce VBO s'il n'est pas encore créé, sinon elle y envoie seulement les triangles modifiés
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des indices de triangles
      */
     GLint getFacesIndexBufferId();
 
     /**
      * Cette méthode retourne l'identifiant du VBO contenant les indices pour dessiner les arêtes en primitives indexées.
-     * Elle construit ce VBO s'il n'est pas encore créé mais que le maillage est complet
-     * Il faut avoir appelé getVertexBufferId auparavant pour que les indices soient corrects et cohérents
+     * Chaque arête n'y figure qu'une fois, même si elle est partagée par deux triangles (voir HalfEdgeMesh),
+     * il est donc entièrement reconstruit quand des triangles ont été modifiés.
      * @return null si le maillage n'est pas prêt, sinon c'est l'identifiant WebGL du VBO des indices de lignes
      */
     GLint getEdgesIndexBufferId();
 
+    /**
+     * Cette méthode retourne l'identifiant du VBO contenant les indices des triangles de tous les
+     * niveaux de détail simplifiés, à la suite, voir LodLevel. Elle le construit s'il n'est pas à jour.
+     * @return identifiant OpenGL du VBO, -1 s'il n'y a pas de niveaux de détail
+     */
+    GLint getLodIndexBufferId();
+
+    /**
+     * construit dès maintenant les VBOs dont les matériaux auront besoin, au lieu d'attendre le
+     * premier dessin, ex: pour qu'un maillage chargé en arrière-plan soit prêt quand il apparaît
+     */
+    void prepareBuffers();
+
     /**
      * dessiner le maillage s'il est prêt. S'il y a un matériau pour les faces, elles sont dessinées, pareil pour les arêtes.
+     * Les arêtes sont toujours celles du maillage complet.
      * @param matP : matrice de projection perpective
      * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+     * @param level : niveau de détail des faces, voir selectLod
+     */
+    void onDraw(const mat4& matP, const mat4& matVM, int level=0);
+
+    /**
+     * dessine plusieurs exemplaires du maillage, un seul appel OpenGL par niveau de détail et par matériau,
+     * voir submitInstanced
+     * @param matP : matrice de projection perpective
+     * @param matV : matrice de la caméra
+     * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+     * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+     */
+    void onDrawInstanced(const mat4& matP, const mat4& matV, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts);
+
+    /**
+     * ajoute le dessin du maillage à une file de rendu : ses faces et ses arêtes, comme onDraw
+     * @param queue : file de rendu, voir RenderQueue::execute
+     * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+     * @param level : niveau de détail des faces, voir selectLod
+     */
+    void submit(RenderQueue& queue, const mat4& matVM, int level=0);
+
+    /**
+     * ajoute à une file de rendu le dessin de plusieurs exemplaires du maillage, un seul appel OpenGL par
+     * niveau de détail et par matériau. Les matrices des exemplaires sont envoyées dès maintenant dans un VBO,
+     * celui de la file s'il y en a un (voir RenderQueue::setStreamBuffer), et lues par le shader, voir Material::getInstancingFunctions. Si un matériau ne les emploie pas, ses
+     * exemplaires sont dessinés un par un.
+     * @param queue : file de rendu, voir RenderQueue::execute
+     * @param matV : matrice de la caméra
+     * @param matrices : matrices de modèle des exemplaires, 16 GLfloat chacune, rangées par niveau de détail croissant
+     * @param levelcounts : nombre d'exemplaires de chaque niveau de détail, à partir du niveau 0
+     */
+    void submitInstanced(RenderQueue& queue, const mat4& matV, const std::vector<GLfloat>& matrices, const std::vector<int>& levelcounts);
+
+    /**
+     * dessine les triangles d'un niveau de détail avec le matériau déjà activé
+     * @param level : niveau de détail, voir selectLod
+     * @param instances : nombre d'exemplaires, 0 pour un dessin simple
+     * @param boundindices : VBO d'indices déjà lié, il n'est pas relié s'il n'a pas changé ; reçoit celui de ce dessin
+     */
+    void drawFaces(int level, GLsizei instances, GLint& boundindices);
+
+    /**
+     * dessine les arêtes du maillage complet avec le matériau déjà activé
+     * @param instances : nombre d'exemplaires, 0 pour un dessin simple
+     * @param boundindices : VBO d'indices déjà lié, il n'est pas relié s'il n'a pas changé ; reçoit celui de ce dessin
      */
-    void onDraw(const mat4& matP, const mat4& matVM);
+    void drawEdges(GLsizei instances, GLint& boundindices);
 
     /**
-     * modifie les coordonnées des sommets par la matrice indiquée
+     * modifie les coordonnées des sommets par la matrice indiquée, les erreurs des niveaux
+     * de détail suivent son facteur d'échelle
      * @param matT mat4 qui est appliquée sur chaque sommet
      */
     void transform(mat4 matT);
@@ -0,0 +1,352 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+
+#include <utils.h>
+#include <MeshOptimizer.h>
+
+
+namespace MeshOptimizer
+{
+
+/**
+ * simule un cache FIFO de sommets transformés sur la liste de triangles
+ * @param indices : numéros des sommets, 3 par triangle
+ * @param vertexcount : nombre de sommets
+ * @param cachesize : nombre d'entrées du cache
+ * @return mesures ACMR et ATVR
+ */
+CacheStatistics analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexcount, int cachesize)
+{
+    // date d'entrée de chaque sommet dans le cache : il y est encore si elle est assez récente
+    std::vector<unsigned> timestamps(vertexcount, 0);
+    unsigned time = cachesize + 1;
+
+    CacheStatistics statistics;
+    statistics.transforms = 0;
+    size_t used = 0;
+    for (GLuint index: indices) {
+        if (timestamps[index] == 0) used++;
+        if (time - timestamps[index] > (unsigned) cachesize) {
+            timestamps[index] = time++;
+            statistics.transforms++;
+        }
+    }
+    size_t trianglecount = indices.size() / 3;
+    statistics.acmr = trianglecount == 0 ? 0.0f : (float) statistics.transforms / trianglecount;
+    statistics.atvr = used == 0 ? 0.0f : (float) statistics.transforms / used;
+    return statistics;
+}
+
+
+/**
+ * score d'un sommet selon Forsyth : élevé s'il vient d'être employé (il est au début du cache)
+ * et s'il ne lui reste que peu de triangles, pour le terminer et le libérer rapidement
+ * @param position : place du sommet dans le cache LRU, -1 s'il n'y est pas
+ * @param remaining : nombre de triangles pas encore placés qui contiennent ce sommet
+ */
+static float vertexScore(int position, int remaining)
+{
+    // sommet terminé, il n'a plus d'intérêt
+    if (remaining == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (position >= 0) {
+        if (position < 3) {
+            // sommets du dernier triangle : score fixe pour ne pas favoriser les bandes étroites
+            score = 0.75f;
+        } else {
+            score = powf(1.0f - (float)(position - 3) / (CACHE_SIZE - 3), 1.5f);
+        }
+    }
+
+    // bonus pour les sommets qui n'ont plus que quelques triangles
+    score += 2.0f * powf((float) remaining, -0.5f);
+    return score;
+}
+
+
+/**
+ * réordonne les triangles pour que les sommets restent dans le cache (algorithme de Forsyth)
+ * @param indices : numéros des sommets, 3 par triangle, modifiés sur place
+ * @param vertexcount : nombre de sommets
+ * @param triangles : si non nul, reçoit l'ancien numéro de chaque triangle dans le nouvel ordre
+ */
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexcount, std::vector<uint32_t>* triangles)
+{
+    const size_t trianglecount = indices.size() / 3;
+    if (triangles != nullptr) triangles->clear();
+    if (trianglecount == 0) return;
+
+    // triangles de chaque sommet : ceux de v sont adjacency[offsets[v] .. offsets[v]+remaining[v]-1]
+    std::vector<int> remaining(vertexcount, 0);
+    for (GLuint index: indices) remaining[index]++;
+    std::vector<size_t> offsets(vertexcount + 1, 0);
+    for (size_t v=0; v<vertexcount; v++) offsets[v+1] = offsets[v] + remaining[v];
+    std::vector<int> adjacency(indices.size());
+    {
+        std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i=0; i<indices.size(); i++) adjacency[cursors[indices[i]]++] = i / 3;
+    }
+
+    // scores initiaux des sommets et des triangles
+    std::vector<int> positions(vertexcount, -1);
+    std::vector<float> vertexscores(vertexcount);
+    for (size_t v=0; v<vertexcount; v++) vertexscores[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> trianglescores(trianglecount);
+    std::vector<bool> emitted(trianglecount, false);
+    int best = 0;
+    for (size_t t=0; t<trianglecount; t++) {
+        trianglescores[t] = vertexscores[indices[3*t]] + vertexscores[indices[3*t+1]] + vertexscores[indices[3*t+2]];
+        if (trianglescores[t] > trianglescores[best]) best = t;
+    }
+
+    // cache LRU simulé, il peut déborder de 3 sommets le temps d'une mise à jour
+    std::vector<GLuint> cache, newcache;
+    cache.reserve(CACHE_SIZE + 3);
+    newcache.reserve(CACHE_SIZE + 3);
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    size_t scan = 0;
+    for (size_t n=0; n<trianglecount; n++) {
+        // aucun candidat dans le cache : prendre le prochain triangle non placé
+        if (best < 0) {
+            while (emitted[scan]) scan++;
+            best = scan;
+        }
+
+        // placer ce triangle et le retirer des listes de ses sommets
+        const GLuint* corners = &indices[3*best];
+        emitted[best] = true;
+        if (triangles != nullptr) triangles->push_back(best);
+        newcache.clear();
+        for (int k=0; k<3; k++) {
+            GLuint v = corners[k];
+            output.push_back(v);
+            int* triangles = &adjacency[offsets[v]];
+            int* last = triangles + remaining[v] - 1;
+            int* found = std::find(triangles, last + 1, best);
+            if (found <= last) {
+                std::swap(*found, *last);
+                remaining[v]--;
+            }
+            if (std::find(newcache.begin(), newcache.end(), v) == newcache.end()) newcache.push_back(v);
+        }
+
+        // mise à jour du cache : les sommets du triangle passent en tête
+        for (GLuint v: cache) {
+            if (v != corners[0] && v != corners[1] && v != corners[2]) newcache.push_back(v);
+        }
+        for (size_t i=0; i<newcache.size(); i++) {
+            positions[newcache[i]] = (i < (size_t) CACHE_SIZE) ? i : -1;
+        }
+
+        // nouveaux scores des sommets concernés (y compris ceux qui sortent du cache) et de leurs triangles
+        for (GLuint v: newcache) {
+            float score = vertexScore(positions[v], remaining[v]);
+            float delta = score - vertexscores[v];
+            vertexscores[v] = score;
+            const int* triangles = &adjacency[offsets[v]];
+            for (int i=0; i<remaining[v]; i++) trianglescores[triangles[i]] += delta;
+        }
+
+        // meilleur triangle parmi ceux des sommets du cache
+        if (newcache.size() > (size_t) CACHE_SIZE) newcache.resize(CACHE_SIZE);
+        cache.swap(newcache);
+        best = -1;
+        float bestscore = -1.0f;
+        for (GLuint v: cache) {
+            const int* triangles = &adjacency[offsets[v]];
+            for (int i=0; i<remaining[v]; i++) {
+                if (trianglescores[triangles[i]] > bestscore) {
+                    bestscore = trianglescores[triangles[i]];
+                    best = triangles[i];
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+
+/**
+ * réordonne des groupes de triangles consécutifs, sans trop dégrader le cache, pour que
+ * ceux tournés vers l'extérieur soient dessinés en premier et cachent les autres
+ * @param indices : numéros des sommets, 3 par triangle, déjà optimisés pour le cache, modifiés sur place
+ * @param coords : coordonnées des sommets
+ * @param threshold : dégradation acceptée de l'ACMR, ex: 1.05 pour 5%
+ * @param triangles : si non nul, reçoit l'ancien numéro de chaque triangle dans le nouvel ordre
+ */
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<vec3>& coords, float threshold, std::vector<uint32_t>* triangles)
+{
+    const size_t trianglecount = indices.size() / 3;
+    if (triangles != nullptr) triangles->clear();
+    if (trianglecount == 0) return;
+    const unsigned cachesize = ANALYSIS_CACHE_SIZE;
+
+    // simulation du cache FIFO, vider le cache = avancer le temps
+    std::vector<unsigned> timestamps(coords.size(), 0);
+    unsigned time = cachesize + 1;
+    auto misses = [&](size_t t) {
+        int count = 0;
+        for (int k=0; k<3; k++) {
+            GLuint v = indices[3*t+k];
+            if (time - timestamps[v] > cachesize) {
+                timestamps[v] = time++;
+                count++;
+            }
+        }
+        return count;
+    };
+
+    // limites dures : triangles dont aucun sommet n'est dans le cache, on peut y couper sans rien perdre
+    std::vector<size_t> hard;
+    for (size_t t=0; t<trianglecount; t++) {
+        if (misses(t) == 3) hard.push_back(t);
+    }
+    hard.push_back(trianglecount);
+
+    // limites souples : à l'intérieur de chaque groupe, couper dès que l'ACMR du morceau est assez bon
+    const size_t MIN_CLUSTER_SIZE = 8;
+    std::vector<size_t> clusters;
+    for (size_t h=0; h+1<hard.size(); h++) {
+        size_t begin = hard[h], end = hard[h+1];
+
+        // ACMR du groupe entier
+        time += cachesize + 1;
+        size_t total = 0;
+        for (size_t t=begin; t<end; t++) total += misses(t);
+        float limit = threshold * total / (end - begin);
+
+        // découpage
+        time += cachesize + 1;
+        clusters.push_back(begin);
+        size_t start = begin, count = 0;
+        for (size_t t=begin; t<end; t++) {
+            count += misses(t);
+            size_t size = t + 1 - start;
+            if (size >= MIN_CLUSTER_SIZE && t + 1 < end && count <= limit * size) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                count = 0;
+                time += cachesize + 1;
+            }
+        }
+    }
+    clusters.push_back(trianglecount);
+
+    // centre et normale de chaque groupe, pondérés par la surface des triangles
+    const size_t clustercount = clusters.size() - 1;
+    std::vector<vec3> centers(clustercount, vec3::create());
+    std::vector<vec3> normals(clustercount, vec3::create());
+    std::vector<float> areas(clustercount, 0.0f);
+    vec3 meshcenter = vec3::create();
+    float mesharea = 0.0f;
+    vec3 cAB = vec3::create(), cAC = vec3::create(), normal = vec3::create(), center = vec3::create();
+    for (size_t c=0; c<clustercount; c++) {
+        for (size_t t=clusters[c]; t<clusters[c+1]; t++) {
+            const vec3& A = coords[indices[3*t]];
+            const vec3& B = coords[indices[3*t+1]];
+            const vec3& C = coords[indices[3*t+2]];
+            vec3::subtract(cAB, B, A);
+            vec3::subtract(cAC, C, A);
+            vec3::cross(normal, cAB, cAC);
+            float area = vec3::length(normal);
+            vec3::add(center, A, B);
+            vec3::add(center, center, C);
+            vec3::scaleAndAdd(centers[c], centers[c], center, area / 3.0f);
+            vec3::add(normals[c], normals[c], normal);
+            areas[c] += area;
+        }
+        vec3::add(meshcenter, meshcenter, centers[c]);
+        mesharea += areas[c];
+        if (areas[c] > 0.0f) vec3::scale(centers[c], centers[c], 1.0f / areas[c]);
+    }
+    if (mesharea > 0.0f) vec3::scale(meshcenter, meshcenter, 1.0f / mesharea);
+
+    // clé de tri : les groupes éloignés du centre et tournés vers l'extérieur d'abord
+    std::vector<float> keys(clustercount);
+    std::vector<size_t> order(clustercount);
+    for (size_t c=0; c<clustercount; c++) {
+        vec3::subtract(center, centers[c], meshcenter);
+        vec3::normalize(normal, normals[c]);
+        keys[c] = vec3::dot(center, normal);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    // recopie des triangles dans l'ordre des groupes
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    for (size_t c: order) {
+        output.insert(output.end(), indices.begin() + 3*clusters[c], indices.begin() + 3*clusters[c+1]);
+        if (triangles == nullptr) continue;
+        for (size_t t=clusters[c]; t<clusters[c+1]; t++) triangles->push_back(t);
+    }
+    indices.swap(output);
+}
+
+
+/**
+ * renumérote les sommets du maillage dans l'ordre où les triangles les emploient, pour
+ * que leur lecture dans les VBOs soit séquentielle. Les sommets inutilisés sont placés à la fin.
+ * @param mesh : maillage dont les tableaux d'attributs et d'indices sont modifiés
+ */
+void optimizeVertexFetch(Mesh* mesh)
+{
+    const size_t vertexcount = mesh->getVertexCount();
+    std::vector<GLuint>& indices = mesh->getIndices();
+
+    // nouveaux numéros dans l'ordre de première apparition
+    const GLuint UNUSED = ~0u;
+    std::vector<GLuint> remap(vertexcount, UNUSED);
+    GLuint next = 0;
+    for (GLuint& index: indices) {
+        if (remap[index] == UNUSED) remap[index] = next++;
+        index = remap[index];
+    }
+    for (GLuint& number: remap) {
+        if (number == UNUSED) number = next++;
+    }
+
+    // réordonner tous les attributs, les poignées des sommets suivent
+    mesh->permuteVertices(remap);
+
+    // tous les triangles sont à renvoyer
+    mesh->markTrianglesDirty(0, mesh->getTriangleCount());
+}
+
+
+/**
+ * enchaîne les trois optimisations sur le maillage
+ * @param mesh : maillage à optimiser
+ * @param verbose : si true, affiche ACMR et ATVR avant et après
+ */
+void optimize(Mesh* mesh, bool verbose)
+{
+    // les optimisations travaillent sur une copie des indices, puis le maillage déplace ses
+    // triangles dans le même ordre pour que leurs poignées les suivent
+    std::vector<GLuint> indices = mesh->getIndices();
+    CacheStatistics before = analyzeVertexCache(indices, mesh->getVertexCount());
+
+    std::vector<uint32_t> order;
+    optimizeVertexCache(indices, mesh->getVertexCount(), &order);
+    mesh->permuteTriangles(order);
+    optimizeOverdraw(indices, mesh->getCoords(), 1.05f, &order);
+    mesh->permuteTriangles(order);
+    optimizeVertexFetch(mesh);
+
+    if (verbose) {
+        CacheStatistics after = analyzeVertexCache(mesh->getIndices(), mesh->getVertexCount());
+        std::cout<<mesh->getName()<<" : optimized, ACMR "<<before.acmr<<" -> "<<after.acmr
+                 <<", ATVR "<<before.atvr<<" -> "<<after.atvr<<std::endl;
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef LIBS_MESHOPTIMIZER_H
+#define LIBS_MESHOPTIMIZER_H
+
+// Optimisation de l'ordre des triangles et des sommets d'un maillage
+
+#include <vector>
+
+#include <gl-matrix.h>
+#include <utils.h>
+
+#include <Mesh.h>
+
+
+/**
+ * Ces fonctions réordonnent les triangles et les sommets d'un maillage pour la carte graphique,
+ * sans changer son apparence :
+ * - cache des sommets transformés : les triangles qui partagent des sommets sont rapprochés (algorithme de Forsyth)
+ * - surdessin : les groupes de triangles tournés vers l'extérieur sont dessinés en premier
+ * - lecture des sommets : les sommets sont renumérotés dans leur ordre d'emploi
+ * Employer optimize pour enchaîner les trois, voir aussi Mesh::loadObj.
+ */
+namespace MeshOptimizer
+{
+    /// taille du cache de sommets simulé par l'algorithme de Forsyth (LRU)
+    const int CACHE_SIZE = 32;
+
+    /// taille du cache FIFO employé pour mesurer l'efficacité, proche des cartes graphiques actuelles
+    const int ANALYSIS_CACHE_SIZE = 16;
+
+    /**
+     * mesures de l'efficacité du cache de sommets pour un ordre de triangles
+     */
+    struct CacheStatistics
+    {
+        /// nombre de sommets transformés (défauts de cache)
+        size_t transforms;
+
+        /// average cache miss ratio : sommets transformés par triangle, entre 0.5 et 3, le plus petit est le mieux
+        float acmr;
+
+        /// average transform to vertex ratio : sommets transformés par sommet employé, 1 est l'idéal
+        float atvr;
+    };
+
+    /**
+     * simule un cache FIFO de sommets transformés sur la liste de triangles
+     * @param indices : numéros des sommets, 3 par triangle
+     * @param vertexcount : nombre de sommets
+     * @param cachesize : nombre d'entrées du cache
+     * @return mesures ACMR et ATVR
+     */
+    CacheStatistics analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexcount, int cachesize=ANALYSIS_CACHE_SIZE);
+
+    /**
+     * réordonne les triangles pour que les sommets restent dans le cache (algorithme de Forsyth)
+     * @param indices : numéros des sommets, 3 par triangle, modifiés sur place
+     * @param vertexcount : nombre de sommets
+     * @param triangles : si non nul, reçoit l'ancien numéro de chaque triangle dans le nouvel ordre
+     */
+    void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexcount, std::vector<uint32_t>* triangles=nullptr);
+
+    /**
+     * réordonne des groupes de triangles consécutifs, sans trop dégrader le cache, pour que
+     * ceux tournés vers l'extérieur soient dessinés en premier et cachent les autres
+     * @param indices : numéros des sommets, 3 par triangle, déjà optimisés pour le cache, modifiés sur place
+     * @param coords : coordonnées des sommets
+     * @param threshold : dégradation acceptée de l'ACMR, ex: 1.05 pour 5%
+     * @param triangles : si non nul, reçoit l'ancien numéro de chaque triangle dans le nouvel ordre
+     */
+    void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<vec3>& coords, float threshold=1.05f, std::vector<uint32_t>* triangles=nullptr);
+
+    /**
+     * renumérote les sommets du maillage dans l'ordre où les triangles les emploient, pour
+     * que leur lecture dans les VBOs soit séquentielle. Les sommets inutilisés sont placés à la fin.
+     * @param mesh : maillage dont les tableaux d'attributs et d'indices sont modifiés
+     */
+    void optimizeVertexFetch(Mesh* mesh);
+
+    /**
+     * enchaîne les trois optimisations sur le maillage
+     * @param mesh : maillage à optimiser
+     * @param verbose : si true, affiche ACMR et ATVR avant et après
+     */
+    void optimize(Mesh* mesh, bool verbose=true);
+}
+
+#endif
@@ -0,0 +1,235 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+
+#include <utils.h>
+#include <MeshSimplifier.h>
+#include <HalfEdgeMesh.h>
+
+
+namespace MeshSimplifier
+{
+
+/**
+ * Quadrique d'erreur : somme pondérée des carrés des distances à un ensemble de plans,
+ * matrice 4x4 symétrique dont on ne garde que les 10 coefficients distincts
+ */
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+    /// somme des poids (surfaces) des plans
+    double weight;
+
+    Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+    /** ajoute le plan ax+by+cz+d=0, (a,b,c) normé, avec le poids w */
+    void addPlane(double a, double b, double c, double d, double w)
+    {
+        a2 += w*a*a; ab += w*a*b; ac += w*a*c; ad += w*a*d;
+        b2 += w*b*b; bc += w*b*c; bd += w*b*d;
+        c2 += w*c*c; cd += w*c*d;
+        d2 += w*d*d;
+        weight += w;
+    }
+
+    void add(const Quadric& other)
+    {
+        a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+        b2 += other.b2; bc += other.bc; bd += other.bd;
+        c2 += other.c2; cd += other.cd;
+        d2 += other.d2;
+        weight += other.weight;
+    }
+
+    /** retourne la somme pondérée des carrés des distances du point aux plans */
+    double evaluate(vec3 p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        double error =
+            a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x +
+            b2*y*y + 2*bc*y*z + 2*bd*y +
+            c2*z*z + 2*cd*z +
+            d2;
+        return std::max(error, 0.0);
+    }
+};
+
+
+/**
+ * Fusion candidate : le sommet from rejoint le sommet to. Les versions permettent
+ * d'ignorer les candidats dont l'un des sommets a changé depuis leur calcul.
+ */
+struct Collapse
+{
+    float error;
+    GLuint from, to;
+    unsigned versionfrom, versionto;
+
+    bool operator>(const Collapse& other) const
+    {
+        return error > other.error;
+    }
+};
+
+
+/**
+ * calcule le vecteur normal (non normé) du triangle abc
+ */
+static void triangleNormal(vec3& normal, const vec3& a, const vec3& b, const vec3& c)
+{
+    vec3 ab = vec3::create();
+    vec3 ac = vec3::create();
+    vec3::subtract(ab, b, a);
+    vec3::subtract(ac, c, a);
+    vec3::cross(normal, ab, ac);
+}
+
+
+/**
+ * simplifie la liste de triangles jusqu'à atteindre le nombre de triangles demandé,
+ * ou moins si plus aucune fusion n'est possible
+ * @param indices : numéros des sommets, 3 par triangle
+ * @param coords : coordonnées des sommets
+ * @param targettrianglecount : nombre de triangles souhaité
+ * @param result : numéros des sommets des triangles restants, 3 par triangle
+ * @return erreur géométrique de la simplification : plus grande distance estimée entre
+ * la surface simplifiée et la surface d'origine, dans l'unité des coordonnées
+ */
+float simplify(const std::vector<GLuint>& indices, const std::vector<vec3>& coords, size_t targettrianglecount, std::vector<GLuint>& result)
+{
+    const size_t vertexcount = coords.size();
+    const size_t trianglecount = indices.size() / 3;
+    std::vector<GLuint> triangles(indices);
+
+    // triangles de chaque sommet, les triangles supprimés y restent mais sont marqués
+    std::vector<std::vector<int>> vertextriangles(vertexcount);
+    std::vector<bool> removed(trianglecount, false);
+    for (size_t i=0; i<triangles.size(); i++) vertextriangles[triangles[i]].push_back(i / 3);
+
+    // quadriques des sommets : plans des triangles qui les contiennent, pondérés par leur surface
+    std::vector<Quadric> quadrics(vertexcount);
+    vec3 normal = vec3::create();
+    for (size_t t=0; t<trianglecount; t++) {
+        const vec3& A = coords[triangles[3*t]];
+        triangleNormal(normal, A, coords[triangles[3*t+1]], coords[triangles[3*t+2]]);
+        double length = vec3::length(normal);
+        if (length <= 0.0) continue;
+        double a = normal[0]/length, b = normal[1]/length, c = normal[2]/length;
+        double d = -vec3::dot(normal, A)/length;
+        for (int k=0; k<3; k++) quadrics[triangles[3*t+k]].addPlane(a, b, c, d, length * 0.5);
+    }
+
+    // sommets bloqués : ceux d'une arête sans triangle de l'autre côté (bord ou couture)
+    HalfEdgeMesh topology(indices, vertexcount);
+    std::vector<bool> locked(vertexcount, false);
+    for (int h=0; h<topology.getHalfEdgeCount(); h++) {
+        if (topology.isBoundary(h)) {
+            locked[topology.getOrigin(h)] = true;
+            locked[topology.getTarget(h)] = true;
+        }
+    }
+
+    // file de priorité des fusions candidates, la moins coûteuse d'abord
+    std::vector<unsigned> versions(vertexcount, 0);
+    std::vector<bool> alive(vertexcount, true);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> candidates;
+    auto push = [&](GLuint from, GLuint to) {
+        if (locked[from] || from == to) return;
+        Quadric quadric = quadrics[from];
+        quadric.add(quadrics[to]);
+        float error = quadric.weight > 0.0 ? quadric.evaluate(coords[to]) / quadric.weight : 0.0;
+        candidates.push(Collapse{error, from, to, versions[from], versions[to]});
+    };
+    for (size_t t=0; t<trianglecount; t++) {
+        for (int k=0; k<3; k++) {
+            GLuint a = triangles[3*t+k], b = triangles[3*t+(k+1)%3];
+            push(a, b);
+            push(b, a);
+        }
+    }
+
+    // fusions successives
+    size_t remaining = trianglecount;
+    float maxerror = 0.0f;
+    vec3 before = vec3::create(), after = vec3::create();
+    std::vector<GLuint> neighbours;
+    while (remaining > targettrianglecount && ! candidates.empty()) {
+        Collapse collapse = candidates.top();
+        candidates.pop();
+        const GLuint u = collapse.from, v = collapse.to;
+        if (! alive[u] || ! alive[v] || versions[u] != collapse.versionfrom || versions[v] != collapse.versionto) continue;
+
+        // l'arête existe-t-elle encore, et la fusion ne retourne-t-elle aucun triangle ?
+        bool adjacent = false, valid = true;
+        for (int t: vertextriangles[u]) {
+            if (removed[t]) continue;
+            GLuint* corners = &triangles[3*t];
+            if (corners[0] == v || corners[1] == v || corners[2] == v) {
+                adjacent = true;
+                continue;
+            }
+            triangleNormal(before, coords[corners[0]], coords[corners[1]], coords[corners[2]]);
+            const vec3& A = coords[corners[0] == u ? v : corners[0]];
+            const vec3& B = coords[corners[1] == u ? v : corners[1]];
+            const vec3& C = coords[corners[2] == u ? v : corners[2]];
+            triangleNormal(after, A, B, C);
+            if (vec3::dot(before, after) <= 0.0f) {
+                valid = false;
+                break;
+            }
+        }
+        if (! adjacent || ! valid) continue;
+
+        // fusion de u dans v : les triangles contenant les deux disparaissent, les autres passent à v
+        for (int t: vertextriangles[u]) {
+            if (removed[t]) continue;
+            GLuint* corners = &triangles[3*t];
+            if (corners[0] == v || corners[1] == v || corners[2] == v) {
+                removed[t] = true;
+                remaining--;
+                continue;
+            }
+            for (int k=0; k<3; k++) {
+                if (corners[k] == u) corners[k] = v;
+            }
+            vertextriangles[v].push_back(t);
+        }
+        alive[u] = false;
+        std::vector<int>().swap(vertextriangles[u]);
+        quadrics[v].add(quadrics[u]);
+        versions[v]++;
+        maxerror = std::max(maxerror, collapse.error);
+
+        // nouveaux candidats autour de v, les anciens sont périmés par la version de v
+        std::vector<int>& vtriangles = vertextriangles[v];
+        vtriangles.erase(std::remove_if(vtriangles.begin(), vtriangles.end(), [&removed](int t) { return removed[t]; }), vtriangles.end());
+        neighbours.clear();
+        for (int t: vtriangles) {
+            for (int k=0; k<3; k++) {
+                GLuint w = triangles[3*t+k];
+                if (w != v && std::find(neighbours.begin(), neighbours.end(), w) == neighbours.end()) neighbours.push_back(w);
+            }
+        }
+        for (GLuint w: neighbours) {
+            push(v, w);
+            push(w, v);
+        }
+    }
+
+    // triangles restants
+    result.clear();
+    result.reserve(remaining * 3);
+    for (size_t t=0; t<trianglecount; t++) {
+        if (removed[t]) continue;
+        result.insert(result.end(), triangles.begin() + 3*t, triangles.begin() + 3*t + 3);
+    }
+    return sqrtf(maxerror);
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef LIBS_MESHSIMPLIFIER_H
+#define LIBS_MESHSIMPLIFIER_H
+
+// Simplification de maillage par fusion d'arêtes
+
+#include <vector>
+
+#include <gl-matrix.h>
+#include <utils.h>
+
+
+/**
+ * Simplification d'un maillage par fusions successives d'arêtes, guidées par l'erreur
+ * quadrique de Garland et Heckbert. Les fusions se font toujours sur l'un des deux sommets
+ * de l'arête : les sommets ne sont pas déplacés et le résultat n'est qu'une nouvelle liste
+ * d'indices sur les mêmes sommets, qui peut donc partager les VBOs d'attributs du maillage.
+ * Les sommets situés sur un bord (bord du maillage ou couture de texture, là où les sommets
+ * sont dédoublés) ne sont jamais déplacés, pour ne pas ouvrir de fentes ni décaler les textures.
+ */
+namespace MeshSimplifier
+{
+    /**
+     * simplifie la liste de triangles jusqu'à atteindre le nombre de triangles demandé,
+     * ou moins si plus aucune fusion n'est possible
+     * @param indices : numéros des sommets, 3 par triangle
+     * @param coords : coordonnées des sommets
+     * @param targettrianglecount : nombre de triangles souhaité
+     * @param result : numéros des sommets des triangles restants, 3 par triangle
+     * @return erreur géométrique de la simplification : plus grande distance estimée entre
+     * la surface simplifiée et la surface d'origine, dans l'unité des coordonnées
+     */
+    float simplify(const std::vector<GLuint>& indices, const std::vector<vec3>& coords, size_t targettrianglecount, std::vector<GLuint>& result);
+}
+
+#endif
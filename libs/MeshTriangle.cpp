@@ -16,88 +16,76 @@ using namespace mesh;
 
 
 /**
- * Constructeur de la classe Triangle à partir de trois sommets
- * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
- * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
- * @param mesh : maillage dans lequel on rajoute ce triangle
- * @param v0 : l'un des coins du triangle, nullptr si création manuelle
- * @param v1 : l'un des coins du triangle, nullptr si création manuelle
- * @param v2 : l'un des coins du triangle, nullptr si création manuelle
+ * Constructeur de la classe Triangle qui désigne un triangle du maillage.
+ * Employer Mesh::addTriangle pour créer un nouveau triangle, ou Mesh::getTriangle
+ * pour désigner un triangle existant.
+ * @param mesh : maillage d'appartenance du triangle
+ * @param slot : emplacement du triangle dans la table des poignées du maillage
+ * @param generation : génération de cet emplacement
  */
-Triangle::Triangle(Mesh* mesh, Vertex* v0, Vertex* v1, Vertex* v2)
+Triangle::Triangle(Mesh* mesh, long slot, uint32_t generation)
 {
-    // tableau des sommets
-    m_Vertices[0] = v0;
-    m_Vertices[1] = v1;
-    m_Vertices[2] = v2;
-
-    // liens entre triangle et mesh
-    if (mesh != nullptr) mesh->pushTriangle(this);
-    m_Mesh = mesh;
-
-    // vecteur normal non normalisé, il est proportionnel à la surface du triangle
-    m_Normal = vec3::create();
-
-    // vecteur tangent, idem
-    m_Tangent = vec3::create();
+    m_Mesh       = mesh;
+    m_Slot       = slot;
+    m_Generation = generation;
 }
 
 
 /**
- * Cette méthode supprime ce triangle du maillage en mettant à jour toutes
- * les listes. Cela peut supprimer des arêtes et rendre des sommets isolés.
+ * retourne le numéro actuel de ce triangle dans le maillage, il change quand
+ * le maillage est compacté (Mesh::compact)
+ * @return numéro du triangle, -1 s'il a été supprimé
  */
-Triangle::~Triangle()
+long Triangle::getIndex() const
 {
-    // supprimer ce triangle de la liste du maillage
-    if (m_Mesh != nullptr) m_Mesh->popTriangle(this);
-    m_Mesh = nullptr;
+    if (m_Mesh == nullptr) return -1;
+    return m_Mesh->m_TriangleSlots.getPosition(m_Slot, m_Generation);
 }
 
 
 /**
- * réaffecte le mesh de ce triangle
+ * indique si ce triangle désigne bien un triangle existant, dont aucun sommet n'a été supprimé
  */
-void Triangle::setMesh(Mesh* mesh)
+bool Triangle::isValid() const
 {
-    m_Mesh = mesh;
+    const long index = getIndex();
+    if (index < 0) return false;
+
+    // un sommet supprimé par Mesh::delVertex emporte le triangle au prochain compactage
+    const std::vector<long>& vertexslots = m_Mesh->m_VertexSlots.slots;
+    for (int k=0; k<3; k++) {
+        const size_t vertex = m_Mesh->m_Indices[index*3 + k];
+        if (vertex < vertexslots.size() && vertexslots[vertex] < 0) return false;
+    }
+    return true;
 }
 
 
 /**
- * retourne le sommet n°n (0..2) du triangle, ou nullptr si n n'est pas correct
+ * retourne le sommet n°n (0..2) du triangle, ou un sommet invalide si n n'est pas correct
  * @param n : numéro 0..2 du sommet
- * @return le sommet demandé ou nullptr si n n'est pas dans les bornes
+ * @return le sommet demandé, voir Vertex::isValid
  */
-Vertex* Triangle::getVertex(int n)
+Vertex Triangle::getVertex(int n)
 {
-    if (n < 0 || n > 2) return nullptr;
-    return m_Vertices[n];
+    if (n < 0 || n > 2 || ! isValid()) return Vertex();
+    return m_Mesh->makeVertex(m_Mesh->m_Indices[getIndex()*3 + n]);
 }
 
 
 /**
- * retourne la valeur de la normale
- * @see #calcNormale pour la calculer auparavant
+ * calcule et retourne la normale du triangle, non normalisée : sa norme est
+ * proportionnelle à la surface du triangle
  * @return normale du triangle
  */
-//vec3 Triangle::getNormal();
-
-
-/**
- * recalcule les informations géométriques du triangle : centre, normale, surface...
- */
-void Triangle::computeNormal()
+vec3 Triangle::getNormal()
 {
-    // les trois sommets
-    Vertex* A = m_Vertices[0];
-    Vertex* B = m_Vertices[1];
-    Vertex* C = m_Vertices[2];
-
     // les coordonnées des trois sommets
-    vec3 cA = A->getCoords();
-    vec3 cB = B->getCoords();
-    vec3 cC = C->getCoords();
+    const GLuint* indices = &m_Mesh->m_Indices[getIndex()*3];
+    std::vector<vec3>& coords = m_Mesh->m_Coords;
+    vec3& cA = coords[indices[0]];
+    vec3& cB = coords[indices[1]];
+    vec3& cC = coords[indices[2]];
 
     // vecteurs AB et AC
     vec3 cAB = vec3::create();
@@ -106,32 +94,24 @@ void Triangle::computeNormal()
     vec3::subtract(cAC, cC, cA);
 
     // calculer le vecteur normal
-    vec3::cross(m_Normal, cAB, cAC);
+    vec3 normal = vec3::create();
+    vec3::cross(normal, cAB, cAC);
+    return normal;
 }
 
 
 /**
- * retourne la valeur de la tangente
- * @see #calcTangente pour la calculer auparavant
- * @return tangente du triangle
- */
-//vec3 Triangle::getTangent();
-
-
-/**
- * recalcule la tangente du triangle à l'aide de la normale et des coordonnées de texture
+ * calcule et retourne la tangente du triangle à l'aide des coordonnées de texture
+ * @return tangente normalisée du triangle
  */
-void Triangle::computeTangent()
+vec3 Triangle::getTangent()
 {
-    // les trois sommets
-    Vertex* A = m_Vertices[0];
-    Vertex* B = m_Vertices[1];
-    Vertex* C = m_Vertices[2];
-
     // les coordonnées des trois sommets
-    vec3 cA = A->getCoords();
-    vec3 cB = B->getCoords();
-    vec3 cC = C->getCoords();
+    const GLuint* indices = &m_Mesh->m_Indices[getIndex()*3];
+    std::vector<vec3>& coords = m_Mesh->m_Coords;
+    vec3& cA = coords[indices[0]];
+    vec3& cB = coords[indices[1]];
+    vec3& cC = coords[indices[2]];
 
     // vecteurs AB et AC
     vec3 cAB = vec3::create();
@@ -140,9 +120,10 @@ void Triangle::computeTangent()
     vec3::subtract(cAC, cC, cA);
 
     // récupération de leur 2e coordonnée de texture
-    float tA = A->getTexCoords()[1];
-    float tB = B->getTexCoords()[1];
-    float tC = C->getTexCoords()[1];
+    std::vector<vec2>& texcoords = m_Mesh->m_TexCoords;
+    float tA = texcoords[indices[0]][1];
+    float tB = texcoords[indices[1]][1];
+    float tC = texcoords[indices[2]][1];
 
     // vecteurs dans l'espace (s,t), et uniquement la coordonnée t
     float tAB = tB - tA;
@@ -151,12 +132,14 @@ void Triangle::computeTangent()
     // TODO s'il n'y a pas de coordonnées de texture, alors tAB et tAC sont nuls, les remplacer par AB et AC
 
     // calcul de la tangente
+    vec3 tangent = vec3::create();
     vec3::scale(cAB, cAB, tAC);
     vec3::scale(cAC, cAC, tAB);
-    vec3::subtract(m_Tangent, cAB, cAC);
+    vec3::subtract(tangent, cAB, cAC);
 
     // normalisation
-    vec3::normalize(m_Tangent, m_Tangent);
+    vec3::normalize(tangent, tangent);
+    return tangent;
 }
 
 
@@ -165,10 +148,12 @@ void Triangle::computeTangent()
  * @param vertex : sommet dont il faut vérifier l'appartenance à this
  * @return true si ok, false si le sommet est absent du triangle
  */
-bool Triangle::containsVertex(Vertex* vertex)
+bool Triangle::containsVertex(const Vertex& vertex)
 {
-    if (m_Vertices[0] == vertex) return true;
-    if (m_Vertices[1] == vertex) return true;
-    if (m_Vertices[2] == vertex) return true;
+    if (vertex.getMesh() != m_Mesh) return false;
+    const GLuint* indices = &m_Mesh->m_Indices[getIndex()*3];
+    if ((long) indices[0] == vertex.getIndex()) return true;
+    if ((long) indices[1] == vertex.getIndex()) return true;
+    if ((long) indices[2] == vertex.getIndex()) return true;
     return false;
 }
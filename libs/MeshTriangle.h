@@ -8,6 +8,7 @@
 #include <map>
 #include <list>
 #include <string>
+#include <stdint.h>
 
 #include <gl-matrix.h>
 #include <utils.h>
@@ -17,7 +18,10 @@
 namespace mesh {
 
     /**
-     * Cette classe représente l'un des triangles d'un maillage
+     * Cette classe désigne l'un des triangles d'un maillage. Ce n'est qu'une poignée : le maillage,
+     * l'emplacement du triangle dans sa table des poignées et la génération de cet emplacement,
+     * comme Vertex. Les numéros de ses sommets sont rangés dans le tableau Mesh::getIndices,
+     * aux positions 3*n, 3*n+1 et 3*n+2 où n = getIndex().
      */
     class Triangle
     {
@@ -26,81 +30,91 @@ namespace mesh {
         /// maillage d'appartenance du triangle
         Mesh* m_Mesh;
 
-        // sommets
-        Vertex* m_Vertices[3];
+        /// emplacement du triangle dans la table des poignées du maillage
+        long m_Slot;
 
-        // attributs de triangle
-        vec3 m_Normal;
-        vec3 m_Tangent;
+        /// génération de l'emplacement quand la poignée a été créée
+        uint32_t m_Generation;
 
 
     public:
 
-         /**
-         * Constructeur de la classe Triangle à partir de trois sommets
-         * NB: l'ordre de rotation des sommets est crucial pour le calcul des normales.
-         * Il faut tourner dans le sens trigonométrique, comme dans OpenGL.
-         * @param maillage : maillage dans lequel on rajoute ce triangle
-         * @param v0 : l'un des coins du triangle, nullptr si création manuelle
-         * @param v1 : l'un des coins du triangle, nullptr si création manuelle
-         * @param v2 : l'un des coins du triangle, nullptr si création manuelle
+        /**
+         * Constructeur de la classe Triangle qui désigne un triangle du maillage.
+         * Employer Mesh::addTriangle pour créer un nouveau triangle, ou Mesh::getTriangle
+         * pour désigner un triangle existant.
+         * @param mesh : maillage d'appartenance du triangle
+         * @param slot : emplacement du triangle dans la table des poignées du maillage
+         * @param generation : génération de cet emplacement
          */
-        Triangle(Mesh* mesh, Vertex* v0, Vertex* v1, Vertex* v2);
+        Triangle(Mesh* mesh=nullptr, long slot=-1, uint32_t generation=0);
 
         /**
-         * Cette méthode supprime ce triangle du maillage en mettant à jour toutes
-         * les listes. Cela peut supprimer des arêtes et rendre des sommets isolés.
+         * retourne le maillage de ce triangle
          */
-        virtual ~Triangle();
+        Mesh* getMesh() const
+        {
+            return m_Mesh;
+        }
 
         /**
-         * retourne le sommet n°n (0..2) du triangle, ou nullptr si n n'est pas correct
-         * @param n : numéro 0..2 du sommet
-         * @return le Vertex() demandé ou nullptr si n n'est pas dans les bornes
+         * retourne le numéro actuel de ce triangle dans le maillage, il change quand
+         * le maillage est compacté (Mesh::compact)
+         * @return numéro du triangle, -1 s'il a été supprimé
          */
-        Vertex* getVertex(int n);
+        long getIndex() const;
 
         /**
-         * réaffecte le mesh de ce triangle
+         * retourne l'emplacement de ce triangle dans la table des poignées, il ne change pas
          */
-        void setMesh(Mesh* mesh);
+        long getSlot() const
+        {
+            return m_Slot;
+        }
 
         /**
-         * retourne la valeur de la normale
-         * @see #calcNormal pour la calculer auparavant
-         * @return normale du triangle
+         * compare deux triangles
          */
-        vec3 getNormal()
+        bool operator==(const Triangle& other) const
+        {
+            return m_Mesh == other.m_Mesh && m_Slot == other.m_Slot && m_Generation == other.m_Generation;
+        }
+        bool operator!=(const Triangle& other) const
         {
-            return m_Normal;
+            return !(*this == other);
         }
 
         /**
-         * recalcule les informations géométriques du triangle : centre, normale, surface...
+         * indique si ce triangle désigne bien un triangle existant, dont aucun sommet n'a été supprimé
          */
-        void computeNormal();
+        bool isValid() const;
 
         /**
-         * retourne la valeur de la tangente
-         * @see #calcTangente pour la calculer auparavant
-         * @return tangente du triangle
+         * retourne le sommet n°n (0..2) du triangle, ou un sommet invalide si n n'est pas correct
+         * @param n : numéro 0..2 du sommet
+         * @return le Vertex() demandé, voir Vertex::isValid
          */
-        vec3 getTangent()
-        {
-            return m_Tangent;
-        }
+        Vertex getVertex(int n);
+
+        /**
+         * calcule et retourne la normale du triangle, non normalisée : sa norme est
+         * proportionnelle à la surface du triangle
+         * @return normale du triangle
+         */
+        vec3 getNormal();
 
         /**
-         * recalcule la tangente du triangle à l'aide de la normale et des coordonnées de texture
+         * calcule et retourne la tangente du triangle à l'aide des coordonnées de texture
+         * @return tangente normalisée du triangle
          */
-        void computeTangent();
+        vec3 getTangent();
 
         /**
          * Cette méthode indique si le triangle this contient le sommet indiqué
          * @param vertex : sommet dont il faut vérifier l'appartenance à this
          * @return true si ok, false si le sommet est absent du triangle
          */
-        bool containsVertex(Vertex* vertex);
+        bool containsVertex(const Vertex& vertex);
     };
 }
 
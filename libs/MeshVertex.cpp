@@ -16,82 +16,39 @@ using namespace mesh;
 
 
 /**
- * Constructeur de la classe Vertex qui représente un sommet dans
- * le maillage. Initialise un sommet non connecté au maillage, employer
- * Mesh.addVertex pour l'insérer puis new Triangle(...) pour le mettre
- * dans un triangle, setCoords et setColor pour lui donner des coordonnées et
- * des couleurs.
+ * Constructeur de la classe Vertex qui désigne un sommet du maillage.
+ * Employer Mesh::addVertex pour créer un nouveau sommet, ou Mesh::getVertex
+ * pour désigner un sommet existant.
  * @param mesh : maillage d'appartenance de ce sommet
- * @param name : nom du sommet à créer
+ * @param slot : emplacement du sommet dans la table des poignées du maillage
+ * @param generation : génération de cet emplacement
  */
-Vertex::Vertex(Mesh* mesh, vec3 xyz)
+Vertex::Vertex(Mesh* mesh, long slot, uint32_t generation)
 {
-    // attributs de sommet
-    m_Index     = -1;
-    vec3::copy(m_Coords, xyz);
-    m_Color     = vec3::fromValues(1, 0, 1);
-    m_TexCoords = vec2::create();
-    m_Normal    = vec3::create();
-    m_Tangent   = vec3::create();
-
-    // liens entre sommet et mesh
-    mesh->pushVertex(this);
-    m_Mesh = mesh;
-}
-Vertex::Vertex(Mesh* mesh, float x, float y, float z)
-{
-    // attributs de sommet
-    m_Index     = -1;
-    m_Coords    = vec3::fromValues(x,y,z);
-    m_Color     = vec3::fromValues(1, 0, 1);
-    m_TexCoords = vec2::create();
-    m_Normal    = vec3::create();
-    m_Tangent   = vec3::create();
-
-    // liens entre sommet et mesh
-    mesh->pushVertex(this);
-    m_Mesh = mesh;
-}
-Vertex::Vertex(Mesh* mesh, double x, double y, double z)
-{
-    // attributs de sommet
-    m_Index     = -1;
-    m_Coords    = vec3::fromValues(x,y,z);
-    m_Color     = vec3::fromValues(1, 0, 1);
-    m_TexCoords = vec2::create();
-    m_Normal    = vec3::create();
-    m_Tangent   = vec3::create();
-
-    // liens entre sommet et mesh
-    mesh->pushVertex(this);
-    m_Mesh = mesh;
-}
-
-
-/** destructeur */
-Vertex::~Vertex()
-{
-    // supprimer ce sommet de la liste du maillage
-    if (m_Mesh != nullptr) m_Mesh->popVertex(this);
-    m_Mesh = nullptr;
+    m_Mesh       = mesh;
+    m_Slot       = slot;
+    m_Generation = generation;
 }
 
 
 /**
- * réaffecte le mesh de ce sommet
+ * retourne le numéro actuel de ce sommet dans les tableaux du maillage, il change quand
+ * le maillage est compacté (Mesh::compact)
+ * @return numéro du sommet, -1 s'il n'est pas valide
  */
-void Vertex::setMesh(Mesh* mesh)
+long Vertex::getIndex() const
 {
-    m_Mesh = mesh;
+    if (m_Mesh == nullptr) return -1;
+    return m_Mesh->m_VertexSlots.getPosition(m_Slot, m_Generation);
 }
 
 
 /**
- * réaffecte le numéro de ce sommet
+ * indique si ce sommet désigne bien un sommet existant
  */
-void Vertex::setIndex(long index)
+bool Vertex::isValid() const
 {
-    m_Index = index;
+    return getIndex() >= 0;
 }
 
 
@@ -100,20 +57,25 @@ void Vertex::setIndex(long index)
  * @param xyz coordonnées
  * @return this pour pouvoir chaîner les affectations
  */
-Vertex* Vertex::setCoords(vec3 xyz)
+Vertex& Vertex::setCoords(vec3 xyz)
 {
-    vec3::copy(m_Coords, xyz);
-    return this;
+    vec3::copy(getCoords(), xyz);
+    m_Mesh->markDirty(VertexFormat::COORDS, getIndex());
+    return *this;
 }
-Vertex* Vertex::setCoords(float x, float y, float z)
+Vertex& Vertex::setCoords(float x, float y, float z)
 {
-    m_Coords[0] = x; m_Coords[1] = y; m_Coords[2] = z;
-    return this;
+    vec3& coords = getCoords();
+    coords[0] = x; coords[1] = y; coords[2] = z;
+    m_Mesh->markDirty(VertexFormat::COORDS, getIndex());
+    return *this;
 }
-Vertex* Vertex::setCoords(double x, double y, double z)
+Vertex& Vertex::setCoords(double x, double y, double z)
 {
-    m_Coords[0] = x; m_Coords[1] = y; m_Coords[2] = z;
-    return this;
+    vec3& coords = getCoords();
+    coords[0] = x; coords[1] = y; coords[2] = z;
+    m_Mesh->markDirty(VertexFormat::COORDS, getIndex());
+    return *this;
 }
 
 
@@ -121,7 +83,10 @@ Vertex* Vertex::setCoords(double x, double y, double z)
  * retourne les coordonnées du sommet
  * @return coordonnées 3D du sommet
  */
-//vec3& Vertex::getCoords();
+vec3& Vertex::getCoords()
+{
+    return m_Mesh->m_Coords[getIndex()];
+}
 
 
 /**
@@ -129,20 +94,25 @@ Vertex* Vertex::setCoords(double x, double y, double z)
  * @param rgba couleur (r,g,b,a)
  * @return this pour pouvoir chaîner les affectations
  */
-Vertex* Vertex::setColor(vec3 rgba)
+Vertex& Vertex::setColor(vec3 rgba)
 {
-    vec3::copy(m_Color, rgba);
-    return this;
+    vec3::copy(getColor(), rgba);
+    m_Mesh->markDirty(VertexFormat::COLOR, getIndex());
+    return *this;
 }
-Vertex* Vertex::setColor(float r, float g, float b)
+Vertex& Vertex::setColor(float r, float g, float b)
 {
-    m_Color[0] = r; m_Color[1] = g; m_Color[2] = b;
-    return this;
+    vec3& color = getColor();
+    color[0] = r; color[1] = g; color[2] = b;
+    m_Mesh->markDirty(VertexFormat::COLOR, getIndex());
+    return *this;
 }
-Vertex* Vertex::setColor(double r, double g, double b)
+Vertex& Vertex::setColor(double r, double g, double b)
 {
-    m_Color[0] = r; m_Color[1] = g; m_Color[2] = b;
-    return this;
+    vec3& color = getColor();
+    color[0] = r; color[1] = g; color[2] = b;
+    m_Mesh->markDirty(VertexFormat::COLOR, getIndex());
+    return *this;
 }
 
 
@@ -150,7 +120,10 @@ Vertex* Vertex::setColor(double r, double g, double b)
  * retourne la couleur du sommet
  * @return couleur (r,g,b)
  */
-//vec3& Vertex::getColor();
+vec3& Vertex::getColor()
+{
+    return m_Mesh->m_Colors[getIndex()];
+}
 
 
 /**
@@ -158,20 +131,25 @@ Vertex* Vertex::setColor(double r, double g, double b)
  * @param normal : normale à affecter
  * @return this pour pouvoir chaîner les affectations
  */
-Vertex* Vertex::setNormal(vec3 normal)
+Vertex& Vertex::setNormal(vec3 normal)
 {
-    vec3::copy(m_Normal, normal);
-    return this;
+    vec3::copy(getNormal(), normal);
+    m_Mesh->markDirty(VertexFormat::NORMAL, getIndex());
+    return *this;
 }
-Vertex* Vertex::setNormal(float x, float y, float z)
+Vertex& Vertex::setNormal(float x, float y, float z)
 {
-    m_Normal[0] = x; m_Normal[1] = y; m_Normal[2] = z;
-    return this;
+    vec3& normal = getNormal();
+    normal[0] = x; normal[1] = y; normal[2] = z;
+    m_Mesh->markDirty(VertexFormat::NORMAL, getIndex());
+    return *this;
 }
-Vertex* Vertex::setNormal(double x, double y, double z)
+Vertex& Vertex::setNormal(double x, double y, double z)
 {
-    m_Normal[0] = x; m_Normal[1] = y; m_Normal[2] = z;
-    return this;
+    vec3& normal = getNormal();
+    normal[0] = x; normal[1] = y; normal[2] = z;
+    m_Mesh->markDirty(VertexFormat::NORMAL, getIndex());
+    return *this;
 }
 
 
@@ -179,14 +157,20 @@ Vertex* Vertex::setNormal(double x, double y, double z)
  * retourne la normale du sommet
  * @return normale
  */
-//vec3& Vertex::getNormal();
+vec3& Vertex::getNormal()
+{
+    return m_Mesh->m_Normals[getIndex()];
+}
 
 
 /**
  * retourne la tangente du sommet
  * @return tangente
  */
-//vec3& Vertex::getTangent();
+vec3& Vertex::getTangent()
+{
+    return m_Mesh->m_Tangents[getIndex()];
+}
 
 
 /**
@@ -194,20 +178,25 @@ Vertex* Vertex::setNormal(double x, double y, double z)
  * @param uv coordonnées de texture
  * @return this pour pouvoir chaîner les affectations
  */
-Vertex* Vertex::setTexCoords(vec2 uv)
+Vertex& Vertex::setTexCoords(vec2 uv)
 {
-    vec2::copy(m_TexCoords, uv);
-    return this;
+    vec2::copy(getTexCoords(), uv);
+    m_Mesh->markDirty(VertexFormat::TEXCOORDS, getIndex());
+    return *this;
 }
-Vertex* Vertex::setTexCoords(float u, float v)
+Vertex& Vertex::setTexCoords(float u, float v)
 {
-    m_TexCoords[0] = u; m_TexCoords[1] = v;
-    return this;
+    vec2& texcoords = getTexCoords();
+    texcoords[0] = u; texcoords[1] = v;
+    m_Mesh->markDirty(VertexFormat::TEXCOORDS, getIndex());
+    return *this;
 }
-Vertex* Vertex::setTexCoords(double u, double v)
+Vertex& Vertex::setTexCoords(double u, double v)
 {
-    m_TexCoords[0] = u; m_TexCoords[1] = v;
-    return this;
+    vec2& texcoords = getTexCoords();
+    texcoords[0] = u; texcoords[1] = v;
+    m_Mesh->markDirty(VertexFormat::TEXCOORDS, getIndex());
+    return *this;
 }
 
 
@@ -215,7 +204,10 @@ Vertex* Vertex::setTexCoords(double u, double v)
  * retourne les coordonnées de texture du sommet
  * @return coordonnées de texture
  */
-//vec2& Vertex::getTexCoords();
+vec2& Vertex::getTexCoords()
+{
+    return m_Mesh->m_TexCoords[getIndex()];
+}
 
 
 /**
@@ -224,19 +216,25 @@ Vertex* Vertex::setTexCoords(double u, double v)
  */
 void Vertex::computeNormal()
 {
+    // les triangles sont parcourus par leurs numéros : compacter avant de prendre les références
+    m_Mesh->compact();
+
     // calculer la moyenne des normales des triangles contenant ce sommet
-    vec3::zero(m_Normal);
+    vec3& normal = getNormal();
+    vec3::zero(normal);
 
     // parcourir tous les triangles du maillage et prendre en compte ceux qui contiennent this
-    for (Triangle* triangle: m_Mesh->getTriangleList()) {
-        if (triangle->containsVertex(this)) {
+    for (int it=0; it<m_Mesh->getTriangleCount(); it++) {
+        Triangle triangle = m_Mesh->getTriangle(it);
+        if (triangle.containsVertex(*this)) {
             // ajouter la normale du triangle courant, elle tient compte de la surface
-            vec3::add(m_Normal, m_Normal, triangle->getNormal());
+            vec3::add(normal, normal, triangle.getNormal());
         }
     }
 
     // normaliser le résultat
-    vec3::normalize(m_Normal, m_Normal);
+    vec3::normalize(normal, normal);
+    m_Mesh->markDirty(VertexFormat::NORMAL, getIndex());
 }
 
 
@@ -246,17 +244,23 @@ void Vertex::computeNormal()
  */
 void Vertex::computeTangent()
 {
+    // les triangles sont parcourus par leurs numéros : compacter avant de prendre les références
+    m_Mesh->compact();
+
     // calculer la moyenne des tangentes des triangles contenant ce sommet
-    vec3::zero(m_Tangent);
+    vec3& tangent = getTangent();
+    vec3::zero(tangent);
 
     // parcourir tous les triangles du maillage et prendre en compte ceux qui contiennent this
-    for (Triangle* triangle: m_Mesh->getTriangleList()) {
-        if (triangle->containsVertex(this)) {
-            // ajouter la normale du triangle courant, elle tient compte de la surface
-            vec3::add(m_Tangent, m_Tangent, triangle->getTangent());
+    for (int it=0; it<m_Mesh->getTriangleCount(); it++) {
+        Triangle triangle = m_Mesh->getTriangle(it);
+        if (triangle.containsVertex(*this)) {
+            // ajouter la tangente du triangle courant
+            vec3::add(tangent, tangent, triangle.getTangent());
         }
     }
 
     // normaliser le résultat
-    vec3::normalize(m_Tangent, m_Tangent);
+    vec3::normalize(tangent, tangent);
+    m_Mesh->markDirty(VertexFormat::TANGENT, getIndex());
 }
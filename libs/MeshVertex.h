@@ -7,6 +7,7 @@
 #include <map>
 #include <list>
 #include <string>
+#include <stdint.h>
 
 #include <gl-matrix.h>
 #include <utils.h>
@@ -18,63 +19,79 @@ namespace mesh {
 
 
     /**
-     * Cette classe représente un sommet dans le maillage.
+     * Cette classe désigne un sommet dans le maillage. Ce n'est qu'une poignée : le maillage,
+     * l'emplacement du sommet dans sa table des poignées et la génération de cet emplacement.
+     * Elle reste valable quand d'autres sommets sont supprimés, et devient invalide quand son
+     * sommet l'est (voir Mesh::SlotTable). Les attributs sont rangés dans les tableaux du maillage,
+     * voir Mesh::getCoords, Mesh::getNormals...
+     * NB: les références retournées par les getters ne sont valables que jusqu'au prochain
+     * ajout de sommet dans le maillage. Les setters signalent la modification au maillage
+     * (Mesh::markDirty), ce qui n'est pas le cas d'une modification au travers d'un getter.
      */
     class Vertex
     {
     private:
 
-        /// numéro du sommet dans les VBOs d'indices
-        long m_Index;
-
-        /// attributs du sommet
-        vec3 m_Coords;
-        vec3 m_Color;
-        vec2 m_TexCoords;
-        vec3 m_Normal;
-        vec3 m_Tangent;
-
         /// maillage d'appartenance de ce sommet
         Mesh* m_Mesh;
 
+        /// emplacement du sommet dans la table des poignées du maillage
+        long m_Slot;
+
+        /// génération de l'emplacement quand la poignée a été créée
+        uint32_t m_Generation;
 
 
     public:
 
         /**
-         * Constructeur de la classe Vertex qui représente un sommet dans
-         * le maillage. Initialise un sommet non connecté au maillage, employer
-         * Maillage.addVertex pour l'insérer puis new Triangle(...) pour le mettre
-         * dans un triangle, setCoord et setColor pour lui donner des coordonnées et
-         * des couleurs.
+         * Constructeur de la classe Vertex qui désigne un sommet du maillage.
+         * Employer Mesh::addVertex pour créer un nouveau sommet, ou Mesh::getVertex
+         * pour désigner un sommet existant.
          * @param mesh : maillage d'appartenance de ce sommet
-         * @param nom : nom du sommet à créer
+         * @param slot : emplacement du sommet dans la table des poignées du maillage
+         * @param generation : génération de cet emplacement
          */
-        Vertex(Mesh* mesh, vec3 xyz);
-        Vertex(Mesh* mesh, float x, float y, float z);
-        Vertex(Mesh* mesh, double x, double y, double z);
+        Vertex(Mesh* mesh=nullptr, long slot=-1, uint32_t generation=0);
 
         /**
-         * Destructeur de la classe Vertex
+         * retourne le maillage de ce sommet
          */
-        virtual ~Vertex();
+        Mesh* getMesh() const
+        {
+            return m_Mesh;
+        }
 
         /**
-         * réaffecte le mesh de ce sommet
+         * retourne le numéro actuel de ce sommet dans les tableaux du maillage, il change quand
+         * le maillage est compacté (Mesh::compact)
+         * @return numéro du sommet, -1 s'il n'est pas valide
          */
-        void setMesh(Mesh* mesh);
+        long getIndex() const;
 
         /**
-         * réaffecte le numéro de ce sommet
+         * retourne l'emplacement de ce sommet dans la table des poignées, il ne change pas
          */
-        void setIndex(long index);
+        long getSlot() const
+        {
+            return m_Slot;
+        }
 
         /**
-         * retourne le numéro de ce sommet
+         * indique si ce sommet désigne bien un sommet existant
          */
-        long getIndex()
+        bool isValid() const;
+
+        /**
+         * compare deux sommets
+         */
+        bool operator==(const Vertex& other) const
+        {
+            return m_Mesh == other.m_Mesh && m_Slot == other.m_Slot && m_Generation == other.m_Generation;
+        }
+        bool operator!=(const Vertex& other) const
         {
-            return m_Index;
+            return !(*this == other);
         }
 
         /**
@@ -82,18 +99,15 @@ namespace mesh {
          * @param xyz coordonnées
          * @return this pour pouvoir chaîner les affectations
          */
-        Vertex* setCoords(vec3 xyz);
-        Vertex* setCoords(float x, float y, float z);
-        Vertex* setCoords(double x, double y, double z);
+        Vertex& setCoords(vec3 xyz);
+        Vertex& setCoords(float x, float y, float z);
+        Vertex& setCoords(double x, double y, double z);
 
         /**
          * retourne les coordonnées du sommet
          * @return coordonnées 3D du sommet
          */
-        vec3& getCoords()
-        {
-            return m_Coords;
-        }
+        vec3& getCoords();
 
 
         /**
@@ -101,45 +115,36 @@ namespace mesh {
          * @param rgb couleur (r,g,b)
          * @return this pour pouvoir chaîner les affectations
          */
-        Vertex* setColor(vec3 rgb);
-        Vertex* setColor(float r, float g, float b);
-        Vertex* setColor(double r, double g, double b);
+        Vertex& setColor(vec3 rgb);
+        Vertex& setColor(float r, float g, float b);
+        Vertex& setColor(double r, double g, double b);
 
         /**
          * retourne la couleur du sommet
          * @return couleur (r,g,b)
          */
-        vec3& getColor()
-        {
-            return m_Color;
-        }
+        vec3& getColor();
 
         /**
          * définit les coordonnées de la normale du sommet
          * @param normal normale à affecter
          * @return this pour pouvoir chaîner les affectations
          */
-        Vertex* setNormal(vec3 normal);
-        Vertex* setNormal(float x, float y, float z);
-        Vertex* setNormal(double x, double y, double z);
+        Vertex& setNormal(vec3 normal);
+        Vertex& setNormal(float x, float y, float z);
+        Vertex& setNormal(double x, double y, double z);
 
         /**
          * retourne la normale du sommet
          * @return normale
          */
-        vec3& getNormal()
-        {
-            return m_Normal;
-        }
+        vec3& getNormal();
 
         /**
          * retourne la tangente du sommet
          * @return tangente
          */
-        vec3& getTangent()
-        {
-            return m_Tangent;
-        }
+        vec3& getTangent();
 
 
         /**
@@ -147,28 +152,27 @@ namespace mesh {
          * @param uv coordonnées de texture
          * @return this pour pouvoir chaîner les affectations
          */
-        Vertex* setTexCoords(vec2 uv);
-        Vertex* setTexCoords(float u, float v);
-        Vertex* setTexCoords(double u, double v);
+        Vertex& setTexCoords(vec2 uv);
+        Vertex& setTexCoords(float u, float v);
+        Vertex& setTexCoords(double u, double v);
 
         /**
          * retourne les coordonnées de texture du sommet
          * @return coordonnées de texture
          */
-        vec2& getTexCoords()
-        {
-            return m_TexCoords;
-        }
+        vec2& getTexCoords();
 
         /**
          * Cette méthode calcule la normale du sommet = moyenne des normales des
          * triangles contenant ce sommet.
+         * NB: elle parcourt tous les triangles, pour tout le maillage employer Mesh::computeNormals
          */
         void computeNormal();
 
         /**
          * Cette méthode calcule la tangente du sommet = moyenne des tangentes des
          * triangles contenant ce sommet.
+         * NB: elle parcourt tous les triangles, pour tout le maillage employer Mesh::computeTangents
          */
         void computeTangent();
     };
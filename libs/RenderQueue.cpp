@@ -0,0 +1,201 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <string.h>
+#include <algorithm>
+
+#include <utils.h>
+#include <Mesh.h>
+#include <Material.h>
+#include <RenderQueue.h>
+
+
+/** constructeur d'une file vide */
+RenderQueue::RenderQueue()
+{
+    m_Stats = Stats{0, 0, 0, 0};
+    m_StreamBuffer = nullptr;
+}
+
+
+/**
+ * vide la file, à appeler au début de chaque image ; la mémoire est gardée pour la suivante
+ */
+void RenderQueue::clear()
+{
+    m_Packets.clear();
+    m_Order.clear();
+}
+
+
+/**
+ * calcule la clé de tri d'un dessin : passe (4 bits), shader (12 bits), matériau (12 bits),
+ * texture (12 bits) puis profondeur (24 bits), du plus proche au plus lointain
+ * @param pass : passe du dessin
+ * @param material : matériau du dessin
+ * @param depth : distance de l'objet à la caméra
+ * @return clé de tri
+ */
+uint64_t RenderQueue::makeKey(Pass pass, Material* material, float depth)
+{
+    // un flottant positif a des bits dans le même ordre que sa valeur : on garde les 24 plus forts
+    float positive = std::max(depth, 0.0f);
+    uint32_t bits;
+    memcpy(&bits, &positive, sizeof(bits));
+
+    return ((uint64_t) (pass & 0xF) << 60)
+         | ((uint64_t) (material->getShaderId() & 0xFFF) << 48)
+         | ((uint64_t) (material->getId() & 0xFFF) << 36)
+         | ((uint64_t) (material->getTextureId() & 0xFFF) << 24)
+         | (uint64_t) (bits >> 7);
+}
+
+
+/**
+ * ajoute un dessin simple
+ * @param pass : passe du dessin
+ * @param mesh : maillage à dessiner
+ * @param material : matériau de ce dessin, celui des faces ou des arêtes du maillage
+ * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+ * @param level : niveau de détail des faces, voir Mesh::selectLod
+ */
+void RenderQueue::submit(Pass pass, Mesh* mesh, Material* material, const mat4& matVM, int level)
+{
+    // profondeur de l'origine de l'objet, la caméra regarde vers -z
+    mat4 matrix = matVM;
+    float depth = -matrix[14];
+
+    m_Order.push_back(SortItem{makeKey(pass, material, depth), (uint32_t) m_Packets.size()});
+    m_Packets.push_back(Packet{mesh, material, pass, level, matVM, -1, 0, 0});
+}
+
+
+/**
+ * ajoute le dessin de plusieurs exemplaires en un seul appel, voir Material::selectInstances
+ * @param pass : passe du dessin
+ * @param mesh : maillage à dessiner
+ * @param material : matériau de ce dessin, il doit employer Material::getInstancingFunctions
+ * @param matV : matrice de la caméra
+ * @param instancebuffer : VBO contenant les matrices de modèle, 16 GLfloat par exemplaire
+ * @param first : numéro du premier exemplaire dans ce VBO
+ * @param count : nombre d'exemplaires
+ * @param level : niveau de détail des faces, voir Mesh::selectLod
+ */
+void RenderQueue::submitInstances(Pass pass, Mesh* mesh, Material* material, const mat4& matV, GLint instancebuffer, size_t first, GLsizei count, int level)
+{
+    // les exemplaires sont dispersés, ils passent avant les dessins simples du même matériau
+    m_Order.push_back(SortItem{makeKey(pass, material, 0.0f), (uint32_t) m_Packets.size()});
+    m_Packets.push_back(Packet{mesh, material, pass, level, matV, instancebuffer, first, count});
+}
+
+
+/** trie m_Order par clé croissante, tri par base octet par octet, stable */
+void RenderQueue::sort()
+{
+    const size_t count = m_Order.size();
+    if (count < 2) return;
+    m_Scratch.resize(count);
+
+    for (int shift=0; shift<64; shift+=8) {
+        // nombre de clés pour chaque valeur de l'octet
+        size_t positions[256] = {0};
+        for (const SortItem& item: m_Order) positions[(item.key >> shift) & 0xFF]++;
+
+        // toutes les clés ont le même octet (ex: une seule passe) : rien à faire pour lui
+        if (positions[(m_Order[0].key >> shift) & 0xFF] == count) continue;
+
+        // position de départ de chaque valeur, puis distribution
+        size_t position = 0;
+        for (int digit=0; digit<256; digit++) {
+            const size_t number = positions[digit];
+            positions[digit] = position;
+            position += number;
+        }
+        for (const SortItem& item: m_Order) m_Scratch[positions[(item.key >> shift) & 0xFF]++] = item;
+        m_Order.swap(m_Scratch);
+    }
+}
+
+
+/**
+ * trie les dessins et les fait, sans refaire les liaisons qui n'ont pas changé depuis le dessin précédent
+ * @param matP : matrice de projection perpective
+ */
+void RenderQueue::execute(const mat4& matP)
+{
+    m_Stats = Stats{0, 0, 0, 0};
+    if (m_Packets.empty()) return;
+    sort();
+
+    // état OpenGL laissé par le dessin précédent
+    Material* material = nullptr;
+    GLint program = -1;
+    GLuint texture = 0;
+    Mesh* mesh = nullptr;
+    uint64_t layout = 0;
+    GLint boundindices = -1;
+    bool offset = false;
+
+    for (const SortItem& item: m_Order) {
+        Packet& packet = m_Packets[item.packet];
+
+        // décalage des polygones sous les arêtes
+        const bool packetoffset = packet.pass == PASS_FACES_OFFSET;
+        if (packetoffset != offset) {
+            if (packetoffset) {
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(1.0, 1.0);
+            } else {
+                glDisable(GL_POLYGON_OFFSET_FILL);
+            }
+            offset = packetoffset;
+        }
+
+        // shader
+        const bool programchanged = packet.material->getShaderId() != program;
+        if (programchanged) {
+            packet.material->bindProgram();
+            program = packet.material->getShaderId();
+            m_Stats.programBinds++;
+        }
+
+        // VAO du maillage pour la disposition des attributs du matériau, il change le VBO des indices lié
+        if (packet.mesh != mesh || packet.material->getVertexLayout() != layout) {
+            mesh = nullptr;
+            boundindices = -1;
+            if (! packet.material->bindVertexArray(packet.mesh)) continue;
+            mesh = packet.mesh;
+            layout = packet.material->getVertexLayout();
+            m_Stats.bufferBinds++;
+        }
+
+        // variables uniform, après les VBOs à cause de la boîte de quantification
+        packet.material->setUniforms(packet.mesh, matP, packet.matVM);
+
+        // textures, l'unité de l'échantillonneur est une variable uniform du shader
+        const GLuint packettexture = packet.material->getTextureId();
+        if (programchanged || packettexture != texture) {
+            packet.material->bindTextures();
+            texture = packettexture;
+            if (texture != 0) m_Stats.textureBinds++;
+        }
+        material = packet.material;
+
+        // dessin, avec les matrices des exemplaires s'il y en a
+        const GLint previousindices = boundindices;
+        const bool instanced = packet.instanceCount > 0 && material->selectInstances(packet.instanceBuffer, packet.firstInstance);
+        if (packet.pass == PASS_EDGES) {
+            mesh->drawEdges(instanced ? packet.instanceCount : 0, boundindices);
+        } else {
+            mesh->drawFaces(packet.level, instanced ? packet.instanceCount : 0, boundindices);
+        }
+        if (instanced) material->deselectInstances();
+        if (boundindices != previousindices) m_Stats.bufferBinds++;
+        m_Stats.draws++;
+    }
+
+    // remettre l'état par défaut
+    if (material != nullptr) material->deselect();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    if (offset) glDisable(GL_POLYGON_OFFSET_FILL);
+}
@@ -0,0 +1,169 @@
+#ifndef LIBS_RENDERQUEUE_H
+#define LIBS_RENDERQUEUE_H
+
+// Définition de la classe RenderQueue : file des dessins d'une image, triés par état OpenGL
+
+#include <vector>
+#include <stdint.h>
+
+#include <gl-matrix.h>
+#include <utils.h>
+
+
+class Mesh;
+class Material;
+class StreamBuffer;
+
+
+/**
+ * Cette classe reçoit les dessins d'une image (voir Mesh::submit) au lieu de les faire aussitôt.
+ * Chaque dessin a une clé de tri de 64 bits : passe, shader, matériau, texture puis profondeur.
+ * Lors de execute, les dessins sont triés par ces clés (tri par base), puis faits dans cet ordre :
+ * les dessins qui se suivent partagent ainsi leur shader, leur texture et leurs VBOs, qui ne sont
+ * liés qu'une fois.
+ *
+ * NB: pendant execute, la file est seule à modifier l'état OpenGL, elle ne le relit pas.
+ */
+class RenderQueue
+{
+public:
+
+    /// passes, dans l'ordre du dessin
+    enum Pass {
+        PASS_FACES          = 0,        // triangles
+        PASS_FACES_OFFSET   = 1,        // triangles décalés en profondeur, sous des arêtes
+        PASS_EDGES          = 2,        // arêtes
+    };
+
+    /// nombres d'opérations OpenGL de la dernière exécution
+    struct Stats
+    {
+        int draws;
+        int programBinds;
+        int textureBinds;
+        int bufferBinds;
+    };
+
+    /** constructeur d'une file vide */
+    RenderQueue();
+
+    /**
+     * vide la file, à appeler au début de chaque image ; la mémoire est gardée pour la suivante
+     */
+    void clear();
+
+    /**
+     * ajoute un dessin simple
+     * @param pass : passe du dessin
+     * @param mesh : maillage à dessiner
+     * @param material : matériau de ce dessin, celui des faces ou des arêtes du maillage
+     * @param matVM : matrice de transformation de l'objet par rapport à la caméra
+     * @param level : niveau de détail des faces, voir Mesh::selectLod
+     */
+    void submit(Pass pass, Mesh* mesh, Material* material, const mat4& matVM, int level=0);
+
+    /**
+     * ajoute le dessin de plusieurs exemplaires en un seul appel, voir Material::selectInstances
+     * @param pass : passe du dessin
+     * @param mesh : maillage à dessiner
+     * @param material : matériau de ce dessin, il doit employer Material::getInstancingFunctions
+     * @param matV : matrice de la caméra
+     * @param instancebuffer : VBO contenant les matrices de modèle, 16 GLfloat par exemplaire
+     * @param first : numéro du premier exemplaire dans ce VBO
+     * @param count : nombre d'exemplaires
+     * @param level : niveau de détail des faces, voir Mesh::selectLod
+     */
+    void submitInstances(Pass pass, Mesh* mesh, Material* material, const mat4& matV, GLint instancebuffer, size_t first, GLsizei count, int level=0);
+
+    /**
+     * trie les dessins et les fait, sans refaire les liaisons qui n'ont pas changé depuis le dessin précédent
+     * @param matP : matrice de projection perpective
+     */
+    void execute(const mat4& matP);
+
+    /**
+     * définit le VBO circulaire où les maillages écrivent les matrices de leurs exemplaires,
+     * voir Mesh::submitInstanced
+     * @param stream : VBO de l'image en cours, nullptr pour que chaque maillage emploie le sien
+     */
+    void setStreamBuffer(StreamBuffer* stream)
+    {
+        m_StreamBuffer = stream;
+    }
+
+    /**
+     * retourne le VBO circulaire des données de l'image, voir setStreamBuffer
+     * @return nullptr s'il n'y en a pas
+     */
+    StreamBuffer* getStreamBuffer()
+    {
+        return m_StreamBuffer;
+    }
+
+    /**
+     * retourne le nombre de dessins en attente
+     */
+    size_t size() const
+    {
+        return m_Packets.size();
+    }
+
+    /**
+     * retourne les nombres de dessins et de liaisons de la dernière exécution
+     * @return compteurs de execute
+     */
+    const Stats& getStats() const
+    {
+        return m_Stats;
+    }
+
+    /**
+     * calcule la clé de tri d'un dessin : passe (4 bits), shader (12 bits), matériau (12 bits),
+     * texture (12 bits) puis profondeur (24 bits), du plus proche au plus lointain
+     * @param pass : passe du dessin
+     * @param material : matériau du dessin
+     * @param depth : distance de l'objet à la caméra
+     * @return clé de tri
+     */
+    static uint64_t makeKey(Pass pass, Material* material, float depth);
+
+private:
+
+    /// dessin en attente
+    struct Packet
+    {
+        Mesh* mesh;
+        Material* material;
+        Pass pass;
+        int level;
+        mat4 matVM;
+        GLint instanceBuffer;
+        size_t firstInstance;
+        GLsizei instanceCount;      // 0 pour un dessin simple
+    };
+
+    /// élément à trier : clé et numéro du dessin
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    /** trie m_Order par clé croissante, tri par base octet par octet, stable */
+    void sort();
+
+    /// dessins dans l'ordre de leur ajout
+    std::vector<Packet> m_Packets;
+
+    /// ordre des dessins, et tableau de travail du tri
+    std::vector<SortItem> m_Order;
+    std::vector<SortItem> m_Scratch;
+
+    /// compteurs de la dernière exécution
+    Stats m_Stats;
+
+    /// VBO circulaire des matrices des exemplaires, peut être nullptr
+    StreamBuffer* m_StreamBuffer;
+};
+
+#endif
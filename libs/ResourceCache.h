@@ -0,0 +1,96 @@
+#ifndef LIBS_RESOURCECACHE_H
+#define LIBS_RESOURCECACHE_H
+
+// Définition de la classe ResourceCache : partage de ressources (maillages, textures, sons...) par clé
+
+#include <map>
+#include <memory>
+#include <string>
+#include <functional>
+
+
+/**
+ * Cette classe mémorise des ressources partagées, identifiées par une clé (en général le nom du fichier).
+ * Elle ne garde que des références faibles : une ressource est libérée dès que plus personne
+ * ne la référence, et elle sera rechargée à la prochaine demande.
+ * NB: cette classe n'est pas protégée contre les accès concurrents, l'employer depuis le thread OpenGL.
+ */
+template<typename T> class ResourceCache
+{
+public:
+
+    /// fonction qui crée la ressource quand elle n'est pas dans le cache
+    typedef std::function<std::shared_ptr<T>()> Factory;
+
+    /**
+     * retourne la ressource associée à la clé, en la créant par factory si elle n'existe pas ou plus
+     * @param key : identifiant de la ressource, ex: nom du fichier
+     * @param factory : fonction qui crée la ressource
+     * @return ressource partagée
+     */
+    std::shared_ptr<T> get(const std::string& key, Factory factory)
+    {
+        // la ressource est-elle encore vivante ?
+        typename std::map<std::string, std::weak_ptr<T>>::iterator it = m_Resources.find(key);
+        if (it != m_Resources.end()) {
+            std::shared_ptr<T> resource = it->second.lock();
+            if (resource) return resource;
+        }
+
+        // il faut la (re)créer
+        std::shared_ptr<T> resource = factory();
+        m_Resources[key] = resource;
+        return resource;
+    }
+
+    /**
+     * indique si la ressource est présente et vivante dans le cache
+     * @param key : identifiant de la ressource
+     * @return true si la ressource est utilisable sans la recréer
+     */
+    bool contains(const std::string& key) const
+    {
+        typename std::map<std::string, std::weak_ptr<T>>::const_iterator it = m_Resources.find(key);
+        return it != m_Resources.end() && !it->second.expired();
+    }
+
+    /**
+     * oublie la ressource associée à la clé, ex: son chargement a échoué. Ceux qui la
+     * référencent la gardent, la prochaine demande la recréera.
+     * @param key : identifiant de la ressource
+     */
+    void remove(const std::string& key)
+    {
+        m_Resources.erase(key);
+    }
+
+    /**
+     * retire du cache les entrées dont la ressource a été libérée
+     */
+    void purge()
+    {
+        for (typename std::map<std::string, std::weak_ptr<T>>::iterator it = m_Resources.begin(); it != m_Resources.end(); ) {
+            if (it->second.expired()) {
+                it = m_Resources.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /**
+     * retourne le nombre d'entrées du cache (y compris celles en attente de purge)
+     * @return nombre d'entrées
+     */
+    int size() const
+    {
+        return m_Resources.size();
+    }
+
+private:
+
+    /// ressources indexées par leur clé
+    std::map<std::string, std::weak_ptr<T>> m_Resources;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include <math.h>
+#include <algorithm>
+#include <iomanip>
+
+#include <RollingStats.h>
+
+
+/**
+ * constructeur
+ * @param window : nombre de valeurs gardées, les plus anciennes sont remplacées
+ */
+RollingStats::RollingStats(int window)
+{
+    m_Window = std::max(window, 1);
+    m_Next = 0;
+    m_Samples.reserve(m_Window);
+}
+
+
+/**
+ * ajoute une valeur, elle remplace la plus ancienne quand le tableau est plein
+ * @param sample : valeur à ajouter
+ */
+void RollingStats::add(double sample)
+{
+    if (m_Samples.size() < m_Window) {
+        m_Samples.push_back(sample);
+    } else {
+        m_Samples[m_Next] = sample;
+    }
+    m_Next = (m_Next + 1) % m_Window;
+}
+
+
+/**
+ * écrit une ligne : nom, valeurs minimale, moyenne et 99e centile, nombre de valeurs ; rien s'il n'y en a aucune
+ * @param out : flux où écrire
+ * @param name : nom de la mesure
+ */
+void RollingStats::report(std::ostream& out, const char* name) const
+{
+    if (m_Samples.empty()) return;
+    std::vector<double> sorted = m_Samples;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double sample: sorted) sum += sample;
+    const size_t p99 = std::max((size_t) ceil(sorted.size() * 0.99), (size_t) 1) - 1;
+    out << "  " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+        << " min " << std::setw(8) << sorted.front()
+        << "  avg " << std::setw(8) << sum / sorted.size()
+        << "  p99 " << std::setw(8) << sorted[p99]
+        << "  (" << sorted.size() << " frames)" << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,54 @@
+#ifndef LIBS_ROLLINGSTATS_H
+#define LIBS_ROLLINGSTATS_H
+
+// Définition de la classe RollingStats : statistiques d'une durée sur les dernières images
+
+#include <vector>
+#include <iostream>
+
+
+/**
+ * Cette classe garde les dernières valeurs d'une mesure (ex: durée d'une image) dans un tableau
+ * circulaire, et écrit leurs valeurs minimale, moyenne et leur 99e centile.
+ * Employée par FramePacer pour les durées CPU et par GpuProfiler pour celles de la carte graphique.
+ */
+class RollingStats
+{
+public:
+
+    /**
+     * constructeur
+     * @param window : nombre de valeurs gardées, les plus anciennes sont remplacées
+     */
+    RollingStats(int window);
+
+    /**
+     * ajoute une valeur, elle remplace la plus ancienne quand le tableau est plein
+     * @param sample : valeur à ajouter
+     */
+    void add(double sample);
+
+    /**
+     * indique si aucune valeur n'a encore été ajoutée
+     */
+    bool empty() const
+    {
+        return m_Samples.empty();
+    }
+
+    /**
+     * écrit une ligne : nom, valeurs minimale, moyenne et 99e centile, nombre de valeurs ; rien s'il n'y en a aucune
+     * @param out : flux où écrire
+     * @param name : nom de la mesure
+     */
+    void report(std::ostream& out, const char* name) const;
+
+private:
+
+    /// dernières valeurs, position de la prochaine
+    std::vector<double> m_Samples;
+    size_t m_Next;
+    size_t m_Window;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <utils.h>
+#include <ResourceCache.h>
+#include <ShaderProgram.h>
+
+
+// dossier des copies binaires
+std::string ShaderProgram::CacheDirectory = "cache";
+
+// programmes partagés, indexés par l'empreinte de leurs sources
+static ResourceCache<ShaderProgram> ShaderProgramCache;
+
+// en-tête des copies binaires : signature, puis format et taille du programme
+static const uint32_t BinaryMagic = 0x50445457;     // "WTDP"
+
+
+/**
+ * calcule l'empreinte FNV-1a 64 bits d'une chaîne, en poursuivant une empreinte déjà commencée
+ * @param hash : empreinte des données précédentes
+ * @param text : données à ajouter
+ * @return empreinte
+ */
+static uint64_t hashString(uint64_t hash, const std::string& text)
+{
+    for (unsigned char c: text) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    // séparateur, pour que "ab"+"c" diffère de "a"+"bc"
+    hash ^= 0xFF;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+
+/**
+ * retourne une chaîne OpenGL, vide si elle n'est pas disponible
+ * @param name : ex GL_RENDERER
+ */
+static std::string getGLString(GLenum name)
+{
+    const GLubyte* text = glGetString(name);
+    return (text != nullptr) ? std::string((const char*) text) : std::string();
+}
+
+
+/**
+ * retourne le programme correspondant à ces sources : celui d'un autre matériau s'il existe
+ * encore, sinon sa copie binaire sur disque, sinon il est compilé
+ * @param srcVertexShader : vertex shader
+ * @param srcFragmentShader : fragment shader
+ * @param name : nom du programme pour les messages
+ * @return programme partagé
+ * @throws std::invalid_argument si les sources ne compilent pas
+ */
+std::shared_ptr<ShaderProgram> ShaderProgram::get(const std::string& srcVertexShader, const std::string& srcFragmentShader, const std::string& name)
+{
+    // une copie binaire ne convient qu'au pilote qui l'a produite
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashString(hash, srcVertexShader);
+    hash = hashString(hash, srcFragmentShader);
+    hash = hashString(hash, getGLString(GL_VENDOR));
+    hash = hashString(hash, getGLString(GL_RENDERER));
+    hash = hashString(hash, getGLString(GL_VERSION));
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+    return ShaderProgramCache.get(key, [&]() {
+        return std::make_shared<ShaderProgram>(srcVertexShader, srcFragmentShader, name, hash);
+    });
+}
+
+
+/**
+ * constructeur, compile le programme ou le charge depuis sa copie binaire, voir get
+ * @param srcVertexShader : vertex shader
+ * @param srcFragmentShader : fragment shader
+ * @param name : nom du programme pour les messages
+ * @param hash : empreinte des sources, nom de la copie binaire
+ */
+ShaderProgram::ShaderProgram(const std::string& srcVertexShader, const std::string& srcFragmentShader, const std::string& name, uint64_t hash)
+{
+    m_Id = 0;
+    m_Hash = hash;
+    m_Name = name;
+
+    // la copie binaire évite la compilation
+    if (loadBinary()) return;
+
+    // compiler, en demandant au pilote de garder le binaire
+    const bool binaries = ! CacheDirectory.empty() && GLEW_ARB_get_program_binary;
+    m_Id = Utils::makeShaderProgram(srcVertexShader, srcFragmentShader, name, false, binaries);
+    if (binaries) saveBinary();
+}
+
+
+/** destructeur, supprime le programme OpenGL */
+ShaderProgram::~ShaderProgram()
+{
+    Utils::deleteShaderProgram(m_Id);
+}
+
+
+/**
+ * retourne le nom du fichier de la copie binaire
+ */
+std::string ShaderProgram::getBinaryFilename() const
+{
+    char filename[32];
+    snprintf(filename, sizeof(filename), "/%016llx.prog", (unsigned long long) m_Hash);
+    return CacheDirectory + filename;
+}
+
+
+/**
+ * charge la copie binaire du programme
+ * @return false si elle n'existe pas ou si le pilote la refuse
+ */
+bool ShaderProgram::loadBinary()
+{
+    if (CacheDirectory.empty() || ! GLEW_ARB_get_program_binary) return false;
+
+    // lire l'en-tête puis le programme
+    std::ifstream file(getBinaryFilename(), std::ios::binary);
+    if (! file.is_open()) return false;
+    uint32_t header[3];
+    if (! file.read((char*) header, sizeof(header)) || header[0] != BinaryMagic) return false;
+    const GLenum format = header[1];
+
+    // la taille annoncée doit être exactement le reste du fichier : un fichier tronqué ou abîmé
+    // ne doit pas provoquer une allocation démesurée
+    const std::streampos start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streampos end = file.tellg();
+    if (start < 0 || end < 0 || header[2] == 0 || (unsigned long long) (end - start) != header[2]) return false;
+    file.seekg(start);
+    std::vector<char> binary(header[2]);
+    if (! file.read(binary.data(), binary.size())) return false;
+
+    // le pilote peut la refuser, ex: après une mise à jour
+    GLint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), binary.size());
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        std::cerr << m_Name << " : program binary rejected, compiling shaders" << std::endl;
+        glDeleteProgram(program);
+        return false;
+    }
+    m_Id = program;
+    return true;
+}
+
+
+/**
+ * enregistre la copie binaire du programme, si le pilote le permet
+ */
+void ShaderProgram::saveBinary()
+{
+    GLint length = 0;
+    glGetProgramiv(m_Id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(m_Id, length, &length, &format, binary.data());
+
+    // créer le dossier s'il n'existe pas
+    if (mkdir(CacheDirectory.c_str(), 0755) != 0 && errno != EEXIST) return;
+
+    // écrire dans un fichier temporaire puis le renommer, pour qu'un autre lancement ne lise pas un fichier incomplet
+    const std::string filename = getBinaryFilename();
+    const std::string tmpname = filename + ".tmp";
+    {
+        std::ofstream file(tmpname, std::ios::binary);
+        if (! file.is_open()) return;
+        const uint32_t header[3] = { BinaryMagic, format, (uint32_t) length };
+        file.write((const char*) header, sizeof(header));
+        file.write(binary.data(), length);
+        if (! file.good()) return;
+    }
+    rename(tmpname.c_str(), filename.c_str());
+}
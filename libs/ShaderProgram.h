@@ -0,0 +1,86 @@
+#ifndef LIBS_SHADERPROGRAM_H
+#define LIBS_SHADERPROGRAM_H
+
+// Définition de la classe ShaderProgram : programme de shaders partagé entre les matériaux
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+#include <utils.h>
+
+
+/**
+ * Cette classe représente un programme de shaders compilé. Les matériaux dont les sources sont
+ * identiques partagent le même programme, voir get. Le programme compilé est aussi enregistré
+ * sur disque (glGetProgramBinary) dans CacheDirectory, pour que les lancements suivants n'aient
+ * qu'à le recharger (glProgramBinary) ; si le pilote refuse cette copie, les sources sont recompilées.
+ */
+class ShaderProgram
+{
+public:
+
+    /// dossier des copies binaires des programmes, "" pour ne pas en faire
+    static std::string CacheDirectory;
+
+    /**
+     * retourne le programme correspondant à ces sources : celui d'un autre matériau s'il existe
+     * encore, sinon sa copie binaire sur disque, sinon il est compilé
+     * @param srcVertexShader : vertex shader
+     * @param srcFragmentShader : fragment shader
+     * @param name : nom du programme pour les messages
+     * @return programme partagé
+     * @throws std::invalid_argument si les sources ne compilent pas
+     */
+    static std::shared_ptr<ShaderProgram> get(const std::string& srcVertexShader, const std::string& srcFragmentShader, const std::string& name);
+
+    /**
+     * constructeur, compile le programme ou le charge depuis sa copie binaire, voir get
+     * @param srcVertexShader : vertex shader
+     * @param srcFragmentShader : fragment shader
+     * @param name : nom du programme pour les messages
+     * @param hash : empreinte des sources, nom de la copie binaire
+     */
+    ShaderProgram(const std::string& srcVertexShader, const std::string& srcFragmentShader, const std::string& name, uint64_t hash);
+
+    /** destructeur, supprime le programme OpenGL */
+    ~ShaderProgram();
+
+    /**
+     * retourne l'identifiant OpenGL du programme
+     * @return identifiant pour glUseProgram
+     */
+    GLint getId() const
+    {
+        return m_Id;
+    }
+
+private:
+
+    /**
+     * charge la copie binaire du programme
+     * @return false si elle n'existe pas ou si le pilote la refuse
+     */
+    bool loadBinary();
+
+    /**
+     * enregistre la copie binaire du programme, si le pilote le permet
+     */
+    void saveBinary();
+
+    /**
+     * retourne le nom du fichier de la copie binaire
+     */
+    std::string getBinaryFilename() const;
+
+    /// identifiant OpenGL du programme
+    GLint m_Id;
+
+    /// empreinte des sources et du pilote
+    uint64_t m_Hash;
+
+    /// nom pour les messages
+    std::string m_Name;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <string.h>
+#include <algorithm>
+
+#include <utils.h>
+#include <StreamBuffer.h>
+
+
+const int StreamBuffer::FRAMES;
+const size_t StreamBuffer::DEFAULT_SIZE;
+
+// les zones commencent à un multiple de cet alignement (ou de celui des UBOs s'il est plus grand)
+static const size_t FrameAlignment = 256;
+
+
+/**
+ * arrondit une taille ou une position au multiple supérieur
+ * @param value : valeur à arrondir
+ * @param alignment : alignement, non nul
+ * @return plus petit multiple de alignment supérieur ou égal à value
+ */
+static inline size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+/**
+ * constructeur, le VBO est créé lors du premier beginFrame
+ * @param size : taille en octets de la zone de chaque image
+ */
+StreamBuffer::StreamBuffer(size_t size)
+{
+    m_FrameSize = alignUp(std::max(size, FrameAlignment), FrameAlignment);
+    m_Frame = 0;
+    m_Offset = 0;
+    m_Required = 0;
+    m_Overflow = false;
+    m_BufferId = -1;
+    m_Mapped = nullptr;
+    for (int frame=0; frame<FRAMES; frame++) m_Fences[frame] = 0;
+    m_UniformAlignment = FrameAlignment;
+}
+
+
+/** destructeur, supprime le VBO et les barrières */
+StreamBuffer::~StreamBuffer()
+{
+    for (int frame=0; frame<FRAMES; frame++) {
+        if (m_Fences[frame] != 0) glDeleteSync(m_Fences[frame]);
+    }
+    if (m_BufferId >= 0) Utils::deleteVBO(m_BufferId);
+}
+
+
+/**
+ * crée le VBO pour des zones de la taille indiquée
+ * @param size : taille d'une zone en octets
+ */
+void StreamBuffer::create(size_t size)
+{
+    // l'ancien VBO n'est plus lu : toutes ses barrières ont été attendues
+    if (m_BufferId >= 0) Utils::deleteVBO(m_BufferId);
+    m_Mapped = nullptr;
+
+    // les zones commencent aussi à un multiple de l'alignement des UBOs
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_UniformAlignment = std::max(alignment, 1);
+    m_FrameSize = alignUp(size, std::max(FrameAlignment, m_UniformAlignment));
+
+    // GL_COPY_WRITE_BUFFER ne fait partie d'aucun VAO, le lier ne dérange pas les dessins
+    GLuint id;
+    glGenBuffers(1, &id);
+    m_BufferId = id;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferId);
+    const GLsizeiptr total = m_FrameSize * FRAMES;
+    if (GLEW_ARB_buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, total, nullptr, flags);
+        m_Mapped = (uint8_t*) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+    }
+    if (m_Mapped == nullptr) {
+        // sans projection permanente, un VBO ordinaire rempli par glBufferSubData
+        if (GLEW_ARB_buffer_storage) {
+            Utils::deleteVBO(m_BufferId);
+            glGenBuffers(1, &id);
+            m_BufferId = id;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferId);
+        }
+        glBufferData(GL_COPY_WRITE_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+/**
+ * attend que la carte graphique ait fini de lire une zone et supprime sa barrière
+ * @param frame : numéro de la zone
+ */
+void StreamBuffer::waitFence(int frame)
+{
+    GLsync fence = m_Fences[frame];
+    if (fence == 0) return;
+
+    // la première attente envoie les commandes en attente, sinon la barrière pourrait ne jamais être atteinte
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fence, 0, 1000000000);
+    }
+    glDeleteSync(fence);
+    m_Fences[frame] = 0;
+}
+
+
+/**
+ * passe à la zone suivante, à appeler au début de chaque image avant tout write : attend que la
+ * carte graphique ait fini de lire cette zone, et agrandit les zones si la précédente a débordé
+ */
+void StreamBuffer::beginFrame()
+{
+    if (m_BufferId < 0) {
+        create(m_FrameSize);
+    } else if (m_Overflow) {
+        // toutes les zones changent de place : attendre la fin de toutes les images en cours
+        for (int frame=0; frame<FRAMES; frame++) waitFence(frame);
+        create(std::max(m_Required + m_Required/2, m_FrameSize * 2));
+    }
+    m_Frame = (m_Frame + 1) % FRAMES;
+    waitFence(m_Frame);
+    m_Offset = 0;
+    m_Required = 0;
+    m_Overflow = false;
+}
+
+
+/**
+ * pose la barrière de la zone de l'image, à appeler après son dernier dessin
+ */
+void StreamBuffer::endFrame()
+{
+    if (m_BufferId < 0) return;
+    if (m_Fences[m_Frame] != 0) glDeleteSync(m_Fences[m_Frame]);
+    m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+/**
+ * copie des données dans la zone de l'image
+ * @param data : données à copier
+ * @param size : taille des données en octets
+ * @param alignment : alignement de leur position dans le VBO, ex: 64 pour des mat4 d'exemplaires,
+ * getUniformAlignment() pour glBindBufferRange(GL_UNIFORM_BUFFER)
+ * @return position des données dans le VBO, en octets, -1 si la zone est pleine
+ */
+GLintptr StreamBuffer::write(const void* data, size_t size, size_t alignment)
+{
+    m_Required += size + alignment;
+    if (m_BufferId < 0) return -1;
+
+    // la zone commence à un multiple de tous les alignements demandés, aligner dans la zone suffit
+    const size_t offset = alignUp(m_Offset, std::max(alignment, (size_t) 1));
+    if (offset + size > m_FrameSize) {
+        m_Overflow = true;
+        return -1;
+    }
+    m_Offset = offset + size;
+
+    // la zone n'est plus lue par la carte graphique : copie directe, ou sans attente par le pilote
+    const size_t position = m_Frame * m_FrameSize + offset;
+    if (m_Mapped != nullptr) {
+        memcpy(m_Mapped + position, data, size);
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_BufferId);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, position, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return position;
+}
@@ -0,0 +1,124 @@
+#ifndef LIBS_STREAMBUFFER_H
+#define LIBS_STREAMBUFFER_H
+
+// Définition de la classe StreamBuffer : VBO circulaire pour les données qui changent à chaque image
+
+#include <stdint.h>
+
+#include <utils.h>
+
+
+/**
+ * Cette classe fournit un seul VBO pour toutes les données réécrites à chaque image : matrices des
+ * exemplaires, bloc FrameData, commandes de dessin indirect. Le VBO est partagé en FRAMES zones,
+ * une par image : pendant que la carte graphique lit les zones des images précédentes, l'image en
+ * cours écrit dans la sienne. Une barrière (glFenceSync) posée à la fin de chaque image indique
+ * quand sa zone peut être réécrite, beginFrame ne l'attend que si la carte graphique a FRAMES
+ * images de retard.
+ *
+ * Avec ARB_buffer_storage, le VBO est projeté une fois pour toutes en mémoire (MAP_PERSISTENT et
+ * MAP_COHERENT) : write copie directement les données à leur place, sans copie par le pilote ni
+ * synchronisation implicite. Sinon, write emploie glBufferSubData dans la zone libre.
+ *
+ * Une écriture qui ne tient plus dans la zone de l'image est refusée, l'appelant garde alors son
+ * propre VBO ; les zones sont agrandies au beginFrame suivant.
+ */
+class StreamBuffer
+{
+public:
+
+    /// nombre de zones : une pour l'image en cours, les autres pour celles que la carte graphique n'a pas finies
+    static const int FRAMES = 3;
+
+    /// taille initiale d'une zone, en octets
+    static const size_t DEFAULT_SIZE = 256 * 1024;
+
+    /**
+     * constructeur, le VBO est créé lors du premier beginFrame
+     * @param size : taille en octets de la zone de chaque image
+     */
+    StreamBuffer(size_t size=DEFAULT_SIZE);
+
+    /** destructeur, supprime le VBO et les barrières */
+    ~StreamBuffer();
+
+    /**
+     * passe à la zone suivante, à appeler au début de chaque image avant tout write : attend que la
+     * carte graphique ait fini de lire cette zone, et agrandit les zones si la précédente a débordé
+     */
+    void beginFrame();
+
+    /**
+     * pose la barrière de la zone de l'image, à appeler après son dernier dessin
+     */
+    void endFrame();
+
+    /**
+     * copie des données dans la zone de l'image
+     * @param data : données à copier
+     * @param size : taille des données en octets
+     * @param alignment : alignement de leur position dans le VBO, ex: 64 pour des mat4 d'exemplaires,
+     * getUniformAlignment() pour glBindBufferRange(GL_UNIFORM_BUFFER)
+     * @return position des données dans le VBO, en octets, -1 si la zone est pleine
+     */
+    GLintptr write(const void* data, size_t size, size_t alignment);
+
+    /**
+     * retourne l'identifiant du VBO, à lier à la cible voulue avec la position retournée par write
+     * @return identifiant du VBO, -1 avant le premier beginFrame
+     */
+    GLint getBufferId() const
+    {
+        return m_BufferId;
+    }
+
+    /**
+     * indique si le VBO est projeté en permanence en mémoire (ARB_buffer_storage)
+     */
+    bool isPersistent() const
+    {
+        return m_Mapped != nullptr;
+    }
+
+    /**
+     * retourne l'alignement exigé par glBindBufferRange pour un UBO
+     * @return GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+     */
+    size_t getUniformAlignment() const
+    {
+        return m_UniformAlignment;
+    }
+
+private:
+
+    /**
+     * crée le VBO pour des zones de la taille indiquée
+     * @param size : taille d'une zone en octets
+     */
+    void create(size_t size);
+
+    /**
+     * attend que la carte graphique ait fini de lire une zone et supprime sa barrière
+     * @param frame : numéro de la zone
+     */
+    void waitFence(int frame);
+
+    /// taille d'une zone, zone de l'image en cours et position libre dans cette zone, en octets
+    size_t m_FrameSize;
+    int m_Frame;
+    size_t m_Offset;
+
+    /// taille dont l'image en cours aurait eu besoin, et si une écriture a été refusée
+    size_t m_Required;
+    bool m_Overflow;
+
+    /// VBO, sa projection en mémoire (nullptr sans ARB_buffer_storage) et les barrières des zones
+    GLint m_BufferId;
+    uint8_t* m_Mapped;
+    GLsync m_Fences[FRAMES];
+
+    /// alignement des UBOs
+    size_t m_UniformAlignment;
+};
+
+#endif
@@ -18,9 +18,14 @@
 SDL_Surface * flipSurface(SDL_Surface * surface);
 
 #include <utils.h>
+#include <ResourceCache.h>
 #include <Texture2D.h>
 
 
+// textures partagées, indexées par nom de fichier et paramètres
+static ResourceCache<Texture2D> TextureCache;
+
+
 
 //***************************************************************************
 // lecture d'une image avec SDL...
@@ -67,28 +72,75 @@ Texture2D::Texture2D(std::string filename, GLenum filtering, GLenum repetition)
 
 
 /**
- * le constructeur lance le chargement d'une image et en fait une texture 2D
- * @param filename : nom du fichier contenant l'image à charger
+ * le constructeur fait une texture 2D d'une image déjà décodée par decode
+ * @param surface : image décodée, elle n'est pas libérée
  * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
  * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
  */
-void Texture2D::loadTexture(const char* filename, GLenum filtering, GLenum repetition)
+Texture2D::Texture2D(SDL_Surface* surface, GLenum filtering, GLenum repetition)
 {
-    // au cas où la suite plante, on invalide d'abord cette texture
+    // valeurs par défaut
     m_TextureID = 0;
+    m_Width = -1;
+    m_Height = -1;
+
+    uploadTexture(surface, filtering, repetition);
+}
+
 
+/**
+ * lit et décode une image, retournée verticalement pour OpenGL. Cette fonction n'appelle
+ * pas OpenGL, elle peut être employée par un thread de chargement (voir AsyncLoader).
+ * @param filename : nom du fichier contenant l'image à charger
+ * @return image à libérer par SDL_FreeSurface, nullptr si elle ne peut pas être lue
+ */
+SDL_Surface* Texture2D::decode(std::string filename)
+{
     // chargement de l'image
-    SDL_Surface *surface = IMG_Load(filename);
+    SDL_Surface *surface = IMG_Load(filename.c_str());
     if (!surface) {
         std::cerr << "Texture2D : impossible d'ouvrir \"" << filename << "\"" << std::endl;
-        exit(EXIT_FAILURE);
+        return nullptr;
     }
 
     // retourner la surface verticalement
     SDL_Surface *tmp = flipSurface(surface);
     SDL_FreeSurface(surface);
-    surface = tmp;
+    return tmp;
+}
+
+
+/**
+ * le constructeur lance le chargement d'une image et en fait une texture 2D
+ * @param filename : nom du fichier contenant l'image à charger
+ * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+ * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+ */
+void Texture2D::loadTexture(const char* filename, GLenum filtering, GLenum repetition)
+{
+    // au cas où la suite plante, on invalide d'abord cette texture
+    m_TextureID = 0;
+
+    // chargement de l'image
+    SDL_Surface *surface = decode(filename);
+    if (!surface) exit(EXIT_FAILURE);
+
+    // création de la texture OpenGL
+    uploadTexture(surface, filtering, repetition);
+
+    // libération de l'image SDL
+    SDL_FreeSurface(surface);
+}
+
 
+/**
+ * crée la texture OpenGL à partir d'une image décodée
+ * @param surface : image décodée, elle n'est pas libérée
+ * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+ * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+ */
+void Texture2D::uploadTexture(SDL_Surface* surface, GLenum filtering, GLenum repetition)
+{
     // infos sur cette texture
     m_Width = surface->w;
     m_Height = surface->h;
@@ -128,7 +180,7 @@ void Texture2D::loadTexture(const char* filename, GLenum filtering, GLenum repet
         //std::cout << filename << " luminance" << std::endl;
         break;
     default:
-        std::cerr << "Texture2D: " << filename << " : format inconnu, "  << (int)surface->format->BytesPerPixel << " octets/pixel" << std::endl;
+        std::cerr << "Texture2D: format inconnu, "  << (int)surface->format->BytesPerPixel << " octets/pixel" << std::endl;
     }
 
     // alignement des pixels
@@ -151,9 +203,6 @@ void Texture2D::loadTexture(const char* filename, GLenum filtering, GLenum repet
     glBindTexture(GL_TEXTURE_2D, m_TextureID);
     glTexImage2D(GL_TEXTURE_2D, 0, internal_format, m_Width, m_Height, 0, texture_format, components_type, surface->pixels);
 
-    // libération de l'image SDL
-    SDL_FreeSurface(surface);
-
     // filtrage avec mipmaps ?
     if (filtering == GL_NEAREST_MIPMAP_NEAREST || filtering == GL_LINEAR_MIPMAP_NEAREST ||
         filtering == GL_NEAREST_MIPMAP_LINEAR  || filtering == GL_LINEAR_MIPMAP_LINEAR) {
@@ -208,6 +257,42 @@ Texture2D::Texture2D(GLenum filtering, GLenum repetition)
 }
 
 
+/**
+ * retourne la texture partagée correspondant à ce fichier, elle n'est chargée qu'une seule fois
+ * tant qu'au moins un utilisateur la référence
+ * @param filename : nom du fichier contenant l'image à charger
+ * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+ * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+ * @return texture partagée
+ */
+std::shared_ptr<Texture2D> Texture2D::load(std::string filename, GLenum filtering, GLenum repetition)
+{
+    // la même image avec d'autres paramètres est une autre texture OpenGL
+    std::string key = filename + ":" + std::to_string(filtering) + ":" + std::to_string(repetition);
+    return TextureCache.get(key, [=]() {
+        return std::make_shared<Texture2D>(filename, filtering, repetition);
+    });
+}
+
+
+/**
+ * comme load, mais l'image a déjà été décodée (voir decode) : s'il faut créer la texture,
+ * elle est faite à partir de surface, sans lire le fichier
+ * @param filename : nom du fichier d'où vient l'image, clé du partage
+ * @param surface : image décodée, elle n'est pas libérée
+ * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+ * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+ * @return texture partagée
+ */
+std::shared_ptr<Texture2D> Texture2D::load(std::string filename, SDL_Surface* surface, GLenum filtering, GLenum repetition)
+{
+    std::string key = filename + ":" + std::to_string(filtering) + ":" + std::to_string(repetition);
+    return TextureCache.get(key, [=]() {
+        return std::make_shared<Texture2D>(surface, filtering, repetition);
+    });
+}
+
+
 /**
  * supprime cette texture
  */
@@ -5,6 +5,9 @@
 #include <GL/gl.h>
 
 #include <string>
+#include <memory>
+
+struct SDL_Surface;
 
 class Texture2D {
 public:
@@ -20,9 +23,46 @@ public:
     Texture2D(const char* filename, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
     Texture2D(std::string filename, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
 
+    /**
+     * le constructeur fait une texture 2D d'une image déjà décodée par decode
+     * @param surface : image décodée, elle n'est pas libérée
+     * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+     * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+     */
+    Texture2D(SDL_Surface* surface, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
+
     // destructeur
     virtual ~Texture2D();
 
+    /**
+     * retourne la texture partagée correspondant à ce fichier, elle n'est chargée qu'une seule fois
+     * tant qu'au moins un utilisateur la référence
+     * @param filename : nom du fichier contenant l'image à charger
+     * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+     * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+     * @return texture partagée
+     */
+    static std::shared_ptr<Texture2D> load(std::string filename, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
+
+    /**
+     * comme load, mais l'image a déjà été décodée (voir decode) : s'il faut créer la texture,
+     * elle est faite à partir de surface, sans lire le fichier
+     * @param filename : nom du fichier d'où vient l'image, clé du partage
+     * @param surface : image décodée, elle n'est pas libérée
+     * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+     * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+     * @return texture partagée
+     */
+    static std::shared_ptr<Texture2D> load(std::string filename, SDL_Surface* surface, GLenum filtering=GL_LINEAR, GLenum repetition=GL_CLAMP_TO_EDGE);
+
+    /**
+     * lit et décode une image, retournée verticalement pour OpenGL. Cette fonction n'appelle
+     * pas OpenGL, elle peut être employée par un thread de chargement (voir AsyncLoader).
+     * @param filename : nom du fichier contenant l'image à charger
+     * @return image à libérer par SDL_FreeSurface, nullptr si elle ne peut pas être lue
+     */
+    static SDL_Surface* decode(std::string filename);
+
     /**
      * cette fonction associe la texture à une unité de texture pour un shader
      * NB: le shader concerné doit être actif
@@ -44,6 +84,14 @@ private:
      * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
      */
     void loadTexture(const char* filename, GLenum filtering, GLenum repetition);
+
+    /**
+     * crée la texture OpenGL à partir d'une image décodée
+     * @param surface : image décodée, elle n'est pas libérée
+     * @param filtering : mettre GL_LINEAR ou gl.NEAREST ou GL_LINEAR_MIPMAP_LINEAR (mipmaps)
+     * @param repetition : mettre GL_CLAMP_TO_EDGE ou GL_REPEAT
+     */
+    void uploadTexture(SDL_Surface* surface, GLenum filtering, GLenum repetition);
 };
 
 
@@ -0,0 +1,142 @@
+#ifndef LIBS_VERTEXFORMAT_H
+#define LIBS_VERTEXFORMAT_H
+
+// Définition du format des sommets dans un VBO entrelacé
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+
+/**
+ * Ce namespace décrit la disposition des attributs d'un sommet dans un VBO entrelacé :
+ * pour chaque sommet, les attributs présents dans le masque sont rangés les uns derrière
+ * les autres dans l'ordre de l'énumération Attribute, sans remplissage.
+ * Toutes les fonctions sont constexpr : un format connu à la compilation (voir Format)
+ * a son pas et ses décalages calculés par le compilateur.
+ */
+namespace VertexFormat
+{
+    /// attributs possibles d'un sommet, dans leur ordre de rangement
+    enum Attribute {
+        COORDS = 0,
+        COLOR,
+        TEXCOORDS,
+        NORMAL,
+        TANGENT,
+        ATTRIBUTE_COUNT
+    };
+
+    /// bits des masques d'attributs
+    enum Mask : unsigned {
+        COORDS_BIT    = 1u << COORDS,
+        COLOR_BIT     = 1u << COLOR,
+        TEXCOORDS_BIT = 1u << TEXCOORDS,
+        NORMAL_BIT    = 1u << NORMAL,
+        TANGENT_BIT   = 1u << TANGENT,
+        ALL_BITS      = (1u << ATTRIBUTE_COUNT) - 1
+    };
+
+    /**
+     * retourne le nombre de GLfloat de l'attribut
+     * @param attribute : l'un des Attribute
+     */
+    constexpr int components(int attribute)
+    {
+        return attribute == TEXCOORDS ? 2 : 3;
+    }
+
+    /**
+     * retourne le nombre de GLfloat qui précèdent l'attribut dans un sommet
+     * @param mask : attributs présents dans le VBO
+     * @param attribute : l'un des Attribute
+     */
+    constexpr int offset(unsigned mask, int attribute)
+    {
+        return attribute <= 0 ? 0 :
+            offset(mask, attribute-1) + ((mask & (1u << (attribute-1))) ? components(attribute-1) : 0);
+    }
+
+    /**
+     * retourne le nombre de GLfloat d'un sommet
+     * @param mask : attributs présents dans le VBO
+     */
+    constexpr int stride(unsigned mask)
+    {
+        return offset(mask, ATTRIBUTE_COUNT);
+    }
+
+    /**
+     * Attributs quantifiés (voir Mesh::setQuantized) : coordonnées en 3 entiers 16 bits non signés
+     * normalisés dans la boîte englobante (plus 2 octets de remplissage pour l'alignement), couleur
+     * en 3 octets normalisés (+1), coordonnées de texture en 2 demi-flottants, normale et tangente
+     * en 2 entiers 16 bits signés normalisés, codage octaédrique. Tailles en octets.
+     * @param attribute : l'un des Attribute
+     */
+    constexpr int quantizedSize(int attribute)
+    {
+        return attribute == COORDS ? 8 : 4;
+    }
+
+    /**
+     * retourne le nombre de composantes de l'attribut quantifié lues par le shader
+     * @param attribute : l'un des Attribute
+     */
+    constexpr int quantizedComponents(int attribute)
+    {
+        return (attribute == COORDS || attribute == COLOR) ? 3 : 2;
+    }
+
+    /**
+     * retourne le type OpenGL des composantes de l'attribut quantifié
+     * @param attribute : l'un des Attribute
+     */
+    constexpr GLenum quantizedType(int attribute)
+    {
+        return attribute == COORDS    ? GL_UNSIGNED_SHORT :
+               attribute == COLOR     ? GL_UNSIGNED_BYTE :
+               attribute == TEXCOORDS ? GL_HALF_FLOAT : GL_SHORT;
+    }
+
+    /**
+     * retourne le nombre d'octets qui précèdent l'attribut quantifié dans un sommet
+     * @param mask : attributs présents dans le VBO
+     * @param attribute : l'un des Attribute
+     */
+    constexpr int quantizedOffset(unsigned mask, int attribute)
+    {
+        return attribute <= 0 ? 0 :
+            quantizedOffset(mask, attribute-1) + ((mask & (1u << (attribute-1))) ? quantizedSize(attribute-1) : 0);
+    }
+
+    /**
+     * retourne le nombre d'octets d'un sommet quantifié
+     * @param mask : attributs présents dans le VBO
+     */
+    constexpr int quantizedStride(unsigned mask)
+    {
+        return quantizedOffset(mask, ATTRIBUTE_COUNT);
+    }
+
+    /**
+     * Format de sommet fixé à la compilation, ex: Format<COORDS_BIT|NORMAL_BIT>::STRIDE
+     */
+    template<unsigned MASK> struct Format
+    {
+        static constexpr unsigned BITS = MASK;
+        static constexpr int STRIDE = stride(MASK);
+        static constexpr int SIZEOF = STRIDE * sizeof(GLfloat);
+        static constexpr int QUANTIZED_SIZEOF = quantizedStride(MASK);
+        static constexpr int offsetOf(int attribute)
+        {
+            return offset(MASK, attribute);
+        }
+    };
+
+    /// format du matériau texturé et éclairé
+    typedef Format<COORDS_BIT | TEXCOORDS_BIT | NORMAL_BIT> PositionTexCoordsNormal;
+    static_assert(PositionTexCoordsNormal::SIZEOF == 32, "unexpected vertex size");
+    static_assert(PositionTexCoordsNormal::offsetOf(NORMAL) == 5, "unexpected normal offset");
+    static_assert(PositionTexCoordsNormal::QUANTIZED_SIZEOF == 16, "unexpected quantized vertex size");
+}
+
+#endif
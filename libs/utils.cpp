@@ -202,9 +202,10 @@ static GLint compileShader(GLenum shaderType, const GLchar* source, std::string
  * @param FSsource : source du fragment shader
  * @param name : nom du shader pour les messages d'erreurs ou le log
  * @param debug : mettre true si on veut enregistrer les shaders dans des fichiers .vert et .frag
+ * @param retrievable : mettre true si on veut en récupérer le binaire par glGetProgramBinary
  * @return identifiant OpenGL du programme de shader complet
  */
-GLint makeShaderProgram(std::string VSsource, std::string FSsource, std::string name, bool debug) /* throw (std::invalid_argument) */
+GLint makeShaderProgram(std::string VSsource, std::string FSsource, std::string name, bool debug, bool retrievable) /* throw (std::invalid_argument) */
 {
     if (debug) {
         // enregistrement des shaders pour GLSLangValidator
@@ -231,6 +232,11 @@ GLint makeShaderProgram(std::string VSsource, std::string FSsource, std::string
     // voir http://www.opengl.org/wiki/Vertex_Attribute, pour éviter le bug de l'attribut 0 pas lié
     glBindAttribLocation(program, 0, "glVertex");
 
+    // le binaire n'est disponible que si on l'a demandé avant l'édition des liens
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     // lier le programme
     glLinkProgram(program);
 
@@ -280,23 +286,37 @@ void deleteShaderProgram(GLint id)
  * @return identifiant OpenGL du VBO
  */
 GLuint makeFloatVBO(std::vector<GLfloat> values, int vbo_type, int usage)
+{
+    return makeFloatVBO(values.data(), values.size(), vbo_type, usage);
+}
+
+
+/**
+ * cette fonction crée un VBO contenant des GLfloat, sans recopier le tableau
+ * @param values : tableau de float à mettre dans le VBO
+ * @param count : nombre de float du tableau
+ * @param vbo_type : type OpenGL du VBO, par exemple GL_ARRAY_BUFFER
+ * @param usage : type de stockage OpenGL des données, par exemple GL_STATIC_DRAW
+ * @return identifiant OpenGL du VBO
+ */
+GLuint makeFloatVBO(const GLfloat* values, size_t count, int vbo_type, int usage)
 {
     /*****DEBUG*****/
-    if (values.size() < 1) {
+    if (count < 1) {
         throw std::invalid_argument("Utils::makeFloatVBO: values vector is empty");
     }
     if (vbo_type != GL_ARRAY_BUFFER) {
-        throw std::invalid_argument("Utils::makeFloatVBO: second parameter, vbo_type is not GL_ARRAY_BUFFER");
+        throw std::invalid_argument("Utils::makeFloatVBO: vbo_type is not GL_ARRAY_BUFFER");
     }
     if (usage != GL_STATIC_DRAW && usage != GL_DYNAMIC_DRAW) {
-        throw std::invalid_argument("Utils::makeFloatVBO: third parameter, usage is neither GL_STATIC_DRAW or GL_DYNAMIC_DRAW");
+        throw std::invalid_argument("Utils::makeFloatVBO: usage is neither GL_STATIC_DRAW or GL_DYNAMIC_DRAW");
     }
     /*****DEBUG*****/
     // créer un VBO et le remplir avec les données
     GLuint id;
     glGenBuffers(1, &id);
     glBindBuffer(vbo_type, id);
-    glBufferData(vbo_type, values.size()*sizeof(GLfloat), values.data(), usage);
+    glBufferData(vbo_type, count*sizeof(GLfloat), values, usage);
     glBindBuffer(vbo_type, 0);
 
     return id;
@@ -402,23 +422,37 @@ GLuint makeIntVBO(std::vector<GLint> values, int vbo_type, int usage)
  * @return identifiant OpenGL du VBO
  */
 GLuint makeIntVBO(std::vector<GLuint> values, int vbo_type, int usage)
+{
+    return makeIntVBO(values.data(), values.size(), vbo_type, usage);
+}
+
+
+/**
+ * cette fonction crée un VBO contenant des GLuint, sans recopier le tableau
+ * @param values : tableau de GLuint à mettre dans le VBO
+ * @param count : nombre de GLuint du tableau
+ * @param vbo_type : type OpenGL du VBO, par exemple GL_ELEMENT_ARRAY_BUFFER
+ * @param usage : type de stockage OpenGL des données, par exemple GL_STATIC_DRAW
+ * @return identifiant OpenGL du VBO
+ */
+GLuint makeIntVBO(const GLuint* values, size_t count, int vbo_type, int usage)
 {
     /*****DEBUG*****/
-    if (values.size() < 1) {
+    if (count < 1) {
         throw std::invalid_argument("Utils::makeUIntVBO: values vector is empty");
     }
     if (vbo_type != GL_ARRAY_BUFFER && vbo_type != GL_ELEMENT_ARRAY_BUFFER) {
-        throw std::invalid_argument("Utils::makeUIntVBO: second parameter, vbo_type is neither GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER");
+        throw std::invalid_argument("Utils::makeUIntVBO: vbo_type is neither GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER");
     }
     if (usage != GL_STATIC_DRAW && usage != GL_DYNAMIC_DRAW) {
-        throw std::invalid_argument("Utils::makeUIntVBO: third parameter, usage is neither GL_STATIC_DRAW or GL_DYNAMIC_DRAW");
+        throw std::invalid_argument("Utils::makeUIntVBO: usage is neither GL_STATIC_DRAW or GL_DYNAMIC_DRAW");
     }
     /*****DEBUG*****/
     // créer un VBO et le remplir avec les données
     GLuint id;
     glGenBuffers(1, &id);
     glBindBuffer(vbo_type, id);
-    glBufferData(vbo_type, values.size()*sizeof(GLuint), values.data(), usage);
+    glBufferData(vbo_type, count*sizeof(GLuint), values, usage);
     glBindBuffer(vbo_type, 0);
 
     return id;
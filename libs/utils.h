@@ -72,9 +72,10 @@ namespace Utils
      * @param FSsource : source du fragment shader
      * @param name : nom du shader pour les messages d'erreurs ou le log
      * @param debug : mettre true si on veut enregistrer les shaders dans des fichiers .vert et .frag
+     * @param retrievable : mettre true si on veut en récupérer le binaire par glGetProgramBinary
      * @return identifiant OpenGL du programme de shader complet
      */
-    GLint makeShaderProgram(std::string VSsource, std::string FSsource, std::string name, bool debug=false) /* throw (std::invalid_argument) */ ;
+    GLint makeShaderProgram(std::string VSsource, std::string FSsource, std::string name, bool debug=false, bool retrievable=false) /* throw (std::invalid_argument) */ ;
 
     /**
      * supprime un shader dont on fournit l'identifiant
@@ -91,6 +92,16 @@ namespace Utils
      */
     GLuint makeFloatVBO(std::vector<GLfloat> values, int vbo_type, int usage);
 
+    /**
+     * cette fonction crée un VBO contenant des GLfloat, sans recopier le tableau
+     * @param values : tableau de GLfloat à mettre dans le VBO
+     * @param count : nombre de GLfloat du tableau
+     * @param vbo_type : type OpenGL du VBO, par exemple GL_ARRAY_BUFFER
+     * @param usage : type de stockage OpenGL des données, par exemple GL_STATIC_DRAW
+     * @return identifiant OpenGL du VBO
+     */
+    GLuint makeFloatVBO(const GLfloat* values, size_t count, int vbo_type, int usage);
+
     /**
      * cette fonction crée un VBO contenant des GLshort
      * @param values : std::vector de GLshort à mettre dans le VBO
@@ -127,6 +138,16 @@ namespace Utils
      */
     GLuint makeIntVBO(std::vector<GLuint> values, int vbo_type, int usage);
 
+    /**
+     * cette fonction crée un VBO contenant des GLuint, sans recopier le tableau
+     * @param values : tableau de GLuint à mettre dans le VBO
+     * @param count : nombre de GLuint du tableau
+     * @param vbo_type : type OpenGL du VBO, par exemple GL_ELEMENT_ARRAY_BUFFER
+     * @param usage : type de stockage OpenGL des données, par exemple GL_STATIC_DRAW
+     * @return identifiant OpenGL du VBO
+     */
+    GLuint makeIntVBO(const GLuint* values, size_t count, int vbo_type, int usage);
+
     /**
      * supprime un buffer VBO dont on fournit l'identifiant
      * @param id : identifiant du VBO
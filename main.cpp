@@ -10,6 +10,8 @@
 #include <stdlib.h>
 
 #include <utils.h>
+#include <GpuProfiler.h>
+#include <FramePacer.h>
 #include "Scene.h"
 
 
@@ -19,6 +21,40 @@
  **/
 Scene* scene = nullptr;
 
+/**
+ * Cadence de la boucle principale
+ **/
+static FramePacer pacer;
+
+/**
+ * Nombre d'images entre deux affichages des statistiques des images, avec --frame-stats
+ **/
+static const int FrameStatsInterval = 300;
+
+/**
+ * Attente maximale des événements quand la scène n'a pas à être redessinée, avec --on-demand, en secondes
+ **/
+static const double IdleTimeout = 0.5;
+
+/**
+ * Affiche les durées des dernières images, puis les dessins et les canards de la dernière, avec --frame-stats
+ **/
+static void reportFrameStats(std::ostream& out)
+{
+    pacer.report(out);
+
+    // dessins de la file et de l'arène
+    const RenderQueue::Stats& stats = scene->getRenderStats();
+    int commands;
+    const int arenadraws = scene->getArenaDrawCallCount(commands);
+    out << "Last frame" << std::endl;
+    out << "  draws        " << stats.draws + arenadraws
+        << "  (queue " << stats.draws << ", arena " << arenadraws << " for " << commands << " commands)" << std::endl;
+    out << "  binds        " << stats.programBinds << " programs, " << stats.textureBinds << " textures, "
+        << stats.bufferBinds << " buffers" << std::endl;
+    out << "  ducks        " << scene->getVisibleDuckCount() << " visible, " << scene->getCulledDuckCount() << " culled" << std::endl;
+}
+
 /**
  * Callback pour GLFW : prendre en compte la taille de la vue OpenGL
  **/
@@ -35,21 +71,35 @@ static void onDrawRequest(GLFWwindow* window)
 {
     if (scene == nullptr) return;
     Utils::UpdateTime();
+    GpuProfiler::get().beginFrame();
     scene->onDrawFrame();
     static bool premiere = true;
     if (premiere) {
         // copie écran automatique
+        GPU_PROFILE_SCOPE("screenshot");
         int width, height;
         glfwGetWindowSize(window, &width, &height);
         Utils::ScreenShotPPM("image.ppm", width, height);
         premiere = false;
     }
+    GpuProfiler::get().endFrame();
+    pacer.endWork();
 
     // afficher le back buffer
     glfwSwapBuffers(window);
 }
 
 
+/**
+ * Callback pour GLFW : le contenu de la fenêtre est à refaire (ex: elle n'est plus masquée)
+ **/
+static void onRefresh(GLFWwindow* window)
+{
+    if (scene == nullptr) return;
+    scene->invalidate();
+}
+
+
 static void onMouseButton(GLFWwindow* window, int button, int action, int mods)
 {
     if (scene == nullptr) return;
@@ -137,6 +187,40 @@ int main(int argc,char **argv)
     // pour spécifier ce qu'il faut impérativement faire à la sortie
     atexit(onExit);
 
+    // options de la ligne de commande
+    int swapinterval = 1;
+    double fpscap = 0.0;
+    bool lowlatency = false;
+    bool framestats = false;
+    bool ondemand = false;
+    for (int i=1; i<argc; i++) {
+        std::string option = argv[i];
+        if (option == "--gpu-profile") {
+            // durées des parties de l'image sur la carte graphique, fichier facultatif
+            std::string filename = (i+1 < argc && argv[i+1][0] != '-') ? argv[++i] : "";
+            GpuProfiler::get().setEnabled(true, filename);
+        } else if (option == "--swap-interval" && i+1 < argc) {
+            swapinterval = atoi(argv[++i]);
+        } else if (option == "--fps-cap" && i+1 < argc) {
+            fpscap = atof(argv[++i]);
+        } else if (option == "--low-latency") {
+            lowlatency = true;
+        } else if (option == "--frame-stats") {
+            framestats = true;
+        } else if (option == "--on-demand") {
+            ondemand = true;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+        }
+    }
+
+    // synchronisation verticale et cadence des images, la boucle principale ne doit pas occuper un coeur pour rien
+    glfwSwapInterval(swapinterval);
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    pacer.setSwapInterval(swapinterval, (mode != nullptr) ? mode->refreshRate : 60.0);
+    pacer.setFrameRateCap(fpscap);
+    pacer.setLowLatency(lowlatency);
+
     // initialisation de la bibliothèque de gestion du son
     alutInit(0, NULL);
     alGetError();
@@ -159,19 +243,33 @@ int main(int argc,char **argv)
     glfwSetMouseButtonCallback(window, onMouseButton);
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
     glfwSetKeyCallback(window, onKeyboard);
+    glfwSetWindowRefreshCallback(window, onRefresh);
 
     // affichage du mode d'emploi
     std::cout << "Usage:" << std::endl;
     std::cout << "Left button to rotate object" << std::endl;
     std::cout << "Q,D (axis x) A,W (axis y) Z,S (axis z) keys to move" << std::endl;
+    std::cout << "--gpu-profile [file] to print GPU times of each part of the frame" << std::endl;
+    std::cout << "--swap-interval N (default 1), --fps-cap FPS, --low-latency to pace frames" << std::endl;
+    std::cout << "--frame-stats to print frame times, draw calls and culled ducks" << std::endl;
+    std::cout << "--on-demand to redraw only when the scene changes" << std::endl;
 
     // boucle principale
     onSurfaceChanged(window, 640,480);
     do {
+        // rien n'a changé : dormir jusqu'au prochain événement (fenêtre, souris, clavier, réseau)
+        if (ondemand && ! scene->needsRedraw()) {
+            glfwWaitEventsTimeout(IdleTimeout);
+            pacer.idle();
+            continue;
+        }
+
+        // attendre le début de l'image, puis lire les événements juste avant de dessiner
+        pacer.waitForNextFrame();
+        glfwPollEvents();
         // dessiner
         onDrawRequest(window);
-        // attendre les événements
-        glfwPollEvents();
+        if (framestats && pacer.getFrameCount() % FrameStatsInterval == 0) reportFrameStats(std::cout);
     } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && !glfwWindowShouldClose(window));
 
     return EXIT_SUCCESS;